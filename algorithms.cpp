@@ -1,74 +1,145 @@
 #include "algorithms.hpp"
 
-#include <vigra/convolution.hxx>
+#include <algorithm>
+#include <cassert>
+
 #include <vigra/linear_algebra.hxx>
 
+#include "convolution.hpp"
+
 using namespace vigra::linalg;
 
 namespace sift {
     namespace alg {
-        const vigra::MultiArray<2, f32_t> convolveWithGauss(const vigra::MultiArray<2, f32_t>& img, 
+        const vigra::MultiArray<2, f32_t> convolveWithGauss(const vigra::MultiArrayView<2, f32_t>& img, 
                 f32_t sigma) {
 
             vigra::Kernel1D<f32_t> filter;
             filter.initGaussian(sigma);
-            vigra::MultiArray<2, f32_t> tmp(img.shape());
-            vigra::MultiArray<2, f32_t> result(img.shape());
+            if (!isSymmetric(filter))
+                return convolveWithGaussVigra(img, filter);
 
-            separableConvolveX(img, tmp, filter);
-            separableConvolveY(tmp, result, filter);
+            vigra::MultiArray<2, f32_t> result(img.shape());
+            separableConvolve(img, result, symmetricTaps(filter), 0, img.height(), nullptr);
 
             return result;
         }
 
-        const vigra::MultiArray<2, f32_t> reduceToNextLevel(const vigra::MultiArray<2, f32_t>& img, 
+        void convolveWithGauss(const vigra::MultiArrayView<2, f32_t>& img, vigra::MultiArrayView<2, f32_t> out,
+                const vigra::Kernel1D<f32_t>& filter, ThreadPool& pool, f32_t* scratch) {
+
+            //A sigma of 0 leaves a single tap of 1, which doesn't change anything
+            if (filter.size() == 1 && filter[0] == 1) {
+                out.copy(img);
+                return;
+            }
+
+            if (!isSymmetric(filter)) {
+                out.copy(convolveWithGaussVigra(img, filter));
+                return;
+            }
+
+            //Every output row is calculated the same way, no matter which band it belongs to, so
+            //the bands give the same values as a single pass over the whole image
+            const std::vector<f32_t> taps = symmetricTaps(filter);
+            const u32_t height = img.height();
+            const u32_t rows = (height + pool.size() - 1) / pool.size();
+            const u32_t scratch_size = separableConvolveScratch(img.width(), taps.size() - 1);
+            pool.parallelFor(0, pool.size(), [&](u32_t band) {
+                const u32_t begin = std::min(height, band * rows);
+                const u32_t end = std::min(height, (band + 1) * rows);
+                separableConvolve(img, out, taps, begin, end, scratch + band * scratch_size);
+            });
+        }
+
+        const vigra::MultiArray<2, f32_t> reduceToNextLevel(const vigra::MultiArrayView<2, f32_t>& img, 
                 f32_t sigma) {
 
-            // image size at current level
-            const vigra::Shape2 s((img.width()+ 1) / 2, (img.height() + 1) / 2);
+            vigra::Kernel1D<f32_t> filter;
+            filter.initGaussian(sigma);
 
-            // resize result image to appropriate size
-            vigra::MultiArray<2, f32_t> out(s);
-            // downsample smoothed image
-            resizeImageNoInterpolation(convolveWithGauss(img, sigma), out);
+            vigra::MultiArray<2, f32_t> out(vigra::Shape2((img.width() + 1) / 2, (img.height() + 1) / 2));
+            ThreadPool pool;
+            reduceToNextLevel(img, out, filter, pool, nullptr);
 
             return out; 
         }
 
-        const vigra::MultiArray<2, f32_t> increaseToNextLevel(const vigra::MultiArray<2, f32_t>& img,
-                f32_t sigma) {
-            // image size at current level
-            const vigra::Shape2 s(img.width() * 2, img.height() * 2);
+        void reduceToNextLevel(const vigra::MultiArrayView<2, f32_t>& img, vigra::MultiArrayView<2, f32_t> out,
+                const vigra::Kernel1D<f32_t>& filter, ThreadPool& pool, f32_t* scratch) {
+
+            assert(out.width() == (img.width() + 1) / 2 && out.height() == (img.height() + 1) / 2);
 
-            // resize result image to appropriate size
-            vigra::MultiArray<2, f32_t> out(s);
-            // downsample smoothed image
-            resizeImageNoInterpolation(convolveWithGauss(img, sigma), out);
+            if (!isSymmetric(filter)) {
+                const vigra::MultiArray<2, f32_t> blurred = convolveWithGaussVigra(img, filter);
+                const u32_t width = out.width();
+                const u32_t height = out.height();
+                for (u32_t y = 0; y < height; y++) {
+                    for (u32_t x = 0; x < width; x++) {
+                        out(x, y) = blurred(2 * x, 2 * y);
+                    }
+                }
+                return;
+            }
+
+            //Like convolveWithGauss every band gives the same rows as a single pass would
+            const std::vector<f32_t> taps = symmetricTaps(filter);
+            const u32_t height = out.height();
+            const u32_t rows = (height + pool.size() - 1) / pool.size();
+            const u32_t scratch_size = separableDecimateScratch(img.width(), taps.size() - 1);
+            pool.parallelFor(0, pool.size(), [&](u32_t band) {
+                const u32_t begin = std::min(height, band * rows);
+                const u32_t end = std::min(height, (band + 1) * rows);
+                f32_t* own = scratch == nullptr ? nullptr : scratch + band * scratch_size;
+                separableDecimate(img, out, taps, begin, end, own);
+            });
+        }
+
+        const vigra::MultiArray<2, f32_t> increaseToNextLevel(const vigra::MultiArrayView<2, f32_t>& img) {
+            vigra::MultiArray<2, f32_t> out(vigra::Shape2(img.width() * 2, img.height() * 2));
+            bilinearUpsample(img, out, 0, img.height());
 
             return out; 
         }
 
+        void increaseToNextLevel(const vigra::MultiArrayView<2, f32_t>& img, vigra::MultiArrayView<2, f32_t> out,
+                ThreadPool& pool) {
+
+            assert(out.width() == img.width() * 2 && out.height() == img.height() * 2);
+
+            const u32_t height = img.height();
+            const u32_t rows = (height + pool.size() - 1) / pool.size();
+            pool.parallelFor(0, pool.size(), [&](u32_t band) {
+                bilinearUpsample(img, out, std::min(height, band * rows), std::min(height, (band + 1) * rows));
+            });
+        }
 
-        const vigra::MultiArray<2, f32_t> dog(const vigra::MultiArray<2, f32_t>& lower, 
-                const vigra::MultiArray<2, f32_t>& higher) {
+        const vigra::MultiArray<2, f32_t> dog(const vigra::MultiArrayView<2, f32_t>& lower, 
+                const vigra::MultiArrayView<2, f32_t>& higher) {
 
             vigra::MultiArray<2, f32_t> result(vigra::Shape2(lower.shape()));
-            for (u16_t x = 0; x < lower.shape(0); x++) {
-                for (u16_t y = 0; y < lower.shape(1); y++) {
+            dog(lower, higher, result);
+            return result;
+        }
+
+        void dog(const vigra::MultiArrayView<2, f32_t>& lower, const vigra::MultiArrayView<2, f32_t>& higher,
+                vigra::MultiArrayView<2, f32_t> out) {
+
+            const u32_t width = lower.shape(0);
+            const u32_t height = lower.shape(1);
+            for (u32_t y = 0; y < height; y++) {
+                for (u32_t x = 0; x < width; x++) {
                     const f32_t dif = higher(x, y) - lower(x, y);
                     // don't get negative values
-                    result(x, y) = 128 + dif;
+                    out(x, y) = 128 + dif;
                 }
             }
-            return result;
         }
 
-        const vigra::Matrix<f32_t> foDerivative(const std::array<vigra::MultiArray<2, f32_t>, 3>& img, 
-                const Point<u16_t, u16_t>& p) {
-
-            const f32_t dx = (img[1](p.x - 1, p.y) - img[1](p.x + 1, p.y)) / 2;
-            const f32_t dy = (img[1](p.x, p.y - 1) - img[1](p.x, p.y + 1)) / 2;
-            const f32_t ds = (img[0](p.x, p.y) - img[2](p.x, p.y)) / 2;
+        const vigra::Matrix<f32_t> foDerivative(const Neighborhood& n) {
+            const f32_t dx = (n(-1, 0, 0) - n(1, 0, 0)) / 2;
+            const f32_t dy = (n(0, -1, 0) - n(0, 1, 0)) / 2;
+            const f32_t ds = (n(0, 0, -1) - n(0, 0, 1)) / 2;
             vigra::Matrix<f32_t> result(vigra::Shape2(3, 1));
             result(0, 0) = dx;
             result(1, 0) = dy;
@@ -76,20 +147,18 @@ namespace sift {
             return result;
         }
 
-        const vigra::Matrix<f32_t> soDerivative(const std::array<vigra::MultiArray<2, f32_t>, 3>& img, 
-                const Point<u16_t, u16_t>& p) {
-
-            const f32_t dxx = img[1](p.x + 1, p.y) + img[1](p.x - 1, p.y) - 2 * img[1](p.x, p.y);
-            const f32_t dyy = img[1](p.x, p.y + 1) + img[1](p.x, p.y - 1) - 2 * img[1](p.x, p.y);
-            const f32_t dss = img[2](p.x, p.y) + img[0](p.x, p.y) - 2 * img[1](p.x, p.y);
-            const f32_t dxy = (img[1](p.x + 1, p.y + 1) - img[1](p.x - 1, p.y + 1) - img[1](p.x + 1, p.y - 1) 
-                    + img[1](p.x - 1, p.y - 1)) / 2;
+        const vigra::Matrix<f32_t> soDerivative(const Neighborhood& n) {
+            const f32_t dxx = n(1, 0, 0) + n(-1, 0, 0) - 2 * n(0, 0, 0);
+            const f32_t dyy = n(0, 1, 0) + n(0, -1, 0) - 2 * n(0, 0, 0);
+            const f32_t dss = n(0, 0, 1) + n(0, 0, -1) - 2 * n(0, 0, 0);
+            const f32_t dxy = (n(1, 1, 0) - n(-1, 1, 0) - n(1, -1, 0) 
+                    + n(-1, -1, 0)) / 2;
 
-            const f32_t dxs = (img[2](p.x + 1, p.y) - img[2](p.x - 1, p.y) 
-                    - img[0](p.x + 1, p.y) + img[0](p.x - 1, p.y)) / 2;
+            const f32_t dxs = (n(1, 0, 1) - n(-1, 0, 1) 
+                    - n(1, 0, -1) + n(-1, 0, -1)) / 2;
 
-            f32_t dys = (img[2](p.x, p.y + 1) - img[2](p.x, p.y + 1)
-                    - img[0](p.x, p.y + 1) + img[0](p.x, p.y - 1)) / 2;
+            f32_t dys = (n(0, 1, 1) - n(0, 1, 1)
+                    - n(0, 1, -1) + n(0, -1, -1)) / 2;
             vigra::MultiArray<2, f32_t> sec_deriv(vigra::Shape2(3, 3));
 
             sec_deriv(0, 0) = dxx;
@@ -105,24 +174,26 @@ namespace sift {
             return sec_deriv;
         }
 
-        f32_t gradientMagnitude(const vigra::MultiArray<2, f32_t>& img, const Point<u16_t, u16_t>& p) {
+        f32_t gradientMagnitude(const vigra::MultiArrayView<2, f32_t>& img, const Point<u32_t, u32_t>& p) {
             return std::sqrt(std::pow(img(p.x + 1, p.y) - img(p.x - 1, p.y), 2) + 
                     std::pow(img(p.x, p.y + 1) - img(p.x, p.y - 1), 2));
         }
 
-        f32_t gradientOrientation(const vigra::MultiArray<2, f32_t>& img, const Point<u16_t, u16_t>& p) {
+        f32_t gradientOrientation(const vigra::MultiArrayView<2, f32_t>& img, const Point<u32_t, u32_t>& p) {
             const f32_t result = std::atan2(img(p.x, p.y + 1) - img(p.x, p.y - 1), img(p.x + 1, p.y) - img(p.x - 1, p.y));
             return std::fmod(result + 360, 360);
         }
 
         const std::array<f32_t, 36> orientationHistogram36(
-                const vigra::MultiArray<2, f32_t>& orientations,
-                const vigra::MultiArray<2, f32_t>& magnitudes, 
-                const vigra::MultiArray<2, f32_t>& current_gauss) {
+                const vigra::MultiArrayView<2, f32_t>& orientations,
+                const vigra::MultiArrayView<2, f32_t>& magnitudes, 
+                const vigra::MultiArrayView<2, f32_t>& current_gauss) {
 
             std::array<f32_t, 36> bins = {{0}};
-            for (u16_t x = 0; x < orientations.width(); x++) {
-                for (u16_t y = 0; y < orientations.height(); y++) {
+            const u32_t width = orientations.width();
+            const u32_t height = orientations.height();
+            for (u32_t x = 0; x < width; x++) {
+                for (u32_t y = 0; y < height; y++) {
                     const f32_t sum = magnitudes(x, y) * current_gauss(x, y);
                     u16_t i = std::floor(orientations(x, y) / 10);
                     i = i % 35;
@@ -133,13 +204,15 @@ namespace sift {
         }
 
         const std::vector<f32_t> orientationHistogram8(
-                const vigra::MultiArray<2, f32_t>& orientations,
-                const vigra::MultiArray<2, f32_t>& magnitudes, 
-                const vigra::MultiArray<2, f32_t>& current_gauss) {
+                const vigra::MultiArrayView<2, f32_t>& orientations,
+                const vigra::MultiArrayView<2, f32_t>& magnitudes, 
+                const vigra::MultiArrayView<2, f32_t>& current_gauss) {
 
             std::vector<f32_t> bins(8, 0);
-            for (u16_t x = 0; x < orientations.width(); x++) {
-                for (u16_t y = 0; y < orientations.height(); y++) {
+            const u32_t width = orientations.width();
+            const u32_t height = orientations.height();
+            for (u32_t x = 0; x < width; x++) {
+                for (u32_t y = 0; y < height; y++) {
                     const f32_t sum = magnitudes(x, y) * current_gauss(x, y);
                     u16_t i = std::floor(orientations(x, y) / 45);
                     i = i % 7;
@@ -177,14 +250,16 @@ namespace sift {
             return -res(1, 0) / (2 * res(0, 0));
         }
 
-        std::array<Point<f32_t, f32_t>, 4> rotateShape(const Point<u16_t, u16_t>& center, f32_t angle, 
-                const u16_t width, const u16_t height) {
+        std::array<Point<f32_t, f32_t>, 4> rotateShape(const Point<u32_t, u32_t>& center, f32_t angle, 
+                const u32_t width, const u32_t height) {
 
-            //Determine upper left and bottom right point
-            auto ul = Point<f32_t, f32_t>(center.x - width / 2, center.y - height / 2);
-            auto ur = Point<f32_t, f32_t>(center.x - width / 2, center.y + height / 2);
-            auto bl = Point<f32_t, f32_t>(center.x + width / 2, center.y - height / 2);
-            auto br = Point<f32_t, f32_t>(center.x + width / 2, center.y + height / 2);
+            //Determine upper left and bottom right point, in floats so a corner left of 0 stays negative
+            const f32_t cx = center.x;
+            const f32_t cy = center.y;
+            auto ul = Point<f32_t, f32_t>(cx - width / 2, cy - height / 2);
+            auto ur = Point<f32_t, f32_t>(cx - width / 2, cy + height / 2);
+            auto bl = Point<f32_t, f32_t>(cx + width / 2, cy - height / 2);
+            auto br = Point<f32_t, f32_t>(cx + width / 2, cy + height / 2);
 
             std::array<Point<f32_t, f32_t>, 4> shape{{ul, ur, bl, br}};
 
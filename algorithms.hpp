@@ -3,36 +3,78 @@
 
 #include <vigra/multi_array.hxx>
 #include <vigra/matrix.hxx>
+#include <vigra/convolution.hxx>
 
 #include "point.hpp"
+#include "neighborhood.hpp"
 #include "types.hpp"
+#include "threadpool.hpp"
 
 namespace sift {
     namespace alg {
         /**
-         * Convolves a given image with gaussian with a given sigma
+         * Convolves a given image with gaussian with a given sigma. The work is done by the
+         * vectorized separableConvolve.
          * @param input the input image which will be convolved
          * @param sigma the standard deviation for the gaussian
          * @return blured image
          */
-        const vigra::MultiArray<2, f32_t> convolveWithGauss(const vigra::MultiArray<2, f32_t>&, 
+        const vigra::MultiArray<2, f32_t> convolveWithGauss(const vigra::MultiArrayView<2, f32_t>&, 
                 f32_t);
 
+        /**
+         * Convolves a given image with an already initialized gaussian kernel into an existing
+         * image. The output rows are split into one band per thread of the pool. The result is 
+         * identical to the serial version.
+         * @param input the input image which will be convolved
+         * @param output the blured image with the same shape as the input
+         * @param filter the gaussian kernel
+         * @param pool the threads which share the work
+         * @param scratch memory for pool.size() * separableConvolveScratch(width, radius) values
+         */
+        void convolveWithGauss(const vigra::MultiArrayView<2, f32_t>&, vigra::MultiArrayView<2, f32_t>,
+                const vigra::Kernel1D<f32_t>&, ThreadPool&, f32_t*);
+
         /**
          * Resamples an image by 0.5
          * @param img the input image
+         * @param sigma the standard deviation of the gaussian, which blurs the input first
          * @return the output image
          */
-        const vigra::MultiArray<2, f32_t> reduceToNextLevel(const vigra::MultiArray<2, f32_t>&, 
+        const vigra::MultiArray<2, f32_t> reduceToNextLevel(const vigra::MultiArrayView<2, f32_t>&, 
                 f32_t);
 
         /**
-         * Resamples an image by 2
+         * Resamples an image by 0.5 into an existing image after blurring it with an already 
+         * initialized kernel. The blur is only evaluated at the pixels, which are kept, so the
+         * full sized blurred image never exists. The output rows are split into one band per
+         * thread of the pool.
+         * @param img the input image
+         * @param out the output image, which has half the size of the input rounded up
+         * @param filter the gaussian kernel
+         * @param pool the threads which share the work
+         * @param scratch memory for pool.size() * separableDecimateScratch(width, radius) values or
+         * nullptr to allocate it
+         */
+        void reduceToNextLevel(const vigra::MultiArrayView<2, f32_t>&, vigra::MultiArrayView<2, f32_t>, 
+                const vigra::Kernel1D<f32_t>&, ThreadPool&, f32_t*);
+
+        /**
+         * Resamples an image by 2 with bilinear interpolation
          * @param in the input image
          * @return the output image
          */
-        const vigra::MultiArray<2, f32_t> increaseToNextLevel(const vigra::MultiArray<2, f32_t>&,
-                f32_t);
+        const vigra::MultiArray<2, f32_t> increaseToNextLevel(const vigra::MultiArrayView<2, f32_t>&);
+
+        /**
+         * Resamples an image by 2 with bilinear interpolation straight into an existing image.
+         * The input rows are split into one band per thread of the pool.
+         * @param in the input image
+         * @param out the output image, which has the doubled size of the input
+         * @param pool the threads which share the work
+         */
+        void increaseToNextLevel(const vigra::MultiArrayView<2, f32_t>&, vigra::MultiArrayView<2, f32_t>,
+                ThreadPool&);
 
         /**
          * Calculates the Difference of Gaussian, which is the differnce between 2
@@ -41,27 +83,34 @@ namespace sift {
          * @param higher the image which lies higher in an octave
          * @return the difference of gaussian image, which contains our interest points
          */
-        const vigra::MultiArray<2, f32_t> dog(const vigra::MultiArray<2, f32_t>&, 
-                const vigra::MultiArray<2, f32_t>&);
+        const vigra::MultiArray<2, f32_t> dog(const vigra::MultiArrayView<2, f32_t>&, 
+                const vigra::MultiArrayView<2, f32_t>&);
+
+        /**
+         * Calculates the Difference of Gaussian into an existing image
+         * @param lower the image which lies lower in an octave
+         * @param higher the image which lies higher in an octave
+         * @param out the difference of gaussian image with the shape of the inputs
+         */
+        void dog(const vigra::MultiArrayView<2, f32_t>&, const vigra::MultiArrayView<2, f32_t>&,
+                vigra::MultiArrayView<2, f32_t>);
 
         /**
-         * Calculates the first order derivative of the image, at the coordinates
-         * @param img the image of which the first derivative is taken.
-         * @param p the point at which the derivative is taken
+         * Calculates the first order derivative of the DoGs, at the center of a neighborhood
+         * @param n the 3x3x3 neighborhood of the point at which the derivative is taken
          * @return the derivative as a vector (dx, dy, ds) 
          */
-        const vigra::Matrix<f32_t> foDerivative(const std::array<vigra::MultiArray<2, f32_t>, 3>&, const Point<u16_t, u16_t>&);
+        const vigra::Matrix<f32_t> foDerivative(const Neighborhood&);
 
         /**
-         * Calculates the second order derivative of the image, at the coordinates
-         * @param img the image of which the second derivative is taken.
-         * @param p the point at which the derivative is taken
+         * Calculates the second order derivative of the DoGs, at the center of a neighborhood
+         * @param n the 3x3x3 neighborhood of the point at which the derivative is taken
          * @return the derivative as a matrix 
          * (dxx, dxy, dxs)
          * (dyx, dyy, dys)
          * (dsx, dsy, dss) 
          */
-        const vigra::Matrix<f32_t> soDerivative(const std::array<vigra::MultiArray<2, f32_t>, 3>&, const Point<u16_t, u16_t>&);
+        const vigra::Matrix<f32_t> soDerivative(const Neighborhood&);
 
         /**
          * Calculates the gradient magnitude of the given image at the given position
@@ -69,7 +118,7 @@ namespace sift {
          * @param p the current point
          * @return the gradient magnitude value
          */
-        f32_t gradientMagnitude(const vigra::MultiArray<2, f32_t>&, const Point<u16_t, u16_t>&);
+        f32_t gradientMagnitude(const vigra::MultiArrayView<2, f32_t>&, const Point<u32_t, u32_t>&);
 
         /**
          * Calculates the gradient orientation of the given image at the given position
@@ -77,7 +126,7 @@ namespace sift {
          * @param p the current point
          * @return the gradient orientation value
          */
-        f32_t gradientOrientation(const vigra::MultiArray<2, f32_t>&, const Point<u16_t, u16_t>&);
+        f32_t gradientOrientation(const vigra::MultiArrayView<2, f32_t>&, const Point<u32_t, u32_t>&);
 
         /**
          * Creates an orientation Histogram of a given img and his corresponding orientations and 
@@ -89,8 +138,8 @@ namespace sift {
          * @param img the given img
          * @return histogram with 36 bins which are weighted by magnitudes and gaussian
          */
-        const std::array<f32_t, 36> orientationHistogram36(const vigra::MultiArray<2, f32_t>&, 
-                const vigra::MultiArray<2, f32_t>& , const vigra::MultiArray<2, f32_t>&);
+        const std::array<f32_t, 36> orientationHistogram36(const vigra::MultiArrayView<2, f32_t>&, 
+                const vigra::MultiArrayView<2, f32_t>& , const vigra::MultiArrayView<2, f32_t>&);
 
         /**
          * Creates an orientation Histogram of a given img and his corresponding orientations and 
@@ -102,8 +151,8 @@ namespace sift {
          * @param img the given img
          * @return histogram with 8 bins which are weighted by magnitudes and gaussian
          */
-        const std::vector<f32_t> orientationHistogram8(const vigra::MultiArray<2, f32_t>&,
-                const vigra::MultiArray<2, f32_t>&, const vigra::MultiArray<2, f32_t>&);
+        const std::vector<f32_t> orientationHistogram8(const vigra::MultiArrayView<2, f32_t>&,
+                const vigra::MultiArrayView<2, f32_t>&, const vigra::MultiArrayView<2, f32_t>&);
 
         /**
          * Calculates the vertex of a parabola, by taking a max value and its 2 neigbours
@@ -124,7 +173,7 @@ namespace sift {
          * @return array with 2 elements. First element represents upper left corner of the shape and
          * bottom right is represented by the second argument
          */
-        std::array<Point<f32_t, f32_t>, 4> rotateShape(const Point<u16_t, u16_t>&, f32_t, const u16_t, const u16_t);
+        std::array<Point<f32_t, f32_t>, 4> rotateShape(const Point<u32_t, u32_t>&, f32_t, const u32_t, const u32_t);
 
         /**
          * Normalizes a vector
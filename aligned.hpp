@@ -0,0 +1,61 @@
+#ifndef ALIGNED_HPP
+#define ALIGNED_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <new>
+
+#include "types.hpp"
+
+namespace sift {
+    /**
+     * An allocator for std::vector, which places the first element at a multiple of 64 bytes.
+     * That is the size of a cache line and of an AVX-512 register.
+     */
+    template <typename T>
+    class AlignedAllocator {
+        public:
+            typedef T value_type;
+
+            static const std::size_t alignment = 64;
+
+            AlignedAllocator() = default;
+
+            template <typename U>
+            AlignedAllocator(const AlignedAllocator<U>&) {
+            }
+
+            /**
+             * @param n the count of elements
+             * @return aligned memory for n elements
+             */
+            T* allocate(std::size_t n) {
+                //The original pointer is kept right before the aligned block
+                void* raw = ::operator new(n * sizeof(T) + alignment + sizeof(void*));
+                const std::uintptr_t start = reinterpret_cast<std::uintptr_t>(raw) + sizeof(void*);
+                void* aligned = reinterpret_cast<void*>((start + alignment - 1) / alignment * alignment);
+                static_cast<void**>(aligned)[-1] = raw;
+                return static_cast<T*>(aligned);
+            }
+
+            void deallocate(T* p, std::size_t) {
+                ::operator delete(reinterpret_cast<void**>(p)[-1]);
+            }
+
+            template <typename U>
+            struct rebind {
+                typedef AlignedAllocator<U> other;
+            };
+    };
+
+    template <typename T, typename U>
+    bool operator==(const AlignedAllocator<T>&, const AlignedAllocator<U>&) {
+        return true;
+    }
+
+    template <typename T, typename U>
+    bool operator!=(const AlignedAllocator<T>&, const AlignedAllocator<U>&) {
+        return false;
+    }
+}
+#endif //ALIGNED_HPP
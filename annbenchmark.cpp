@@ -0,0 +1,163 @@
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <string>
+#include <chrono>
+#include <random>
+#include <algorithm>
+
+#include <boost/program_options.hpp>
+
+#include "types.hpp"
+#include "descriptor.hpp"
+#include "matcher.hpp"
+#include "kdforest.hpp"
+#include "featurefile.hpp"
+
+namespace po = boost::program_options;
+
+namespace {
+    /**
+     * @param fn the function to measure
+     * @return the time of the function in seconds
+     */
+    template <typename F>
+    f64_t measure(F fn) {
+        const auto start = std::chrono::steady_clock::now();
+        fn();
+        const std::chrono::duration<f64_t> took = std::chrono::steady_clock::now() - start;
+        return took.count();
+    }
+
+    /**
+     * Normalizes every cell of a descriptor to a sum of 1 like alg::descriptor does
+     * @param d the descriptor
+     */
+    void normalizeCells(f32_t* d) {
+        for (u32_t c = 0; c < sift::alg::descriptorSize; c += 8) {
+            f32_t sum = 0;
+            for (u32_t i = c; i < c + 8; i++) {
+                sum += d[i];
+            }
+            for (u32_t i = c; i < c + 8; i++) {
+                d[i] = sum > 0 ? d[i] / sum : 0;
+            }
+        }
+    }
+
+    /**
+     * Creates descriptors, which are grouped around random centers like the descriptors of
+     * similar image structures
+     * @param count the count of descriptors
+     * @param random the random numbers
+     * @return the descriptors row by row
+     */
+    std::vector<f32_t> clustered(u32_t count, std::mt19937& random) {
+        const u32_t centers = std::max<u32_t>(1, count / 100);
+        std::uniform_real_distribution<f32_t> value(0, 1);
+        std::exponential_distribution<f32_t> peak(4);
+        std::vector<f32_t> c(centers * sift::alg::descriptorSize);
+        for (f32_t& v : c) {
+            v = peak(random);
+        }
+
+        std::normal_distribution<f32_t> noise(0, 0.05);
+        std::vector<f32_t> out(static_cast<u64_t>(count) * sift::alg::descriptorSize);
+        for (u32_t i = 0; i < count; i++) {
+            const f32_t* center = &c[(random() % centers) * sift::alg::descriptorSize];
+            f32_t* d = &out[static_cast<u64_t>(i) * sift::alg::descriptorSize];
+            for (u32_t j = 0; j < sift::alg::descriptorSize; j++) {
+                d[j] = std::max(0.0f, center[j] + noise(random) * (1 + value(random)));
+            }
+            normalizeCells(d);
+        }
+        return out;
+    }
+}
+
+/*
+ * Compares the recall and the queries per second of the KD-tree forest with an exact search for
+ * growing counts of checks
+ */
+int main(int argc, char** argv) {
+    u32_t count, queries;
+    u16_t trees, threads;
+    std::string features;
+
+    po::options_description desc("Options");
+    desc.add_options()
+        ("help", "Print help messages")
+        ("database,n", po::value<u32_t>(&count)->default_value(100000), "The count of synthetic descriptors in the index")
+        ("queries,q", po::value<u32_t>(&queries)->default_value(1000), "The count of queries")
+        ("trees", po::value<u16_t>(&trees)->default_value(4), "The count of randomized trees")
+        ("threads,t", po::value<u16_t>(&threads)->default_value(1), "How many threads build and search. 0 uses all cores")
+        ("features,f", po::value<std::string>(&features), "A binary feature file, whose descriptors are indexed instead of synthetic ones")
+        ;
+    po::variables_map vm;
+    try {
+        po::store(po::parse_command_line(argc, argv, desc), vm);
+        po::notify(vm);
+    } catch (std::exception& ex) {
+        std::cerr << ex.what() << std::endl;
+        return 1;
+    }
+    if (vm.count("help")) {
+        std::cout << desc << "\n";
+        return 1;
+    }
+
+    std::mt19937 random(42);
+    std::vector<f32_t> database;
+    if (vm.count("features")) {
+        const sift::FeatureFile file(features);
+        const sift::Span<f32_t> d = file.descriptors();
+        database.assign(d.begin(), d.end());
+        count = file.size();
+    } else {
+        database = clustered(count, random);
+    }
+    if (count == 0) {
+        std::cerr << "The database is empty" << std::endl;
+        return 1;
+    }
+
+    //The queries are disturbed descriptors of the database
+    std::normal_distribution<f32_t> noise(0, 0.02);
+    std::vector<f32_t> query(static_cast<u64_t>(queries) * sift::alg::descriptorSize);
+    for (u32_t q = 0; q < queries; q++) {
+        const f32_t* d = &database[(random() % count) * sift::alg::descriptorSize];
+        for (u32_t j = 0; j < sift::alg::descriptorSize; j++) {
+            query[q * sift::alg::descriptorSize + j] = std::max(0.0f, d[j] + noise(random));
+        }
+        normalizeCells(&query[q * sift::alg::descriptorSize]);
+    }
+
+    std::vector<sift::Match> exact;
+    sift::Matcher matcher(1, false, threads);
+    const f64_t exactTime = measure([&]() { exact = matcher.match(query.data(), queries, database.data(), count); });
+
+    sift::KdForest forest(trees, 16, threads);
+    const f64_t buildTime = measure([&]() { forest.build(database.data(), count); });
+
+    std::cout << count << " descriptors, " << queries << " queries, " << trees << " trees, built in "
+        << buildTime << "s\n";
+    std::cout << std::setw(10) << "checks" << std::setw(10) << "recall" << std::setw(14) << "queries/s"
+        << std::setw(10) << "speedup" << "\n";
+    std::cout << std::fixed << std::setprecision(4) << std::setw(10) << "brute" << std::setw(10) << 1.0
+        << std::setprecision(1) << std::setw(14) << queries / exactTime << std::setw(10) << 1.0 << "\n";
+
+    const std::vector<u32_t> checks = {16, 32, 64, 128, 256, 512, 1024, 4096, 0};
+    std::vector<u32_t> indices;
+    std::vector<f32_t> distances;
+    for (u32_t c : checks) {
+        const f64_t time = measure([&]() { forest.search(query.data(), queries, 1, c, indices, distances); });
+        u32_t found = 0;
+        for (u32_t q = 0; q < queries; q++) {
+            found += indices[q] == exact[q].train;
+        }
+        std::cout << std::setw(10) << (c == 0 ? std::string("exact") : std::to_string(c))
+            << std::setprecision(4) << std::setw(10) << static_cast<f64_t>(found) / queries
+            << std::setprecision(1) << std::setw(14) << queries / time << std::setw(10) << exactTime / time << "\n";
+    }
+    return 0;
+}
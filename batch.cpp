@@ -0,0 +1,178 @@
+#include "batch.hpp"
+
+#include <iostream>
+#include <fstream>
+#include <atomic>
+#include <thread>
+#include <chrono>
+#include <mutex>
+#include <algorithm>
+#include <stdexcept>
+
+#include <vigra/impex.hxx>
+
+#include <boost/filesystem.hpp>
+#include <boost/algorithm/string.hpp>
+
+#include "boundedqueue.hpp"
+#include "output.hpp"
+
+namespace sift {
+    namespace {
+        /**
+         * An image between the decode and the compute stage
+         */
+        struct Decoded {
+            std::string file;
+            vigra::MultiArray<2, f32_t> img;
+        };
+
+        /**
+         * The features of an image between the compute and the write stage. The image is only
+         * kept for the overlay.
+         */
+        struct Calculated {
+            std::string file;
+            vigra::MultiArray<2, f32_t> img;
+            DescriptorSet set;
+        };
+
+        const std::vector<std::string> extensions = {".png", ".jpg", ".jpeg", ".tif", ".tiff", ".bmp",
+            ".gif", ".pgm", ".ppm", ".pnm"};
+    }
+
+    BatchStats Batch::run(const std::vector<std::string>& files) const {
+        BatchStats stats;
+        const auto start = std::chrono::steady_clock::now();
+
+        BoundedQueue<Decoded> decoded(_depth);
+        BoundedQueue<Calculated> calculated(_depth);
+        std::atomic<u32_t> next(0);
+        std::atomic<u32_t> failed(0);
+        std::mutex log;
+        auto fail = [&](const std::string& file, const std::exception& ex) {
+            std::lock_guard<std::mutex> lock(log);
+            std::cerr << file << ": " << ex.what() << std::endl;
+            failed++;
+        };
+
+        //The last thread of a stage closes the queue to the next stage
+        std::atomic<u16_t> decoding(_decoders);
+        std::vector<std::thread> decoders;
+        for (u16_t d = 0; d < _decoders; d++) {
+            decoders.emplace_back([&]() {
+                for (u32_t i = next++; i < files.size(); i = next++) {
+                    Decoded current;
+                    current.file = files[i];
+                    try {
+                        vigra::ImageImportInfo info(current.file.c_str());
+                        current.img.reshape(vigra::Shape2(info.shape()));
+                        vigra::importImage(info, current.img);
+                    } catch (std::exception& ex) {
+                        fail(current.file, ex);
+                        continue;
+                    }
+                    decoded.push(std::move(current));
+                }
+                if (--decoding == 0)
+                    decoded.close();
+            });
+        }
+
+        std::atomic<u16_t> computing(_workers);
+        std::atomic<u16_t> created(_workers);
+        std::vector<std::thread> workers;
+        for (u16_t w = 0; w < _workers; w++) {
+            workers.emplace_back([&]() {
+                std::unique_ptr<Sift> sift;
+                Decoded current;
+                try {
+                    sift = _create();
+                } catch (std::exception& ex) {
+                    {
+                        std::lock_guard<std::mutex> lock(log);
+                        std::cerr << "A worker couldn't be created: " << ex.what() << std::endl;
+                    }
+                    //Without any worker the images fail, so the decoders don't wait for a full queue
+                    if (--created == 0) {
+                        while (decoded.pop(current)) {
+                            fail(current.file, ex);
+                        }
+                    }
+                }
+                while (sift && decoded.pop(current)) {
+                    Calculated result;
+                    result.file = current.file;
+                    try {
+                        sift->calculate(current.img, result.set);
+                    } catch (std::exception& ex) {
+                        fail(current.file, ex);
+                        continue;
+                    }
+                    if (_overlay)
+                        result.img = std::move(current.img);
+                    calculated.push(std::move(result));
+                }
+                if (--computing == 0)
+                    calculated.close();
+            });
+        }
+
+        //The writer runs on the calling thread
+        Calculated current;
+        while (calculated.pop(current)) {
+            try {
+                if (_result)
+                    writeResult(current.file, current.set, _format);
+                if (_overlay)
+                    writeOverlay(current.file + "_orientation.png", current.img, current.set);
+            } catch (std::exception& ex) {
+                fail(current.file, ex);
+                continue;
+            }
+            stats.images++;
+            stats.keypoints += current.set.size();
+        }
+
+        for (std::thread& t : decoders) {
+            t.join();
+        }
+        for (std::thread& t : workers) {
+            t.join();
+        }
+
+        const std::chrono::duration<f64_t> took = std::chrono::steady_clock::now() - start;
+        stats.seconds = took.count();
+        stats.failed = failed;
+        return stats;
+    }
+
+    std::vector<std::string> Batch::collect(const std::string& input) {
+        namespace fs = boost::filesystem;
+        std::vector<std::string> files;
+
+        if (fs::is_directory(input)) {
+            for (fs::recursive_directory_iterator it(input), end; it != end; ++it) {
+                if (!fs::is_regular_file(it->status()))
+                    continue;
+                const std::string extension = boost::algorithm::to_lower_copy(it->path().extension().string());
+                if (std::find(extensions.begin(), extensions.end(), extension) != extensions.end())
+                    files.push_back(it->path().string());
+            }
+            std::sort(files.begin(), files.end());
+            return files;
+        }
+
+        std::ifstream list(input);
+        if (!list)
+            throw std::runtime_error("Can't read " + input);
+
+        std::string line;
+        while (std::getline(list, line)) {
+            boost::algorithm::trim(line);
+            if (!line.empty())
+                files.push_back(line);
+        }
+        return files;
+    }
+}
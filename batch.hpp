@@ -0,0 +1,116 @@
+#ifndef BATCH_HPP
+#define BATCH_HPP
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <functional>
+
+#include "types.hpp"
+#include "sift.hpp"
+#include "output.hpp"
+
+namespace sift {
+    /**
+     * The counters of a batch run
+     */
+    class BatchStats {
+        public:
+            /**
+             * The count of images, whose features were calculated
+             */
+            u32_t images = 0;
+
+            /**
+             * The count of images, which couldn't be decoded, calculated or written
+             */
+            u32_t failed = 0;
+
+            /**
+             * The count of interest points of all images
+             */
+            u64_t keypoints = 0;
+
+            /**
+             * The wall clock time of the whole run
+             */
+            f64_t seconds = 0;
+
+            /**
+             * @return the throughput of the run
+             */
+            f64_t imagesPerSecond() const {
+                return seconds > 0 ? images / seconds : 0;
+            }
+    };
+
+    /**
+     * Calculates the features of many images in a pipeline of three stages, which are connected
+     * by BoundedQueues. Decoders read the images, a pool of compute workers runs one Sift object
+     * each and a single writer stores the results. So decoding and writing overlap with the
+     * calculation, while never more than a few images are in memory.
+     */
+    class Batch {
+        private:
+            /**
+             * Creates the Sift object of a compute worker
+             */
+            const std::function<std::unique_ptr<Sift>()> _create;
+
+            const u16_t _workers;
+
+            const u16_t _decoders;
+
+            /**
+             * The capacity of the queues between the stages
+             */
+            const u32_t _depth;
+
+            /**
+             * Wether every image gets an _orientation.png overlay
+             */
+            const bool _overlay;
+
+            /**
+             * Wether the features of every image are written to a file
+             */
+            const bool _result;
+
+            const ResultFormat _format;
+
+        public:
+            /**
+             * @param create creates the Sift object of a compute worker
+             * @param workers how many images are calculated at the same time
+             * @param decoders how many images are decoded at the same time
+             * @param depth how many images may wait between two stages
+             * @param overlay wether the interest points are drawn onto every image
+             * @param result wether the features of every image are written to <image>.txt or
+             * <image>.sift
+             * @param format the format of the written features
+             */
+            explicit Batch(std::function<std::unique_ptr<Sift>()> create, u16_t workers = 1,
+                    u16_t decoders = 1, u32_t depth = 4, bool overlay = false, bool result = false,
+                    ResultFormat format = ResultFormat::text) :
+                _create(create), _workers(workers > 0 ? workers : 1), _decoders(decoders > 0 ? decoders : 1),
+                _depth(depth), _overlay(overlay), _result(result), _format(format) {
+            }
+
+            /**
+             * Calculates the features of all images. Images, which fail, are reported on stderr and
+             * counted, but don't stop the run.
+             * @param files the paths of the images
+             * @return the counters of the run
+             */
+            BatchStats run(const std::vector<std::string>&) const;
+
+            /**
+             * Collects the images of a batch
+             * @param input a directory, which is searched recursively for images, or a text file
+             * with one path per line
+             * @return the paths of the images in a stable order
+             */
+            static std::vector<std::string> collect(const std::string&);
+    };
+}
+#endif //BATCH_HPP
@@ -0,0 +1,771 @@
+#include <iostream>
+#include <iomanip>
+#include <cmath>
+#include <vector>
+#include <string>
+#include <chrono>
+#include <random>
+#include <algorithm>
+#include <functional>
+#include <map>
+#include <tuple>
+
+#include <vigra/multi_array.hxx>
+#include <vigra/convolution.hxx>
+
+#include <boost/program_options.hpp>
+#include <boost/algorithm/string.hpp>
+
+#include "types.hpp"
+#include "sift.hpp"
+#include "algorithms.hpp"
+#include "convolution.hpp"
+#include "gradient.hpp"
+#include "extrema.hpp"
+#include "descriptor.hpp"
+#include "descriptorset.hpp"
+
+namespace po = boost::program_options;
+
+namespace sift {
+    /**
+     * Runs the private stages of a Sift object one by one. Every stage needs the state the stages
+     * before left in the context, so they have to be called in the order of the calculation.
+     */
+    class SiftBench {
+        public:
+            static void createGaussians(const Sift& sift, SiftContext& context,
+                    const vigra::MultiArrayView<2, f32_t>& img) {
+
+                context._workspace.reserve(img.shape(), sift._octaves, sift._dogsPerEpoch, sift.subpixel,
+                        sift._radius, sift._pool.size(), sift._precision);
+                sift._createGaussians(img, context._workspace);
+            }
+
+            static void findScaleSpaceExtrema(const Sift& sift, SiftContext& context,
+                    std::vector<InterestPoint>& points, std::vector<Neighborhood>& neighborhoods) {
+
+                points.clear();
+                neighborhoods.clear();
+                sift._findScaleSpaceExtrema(context._workspace, points, neighborhoods);
+            }
+
+            static void eliminateEdgeResponses(const Sift& sift, std::vector<InterestPoint>& points,
+                    const std::vector<Neighborhood>& neighborhoods) {
+
+                sift._eliminateEdgeResponses(points, neighborhoods);
+            }
+
+            static void createGradients(const Sift& sift, SiftContext& context,
+                    const std::vector<InterestPoint>& points) {
+
+                sift._createGradients(context._workspace, points);
+            }
+
+            static void orientationAssignment(const Sift& sift, const SiftContext& context,
+                    std::vector<InterestPoint>& points) {
+
+                sift._orientationAssignment(context._workspace, points);
+            }
+
+            static void createDescriptors(const Sift& sift, const SiftContext& context,
+                    const std::vector<InterestPoint>& points, DescriptorSet& set) {
+
+                sift._createDescriptors(context._workspace, points, set);
+            }
+
+            /**
+             * Removes the filtered interest points like the calculation does between the stages
+             * @param points the interest points
+             */
+            static void removeFiltered(std::vector<InterestPoint>& points) {
+                std::stable_sort(points.begin(), points.end(), InterestPoint::cmpByFilter);
+                points.erase(std::find_if(points.begin(), points.end(),
+                            [](const InterestPoint& p) { return p.filtered; }), points.end());
+            }
+    };
+}
+
+namespace {
+    /**
+     * The timings of a single benchmark
+     */
+    struct Result {
+        std::string bench;
+        std::string pattern;
+        u32_t size;
+
+        /**
+         * The sigma of the Gaussian of a convolution benchmark, 0 for the others
+         */
+        f32_t sigma;
+        u16_t repetitions;
+
+        /**
+         * The median of the repetitions in seconds
+         */
+        f64_t median;
+
+        /**
+         * The median absolute deviation of the repetitions from the median in seconds
+         */
+        f64_t mad;
+    };
+
+    f64_t median(std::vector<f64_t> values) {
+        std::sort(values.begin(), values.end());
+        const u32_t n = values.size();
+        return n % 2 == 1 ? values[n / 2] : (values[n / 2 - 1] + values[n / 2]) / 2;
+    }
+
+    /**
+     * Creates a synthetic test image
+     * @param pattern "noise", "checkerboard" or "fractal"
+     * @param size the width and height of the image
+     * @return the image with values in [0, 255]
+     */
+    vigra::MultiArray<2, f32_t> syntheticImage(const std::string& pattern, u32_t size) {
+        vigra::MultiArray<2, f32_t> img(vigra::Shape2(size, size));
+        std::mt19937 random(42);
+        std::uniform_real_distribution<f32_t> uniform(0, 255);
+
+        if (pattern == "noise") {
+            for (f32_t& p : img) {
+                p = uniform(random);
+            }
+        } else if (pattern == "checkerboard") {
+            const u32_t square = 16;
+            for (u32_t y = 0; y < size; y++) {
+                for (u32_t x = 0; x < size; x++) {
+                    img(x, y) = ((x / square + y / square) % 2) * 255;
+                }
+            }
+        } else if (pattern == "fractal") {
+            //Value noise of many octaves, where every octave has half the amplitude and twice
+            //the frequency of the one before. The spectrum falls off like 1/f like the one of
+            //natural images.
+            f32_t amplitude = 1;
+            f32_t total = 0;
+            for (u32_t cells = 4; cells <= size; cells *= 2) {
+                std::vector<f32_t> grid((cells + 1) * (cells + 1));
+                for (f32_t& g : grid) {
+                    g = uniform(random);
+                }
+                const f32_t step = static_cast<f32_t>(cells) / size;
+                for (u32_t y = 0; y < size; y++) {
+                    const f32_t gy = y * step;
+                    const u32_t y0 = gy;
+                    const f32_t fy = gy - y0;
+                    for (u32_t x = 0; x < size; x++) {
+                        const f32_t gx = x * step;
+                        const u32_t x0 = gx;
+                        const f32_t fx = gx - x0;
+                        const f32_t* row0 = &grid[y0 * (cells + 1) + x0];
+                        const f32_t* row1 = row0 + cells + 1;
+                        const f32_t top = row0[0] + (row0[1] - row0[0]) * fx;
+                        const f32_t bottom = row1[0] + (row1[1] - row1[0]) * fx;
+                        img(x, y) += amplitude * (top + (bottom - top) * fy);
+                    }
+                }
+                total += amplitude;
+                amplitude /= 2;
+            }
+            for (f32_t& p : img) {
+                p /= total;
+            }
+        } else {
+            throw std::invalid_argument("Unknown pattern " + pattern);
+        }
+        return img;
+    }
+
+    /**
+     * Times benchmarks and collects their results
+     */
+    class Runner {
+        private:
+            const u16_t _warmup;
+            const u16_t _repetitions;
+            const std::string _filter;
+
+        public:
+            std::vector<Result> results;
+
+            Runner(u16_t warmup, u16_t repetitions, const std::string& filter) :
+                _warmup(warmup), _repetitions(std::max<u16_t>(repetitions, 1)), _filter(filter) {
+            }
+
+            /**
+             * @param bench the name of a benchmark
+             * @return wether the benchmark is selected by the filter
+             */
+            bool selected(const std::string& bench) const {
+                return _filter.empty() || bench.find(_filter) != std::string::npos;
+            }
+
+            /**
+             * Runs a benchmark the warm-up count of times and then measures its repetitions
+             * @param bench the name of the benchmark
+             * @param pattern the name of the test image
+             * @param size the size of the test image
+             * @param prepare runs before every repetition and isn't measured
+             * @param fn the function to measure
+             * @param sigma the sigma of a convolution benchmark, 0 for the others
+             */
+            void run(const std::string& bench, const std::string& pattern, u32_t size,
+                    const std::function<void()>& prepare, const std::function<void()>& fn, f32_t sigma = 0) {
+
+                if (!selected(bench))
+                    return;
+
+                for (u16_t i = 0; i < _warmup; i++) {
+                    prepare();
+                    fn();
+                }
+                std::vector<f64_t> times;
+                for (u16_t i = 0; i < _repetitions; i++) {
+                    prepare();
+                    const auto start = std::chrono::steady_clock::now();
+                    fn();
+                    const std::chrono::duration<f64_t> took = std::chrono::steady_clock::now() - start;
+                    times.push_back(took.count());
+                }
+
+                const f64_t m = median(times);
+                std::vector<f64_t> deviations;
+                for (f64_t t : times) {
+                    deviations.push_back(std::abs(t - m));
+                }
+                results.push_back({bench, pattern, size, sigma, _repetitions, m, median(deviations)});
+                std::cerr << bench << " " << pattern << " " << size;
+                if (sigma > 0)
+                    std::cerr << " sigma " << sigma;
+                std::cerr << ": " << m << "s\n";
+            }
+
+            void run(const std::string& bench, const std::string& pattern, u32_t size,
+                    const std::function<void()>& fn) {
+                run(bench, pattern, size, []() {}, fn);
+            }
+
+            void run(const std::string& bench, const std::string& pattern, u32_t size, f32_t sigma,
+                    const std::function<void()>& fn) {
+                run(bench, pattern, size, []() {}, fn, sigma);
+            }
+    };
+
+    void writeTable(std::ostream& out, const std::vector<Result>& results) {
+        out << std::left << std::setw(34) << "benchmark" << std::setw(14) << "pattern" << std::right
+            << std::setw(6) << "size" << std::setw(7) << "sigma" << std::setw(14) << "median ms" << std::setw(12) << "MAD ms"
+            << std::setw(12) << "MP/s" << "\n";
+        for (const Result& r : results) {
+            out << std::left << std::setw(34) << r.bench << std::setw(14) << r.pattern << std::right
+                << std::fixed << std::setprecision(3) << std::setw(6) << r.size << std::setw(7);
+            if (r.sigma > 0)
+                out << std::setprecision(2) << r.sigma << std::setprecision(3);
+            else
+                out << "-";
+            out << std::setw(14) << r.median * 1e3 << std::setw(12) << r.mad * 1e3
+                << std::setprecision(1) << std::setw(12) << static_cast<f64_t>(r.size) * r.size / 1e6 / r.median << "\n";
+        }
+    }
+
+    void writeCsv(std::ostream& out, const std::vector<Result>& results) {
+        out << "benchmark,pattern,width,height,sigma,repetitions,median_s,mad_s,megapixels_per_s\n";
+        for (const Result& r : results) {
+            out << r.bench << "," << r.pattern << "," << r.size << "," << r.size << ",";
+            if (r.sigma > 0)
+                out << std::setprecision(3) << r.sigma;
+            out << "," << r.repetitions << ","
+                << std::setprecision(9) << r.median << "," << r.mad << "," << static_cast<f64_t>(r.size) * r.size / 1e6 / r.median << "\n";
+        }
+    }
+
+    void writeJson(std::ostream& out, const std::vector<Result>& results) {
+        out << "[\n";
+        for (u32_t i = 0; i < results.size(); i++) {
+            const Result& r = results[i];
+            out << "  {\"benchmark\": \"" << r.bench << "\", \"pattern\": \"" << r.pattern << "\", \"width\": "
+                << r.size << ", \"height\": " << r.size << ", \"sigma\": ";
+            if (r.sigma > 0)
+                out << std::setprecision(3) << r.sigma;
+            else
+                out << "null";
+            out << ", \"repetitions\": " << r.repetitions
+                << ", \"median_s\": " << std::setprecision(9) << r.median << ", \"mad_s\": " << r.mad
+                << ", \"megapixels_per_s\": " << static_cast<f64_t>(r.size) * r.size / 1e6 / r.median << "}"
+                << (i + 1 < results.size() ? "," : "") << "\n";
+        }
+        out << "]\n";
+    }
+
+    /**
+     * Times the alg:: functions on a test image
+     */
+    void benchAlgorithms(Runner& runner, const std::string& pattern, const vigra::MultiArray<2, f32_t>& img,
+            sift::ThreadPool& pool) {
+
+        const u32_t size = img.width();
+        const f32_t sigma = 1.6;
+        vigra::Kernel1D<f32_t> filter;
+        filter.initGaussian(sigma);
+
+        //Both convolutions over the sigmas of all levels up to large radii, where the strips and
+        //the ring buffer of the own engine matter most
+        const std::vector<f32_t> sigmas = {1.6, 2.26, 3.2, 4.53, 6.4, 8, 10};
+        vigra::MultiArray<2, f32_t> blurred(img.shape());
+        std::vector<f32_t> scratch;
+        for (f32_t s : sigmas) {
+            vigra::Kernel1D<f32_t> kernel;
+            kernel.initGaussian(s);
+            scratch.resize(pool.size() * sift::alg::separableConvolveScratch(size, kernel.right()));
+            runner.run("alg::convolveWithGauss", pattern, size, s, [&]() {
+                        sift::alg::convolveWithGauss(img, blurred, kernel, pool, scratch.data());
+                    });
+            runner.run("alg::convolveWithGaussVigra", pattern, size, s, [&]() {
+                        sift::alg::convolveWithGaussVigra(img, kernel);
+                    });
+        }
+
+        scratch.resize(pool.size() * sift::alg::separableDecimateScratch(size, filter.right()));
+
+        vigra::MultiArray<2, f32_t> half(vigra::Shape2((size + 1) / 2, (size + 1) / 2));
+        runner.run("alg::reduceToNextLevel", pattern, size, [&]() {
+                    sift::alg::reduceToNextLevel(img, half, filter, pool, scratch.data());
+                });
+        if (runner.selected("alg::increaseToNextLevel")) {
+            vigra::MultiArray<2, f32_t> doubled(vigra::Shape2(size * 2, size * 2));
+            runner.run("alg::increaseToNextLevel", pattern, size, [&]() {
+                        sift::alg::increaseToNextLevel(img, doubled, pool);
+                    });
+        }
+
+        //4 Gaussians of increasing blur for the DoGs and the extrema
+        std::vector<vigra::MultiArray<2, f32_t>> gaussians;
+        std::vector<vigra::MultiArrayView<2, f32_t>> views;
+        for (u16_t i = 0; i < 4; i++) {
+            vigra::Kernel1D<f32_t> k;
+            k.initGaussian(sigma * std::pow(std::sqrt(2.0f), i));
+            std::vector<f32_t> s(sift::alg::separableConvolveScratch(size, k.right()));
+            gaussians.emplace_back(img.shape());
+            sift::alg::separableConvolve(img, gaussians.back(), sift::alg::symmetricTaps(k), 0, size, s.data());
+        }
+        for (auto& g : gaussians) {
+            views.emplace_back(g);
+        }
+
+        vigra::MultiArray<2, f32_t> dog(img.shape());
+        runner.run("alg::dog", pattern, size, [&]() {
+                    sift::alg::dog(gaussians[0], gaussians[1], dog);
+                });
+
+        std::vector<sift::alg::Extremum> extrema;
+        runner.run("alg::findExtrema", pattern, size, [&]() { extrema.clear(); }, [&]() {
+                    sift::alg::findExtrema(views, 0, size, 0, extrema, nullptr);
+                });
+
+        vigra::MultiArray<2, f32_t> magnitudes(img.shape());
+        vigra::MultiArray<2, f32_t> orientations(img.shape());
+        runner.run("alg::gradients", pattern, size, [&]() {
+                    sift::alg::gradients(gaussians[1], magnitudes, orientations, 0, 0, size, size);
+                });
+
+        //A descriptor on a grid of every 16th pixel
+        const sift::alg::DescriptorWeights weights = sift::alg::descriptorWeights(sift::alg::descriptorWindow / 2);
+        const u32_t w = sift::alg::descriptorWindow;
+        std::vector<f32_t> out(sift::alg::descriptorSize);
+        runner.run("alg::descriptor", pattern, size, [&]() {
+                    for (u32_t y = 0; y + w <= size; y += w) {
+                        for (u32_t x = 0; x + w <= size; x += w) {
+                            sift::alg::descriptor(magnitudes.subarray(vigra::Shape2(x, y), vigra::Shape2(x + w, y + w)),
+                                    orientations.subarray(vigra::Shape2(x, y), vigra::Shape2(x + w, y + w)),
+                                    30, weights, out.data());
+                        }
+                    }
+                });
+    }
+
+    /**
+     * Times the stages of a Sift calculation on a test image. Every stage runs on the state,
+     * which the stages before left behind.
+     */
+    void benchStages(Runner& runner, const std::string& pattern, const vigra::MultiArray<2, f32_t>& img,
+            u16_t octaves, u16_t threads) {
+
+        const std::vector<std::string> stages = {"Sift::calculate", "Sift::_createGaussians",
+            "Sift::_findScaleSpaceExtrema", "Sift::_eliminateEdgeResponses", "Sift::_createGradients",
+            "Sift::_orientationAssignment", "Sift::_createDescriptors"};
+        if (std::none_of(stages.begin(), stages.end(), [&runner](const std::string& s) { return runner.selected(s); }))
+            return;
+
+        const u32_t size = img.width();
+        const sift::Sift sift(3, octaves, 1.6, std::sqrt(2), false, threads);
+        sift::SiftContext context;
+        sift::DescriptorSet set;
+
+        runner.run("Sift::calculate", pattern, size, [&]() {
+                    sift.calculate(img, set, context);
+                });
+
+        runner.run("Sift::_createGaussians", pattern, size, [&]() {
+                    sift::SiftBench::createGaussians(sift, context, img);
+                });
+        //The stages below need the Gaussians, even if their benchmark wasn't selected
+        sift::SiftBench::createGaussians(sift, context, img);
+
+        std::vector<sift::InterestPoint> candidates;
+        std::vector<sift::Neighborhood> neighborhoods;
+        runner.run("Sift::_findScaleSpaceExtrema", pattern, size, [&]() {
+                    sift::SiftBench::findScaleSpaceExtrema(sift, context, candidates, neighborhoods);
+                });
+        sift::SiftBench::findScaleSpaceExtrema(sift, context, candidates, neighborhoods);
+
+        std::vector<sift::InterestPoint> points;
+        runner.run("Sift::_eliminateEdgeResponses", pattern, size, [&]() { points = candidates; }, [&]() {
+                    sift::SiftBench::eliminateEdgeResponses(sift, points, neighborhoods);
+                });
+        points = candidates;
+        sift::SiftBench::eliminateEdgeResponses(sift, points, neighborhoods);
+        sift::SiftBench::removeFiltered(points);
+
+        runner.run("Sift::_createGradients", pattern, size, [&]() {
+                    sift::SiftBench::createGradients(sift, context, points);
+                });
+        sift::SiftBench::createGradients(sift, context, points);
+
+        std::vector<sift::InterestPoint> oriented;
+        runner.run("Sift::_orientationAssignment", pattern, size, [&]() { oriented = points; }, [&]() {
+                    sift::SiftBench::orientationAssignment(sift, context, oriented);
+                });
+        oriented = points;
+        sift::SiftBench::orientationAssignment(sift, context, oriented);
+        sift::SiftBench::removeFiltered(oriented);
+
+        runner.run("Sift::_createDescriptors", pattern, size, [&]() {
+                    sift::SiftBench::createDescriptors(sift, context, oriented, set);
+                });
+    }
+
+    /**
+     * The difference of the features of a reduced precision to the ones of f32 on a test image
+     */
+    struct Comparison {
+        std::string precision;
+        std::string pattern;
+        u32_t size;
+        u32_t keypoints;
+
+        /**
+         * The share of the f32 keypoints, which have a keypoint at the same position and scale
+         * with an orientation at most 1 apart
+         */
+        f64_t repeatability;
+
+        /**
+         * The mean and the largest L2 distance of the descriptors of a grid of windows, which
+         * don't depend on the orientation assignment. The orientations are turned into degrees
+         * first, so the gradients spread over all 8 bins.
+         */
+        f64_t meanDrift;
+        f64_t maxDrift;
+
+        /**
+         * The largest error of a stored magnitude relative to the magnitude, but at least 1, and
+         * the largest error of a stored orientation
+         */
+        f64_t magnitudeError;
+        f64_t orientationError;
+
+        u64_t workspaceBytes;
+
+        /**
+         * The median time of a calculation in seconds
+         */
+        f64_t median;
+    };
+
+    /**
+     * Compares the features of a reduced precision with the ones of f32
+     * @param reference the features of the f32 precision
+     * @param reduced the features of the reduced precision
+     * @param c takes the keypoint count and the repeatability
+     */
+    void compareFeatures(const sift::DescriptorSet& reference, const sift::DescriptorSet& reduced, Comparison& c) {
+        //The Gaussians are f32 in every precision, so the positions and scales are the same and
+        //only the orientations and descriptors can differ
+        std::map<std::tuple<f32_t, f32_t, f32_t>, std::vector<u32_t>> located;
+        for (u32_t i = 0; i < reduced.size(); i++) {
+            located[std::make_tuple(reduced.x[i], reduced.y[i], reduced.scale[i])].push_back(i);
+        }
+
+        u32_t repeated = 0;
+        c.keypoints = reduced.size();
+        for (u32_t i = 0; i < reference.size(); i++) {
+            const auto candidates = located.find(std::make_tuple(reference.x[i], reference.y[i], reference.scale[i]));
+            if (candidates == located.end())
+                continue;
+
+            f32_t closest = 1;
+            u32_t match = 0;
+            for (u32_t j : candidates->second) {
+                //vertexParabola gives NaN for a singular parabola, which is the same peak in both
+                const f32_t difference = std::abs(reference.orientation[i] - reduced.orientation[j]);
+                const f32_t angle = std::isnan(reference.orientation[i]) && std::isnan(reduced.orientation[j]) ? 0 :
+                    std::min(difference, 360 - difference);
+                if (angle <= closest) {
+                    closest = angle;
+                    match = j + 1;
+                }
+            }
+            if (match > 0)
+                repeated++;
+        }
+        c.repeatability = reference.size() > 0 ? static_cast<f64_t>(repeated) / reference.size() : 1;
+    }
+
+    /**
+     * The gradients keep atan2 in radians plus 360, wrapped below 360, so every orientation
+     * falls into the first or the last 6 degrees and into a single bin of a descriptor
+     * @param orientations the stored orientations, which take the same orientations in degrees
+     */
+    void toDegrees(vigra::MultiArray<2, f32_t>& orientations) {
+        const f64_t pi = 3.14159265358979;
+        for (f32_t& angle : orientations) {
+            const f64_t radians = angle >= 180 ? angle - 360.0 : angle;
+            const f64_t degrees = radians * 180 / pi;
+            angle = degrees < 0 ? degrees + 360 : degrees;
+        }
+    }
+
+    /**
+     * Compares the descriptors of every 16th pixel of a blurred test image, whose gradients are
+     * stored in a reduced precision, with the ones of f32 gradients
+     * @param img the blurred test image
+     * @param precision the reduced precision
+     * @param c takes the drift and the errors of the gradients
+     */
+    void compareWindows(const vigra::MultiArray<2, f32_t>& img, sift::Precision precision, Comparison& c) {
+        const u32_t width = img.width();
+        const u32_t height = img.height();
+        vigra::MultiArray<2, f32_t> magnitudes(img.shape()), orientations(img.shape());
+        sift::alg::gradients(img, magnitudes, orientations, 0, 0, width, height);
+
+        vigra::MultiArray<2, f32_t> decodedMagnitudes(magnitudes), decodedOrientations(orientations);
+        if (precision != sift::Precision::f32) {
+            vigra::MultiArray<2, u16_t> packedMagnitudes(img.shape()), packedOrientations(img.shape());
+            sift::alg::gradients(img, packedMagnitudes, packedOrientations, precision, 0, 0, width, height);
+            sift::alg::loadMagnitudes(packedMagnitudes.data(), decodedMagnitudes.data(), width * height, precision);
+            sift::alg::loadOrientations(packedOrientations.data(), decodedOrientations.data(), width * height,
+                    precision);
+        }
+
+        c.magnitudeError = 0;
+        c.orientationError = 0;
+        for (u32_t i = 0; i < width * height; i++) {
+            const f64_t magnitude = magnitudes.data()[i];
+            c.magnitudeError = std::max(c.magnitudeError,
+                    std::abs(decodedMagnitudes.data()[i] - magnitude) / std::max(magnitude, 1.0));
+            const f64_t difference = std::abs(decodedOrientations.data()[i] - orientations.data()[i]);
+            c.orientationError = std::max(c.orientationError, std::min(difference, 360 - difference));
+        }
+
+        //In the stored orientations every gradient falls into one bin and both descriptors are equal
+        toDegrees(orientations);
+        toDegrees(decodedOrientations);
+        const sift::alg::DescriptorWeights weights = sift::alg::descriptorWeights(sift::alg::descriptorWindow / 2);
+        const u32_t w = sift::alg::descriptorWindow;
+        std::vector<f32_t> reference(sift::alg::descriptorSize), reduced(sift::alg::descriptorSize);
+        f64_t drift = 0;
+        u32_t windows = 0;
+        c.maxDrift = 0;
+        for (u32_t y = 0; y + w <= height; y += w) {
+            for (u32_t x = 0; x + w <= width; x += w) {
+                const vigra::Shape2 from(x, y), to(x + w, y + w);
+                sift::alg::descriptor(magnitudes.subarray(from, to), orientations.subarray(from, to), 0, weights,
+                        reference.data());
+                sift::alg::descriptor(decodedMagnitudes.subarray(from, to), decodedOrientations.subarray(from, to),
+                        0, weights, reduced.data());
+
+                f64_t distance = 0;
+                for (u32_t d = 0; d < sift::alg::descriptorSize; d++) {
+                    distance += (reference[d] - reduced[d]) * (reference[d] - reduced[d]);
+                }
+                distance = std::sqrt(distance);
+                drift += distance;
+                c.maxDrift = std::max(c.maxDrift, distance);
+                windows++;
+            }
+        }
+        c.meanDrift = windows > 0 ? drift / windows : 0;
+    }
+
+    /**
+     * Calculates the features of a test image in every precision and compares them with f32
+     */
+    void comparePrecisions(Runner& runner, std::vector<Comparison>& comparisons, const std::string& pattern,
+            const vigra::MultiArray<2, f32_t>& img, u16_t octaves, u16_t threads) {
+
+        const u32_t size = img.width();
+        vigra::Kernel1D<f32_t> filter;
+        filter.initGaussian(1.6);
+        vigra::MultiArray<2, f32_t> blurred(img.shape());
+        sift::alg::separableConvolve(img, blurred, sift::alg::symmetricTaps(filter), 0, size, nullptr);
+
+        sift::DescriptorSet reference;
+        for (sift::Precision precision : {sift::Precision::f32, sift::Precision::f16, sift::Precision::u16}) {
+            const sift::Sift sift(3, octaves, 1.6, std::sqrt(2), false, threads, false, 0, precision);
+            sift::SiftContext context;
+            sift::DescriptorSet set;
+            runner.run("Sift::calculate " + sift::toString(precision), pattern, size, [&]() {
+                        sift.calculate(img, set, context);
+                    });
+
+            Comparison c;
+            c.precision = sift::toString(precision);
+            c.pattern = pattern;
+            c.size = size;
+            c.workspaceBytes = sift.workspaceBytes(img.shape());
+            c.median = runner.results.back().median;
+            if (precision == sift::Precision::f32)
+                reference = set;
+            compareFeatures(reference, set, c);
+            compareWindows(blurred, precision, c);
+            comparisons.push_back(c);
+        }
+    }
+
+    void writeComparisons(std::ostream& out, const std::vector<Comparison>& comparisons, const std::string& format) {
+        //The f32 row of the same image, which every row is relative to
+        auto reference = [&comparisons](const Comparison& c) {
+            return *std::find_if(comparisons.begin(), comparisons.end(), [&c](const Comparison& r) {
+                        return r.pattern == c.pattern && r.size == c.size && r.precision == "f32";
+                    });
+        };
+
+        if (format == "table") {
+            out << std::left << std::setw(10) << "precision" << std::setw(14) << "pattern" << std::right
+                << std::setw(6) << "size" << std::setw(11) << "keypoints" << std::setw(10) << "repeated"
+                << std::setw(12) << "mean drift" << std::setw(11) << "max drift" << std::setw(15) << "magnitude err"
+                << std::setw(17) << "orientation err" << std::setw(14) << "workspace MB"
+                << std::setw(9) << "memory" << std::setw(12) << "median ms" << std::setw(9) << "speedup" << "\n";
+        } else if (format == "csv") {
+            out << "precision,pattern,width,height,keypoints,repeatability,mean_drift,max_drift,magnitude_error,"
+                << "orientation_error,workspace_bytes,"
+                << "memory_ratio,median_s,speedup\n";
+        } else {
+            out << "[\n";
+        }
+
+        for (u32_t i = 0; i < comparisons.size(); i++) {
+            const Comparison& c = comparisons[i];
+            const Comparison r = reference(c);
+            const f64_t memory = static_cast<f64_t>(c.workspaceBytes) / r.workspaceBytes;
+            const f64_t speedup = r.median / c.median;
+            if (format == "table") {
+                out << std::left << std::setw(10) << c.precision << std::setw(14) << c.pattern << std::right
+                    << std::setw(6) << c.size << std::setw(11) << c.keypoints << std::fixed << std::setprecision(4)
+                    << std::setw(10) << c.repeatability << std::setprecision(6) << std::setw(12) << c.meanDrift
+                    << std::setw(11) << c.maxDrift << std::setw(15) << c.magnitudeError << std::setw(17)
+                    << c.orientationError
+                    << std::setprecision(1) << std::setw(14) << c.workspaceBytes / 1048576.0
+                    << std::setprecision(3) << std::setw(9) << memory << std::setw(12) << c.median * 1e3
+                    << std::setw(9) << speedup << "\n";
+            } else if (format == "csv") {
+                out << c.precision << "," << c.pattern << "," << c.size << "," << c.size << "," << c.keypoints << ","
+                    << std::setprecision(9) << c.repeatability << "," << c.meanDrift << "," << c.maxDrift << ","
+                    << c.magnitudeError << "," << c.orientationError << ","
+                    << c.workspaceBytes << "," << memory << "," << c.median << "," << speedup << "\n";
+            } else {
+                out << "  {\"precision\": \"" << c.precision << "\", \"pattern\": \"" << c.pattern
+                    << "\", \"width\": " << c.size << ", \"height\": " << c.size << ", \"keypoints\": " << c.keypoints
+                    << ", \"repeatability\": " << std::setprecision(9) << c.repeatability << ", \"mean_drift\": "
+                    << c.meanDrift << ", \"max_drift\": " << c.maxDrift << ", \"magnitude_error\": "
+                    << c.magnitudeError << ", \"orientation_error\": " << c.orientationError
+                    << ", \"workspace_bytes\": "
+                    << c.workspaceBytes << ", \"memory_ratio\": " << memory << ", \"median_s\": " << c.median
+                    << ", \"speedup\": " << speedup << "}" << (i + 1 < comparisons.size() ? "," : "") << "\n";
+            }
+        }
+        if (format == "json")
+            out << "]\n";
+    }
+}
+
+/*
+ * Times every alg:: function and every stage of a Sift calculation in isolation on synthetic
+ * images of growing size. With --precision it compares the features and times of the 16 bit
+ * gradient pyramids with f32 instead.
+ */
+int main(int argc, char** argv) {
+    std::string sizes, patterns, filter, format;
+    u16_t repetitions, warmup, threads, octaves;
+    bool precision;
+
+    po::options_description desc("Options");
+    desc.add_options()
+        ("help", "Print help messages")
+        ("sizes", po::value<std::string>(&sizes)->default_value("256,512,1024,2048,4096,8192"), "The widths and heights of the test images")
+        ("patterns", po::value<std::string>(&patterns)->default_value("noise,checkerboard,fractal"), "The test images: noise, checkerboard and fractal")
+        ("repetitions,r", po::value<u16_t>(&repetitions)->default_value(7), "How often every measurement is repeated")
+        ("warmup,w", po::value<u16_t>(&warmup)->default_value(2), "How often every benchmark runs before it is measured")
+        ("threads,t", po::value<u16_t>(&threads)->default_value(1), "How many threads the functions and stages use. 0 uses all cores")
+        ("octaves,o", po::value<u16_t>(&octaves)->default_value(4), "The octaves of the Sift stages")
+        ("filter,f", po::value<std::string>(&filter)->default_value(""), "Only runs the benchmarks whose name contains this text")
+        ("format", po::value<std::string>(&format)->default_value("table"), "The output: table, csv or json")
+        ("precision", po::bool_switch(&precision), "Compare the features, memory and time of the f16 and u16 precisions with f32")
+        ;
+    po::variables_map vm;
+    try {
+        po::store(po::parse_command_line(argc, argv, desc), vm);
+        po::notify(vm);
+    } catch (std::exception& ex) {
+        std::cerr << ex.what() << std::endl;
+        return 1;
+    }
+    if (vm.count("help")) {
+        std::cout << desc << "\n";
+        return 1;
+    }
+    if (format != "table" && format != "csv" && format != "json") {
+        std::cerr << "Unknown format " << format << std::endl;
+        return 1;
+    }
+
+    std::vector<std::string> sizeList, patternList;
+    boost::split(sizeList, sizes, boost::is_any_of(","));
+    boost::split(patternList, patterns, boost::is_any_of(","));
+
+    Runner runner(warmup, repetitions, filter);
+    sift::ThreadPool pool(threads);
+    std::vector<Comparison> comparisons;
+    try {
+        for (const std::string& s : sizeList) {
+            const u32_t size = std::stoul(s);
+            for (const std::string& pattern : patternList) {
+                const vigra::MultiArray<2, f32_t> img = syntheticImage(pattern, size);
+                if (precision) {
+                    comparePrecisions(runner, comparisons, pattern, img, octaves, threads);
+                    continue;
+                }
+                benchAlgorithms(runner, pattern, img, pool);
+                benchStages(runner, pattern, img, octaves, threads);
+            }
+        }
+    } catch (std::exception& ex) {
+        std::cerr << ex.what() << std::endl;
+        return 1;
+    }
+
+    if (precision) {
+        writeComparisons(std::cout, comparisons, format);
+        return 0;
+    }
+
+    if (format == "csv")
+        writeCsv(std::cout, runner.results);
+    else if (format == "json")
+        writeJson(std::cout, runner.results);
+    else
+        writeTable(std::cout, runner.results);
+    return 0;
+}
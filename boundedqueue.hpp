@@ -0,0 +1,98 @@
+#ifndef BOUNDEDQUEUE_HPP
+#define BOUNDEDQUEUE_HPP
+
+#include <deque>
+#include <mutex>
+#include <condition_variable>
+
+#include "types.hpp"
+
+namespace sift {
+    /**
+     * A queue between the stages of a pipeline, which holds at most a fixed count of elements.
+     * A producer waits while the queue is full, so a fast stage can't run away from a slow one
+     * and the memory stays bounded. After close the consumers get the remaining elements and
+     * then learn that nothing follows.
+     */
+    template <typename T>
+    class BoundedQueue {
+        private:
+            std::deque<T> _elements;
+
+            const u32_t _capacity;
+
+            bool _closed = false;
+
+            std::mutex _mutex;
+
+            std::condition_variable _notFull;
+
+            std::condition_variable _notEmpty;
+
+        public:
+            /**
+             * @param capacity the count of elements, which the queue holds at most
+             */
+            explicit BoundedQueue(u32_t capacity) : _capacity(capacity > 0 ? capacity : 1) {
+            }
+
+            BoundedQueue(const BoundedQueue&) = delete;
+            BoundedQueue& operator=(const BoundedQueue&) = delete;
+
+            /**
+             * Appends an element and waits while the queue is full
+             * @param element the element
+             * @return false if the queue was closed and the element was dropped
+             */
+            bool push(T element) {
+                std::unique_lock<std::mutex> lock(_mutex);
+                _notFull.wait(lock, [this]() { return _closed || _elements.size() < _capacity; });
+                if (_closed)
+                    return false;
+
+                _elements.emplace_back(std::move(element));
+                lock.unlock();
+                _notEmpty.notify_one();
+                return true;
+            }
+
+            /**
+             * Takes the oldest element and waits while the queue is empty
+             * @param element takes the element
+             * @return false if the queue is closed and empty
+             */
+            bool pop(T& element) {
+                std::unique_lock<std::mutex> lock(_mutex);
+                _notEmpty.wait(lock, [this]() { return _closed || !_elements.empty(); });
+                if (_elements.empty())
+                    return false;
+
+                element = std::move(_elements.front());
+                _elements.pop_front();
+                lock.unlock();
+                _notFull.notify_one();
+                return true;
+            }
+
+            /**
+             * No more elements follow. Waiting producers and consumers are woken up.
+             */
+            void close() {
+                {
+                    std::lock_guard<std::mutex> lock(_mutex);
+                    _closed = true;
+                }
+                _notFull.notify_all();
+                _notEmpty.notify_all();
+            }
+
+            /**
+             * @return the current count of elements
+             */
+            u32_t size() {
+                std::lock_guard<std::mutex> lock(_mutex);
+                return _elements.size();
+            }
+    };
+}
+#endif //BOUNDEDQUEUE_HPP
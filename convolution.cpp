@@ -0,0 +1,352 @@
+#include "convolution.hpp"
+
+#include <algorithm>
+
+#include "lanes.hpp"
+
+namespace sift {
+    namespace alg {
+        namespace {
+            /**
+             * The count of columns the vertical pass processes at once. The accumulator and a
+             * strip of every row of the kernel stay in the L1 cache.
+             */
+            const u32_t strip = 256;
+
+            /**
+             * Mirrors an index into [0, length) without repeating the border pixel. Works for
+             * kernels which are longer than the line, too.
+             * @param i the index which may lie outside
+             * @param length the length of the line
+             * @return the mirrored index
+             */
+            i64_t reflect(i64_t i, i64_t length) {
+                if (length == 1)
+                    return 0;
+
+                const i64_t period = 2 * (length - 1);
+                i %= period;
+                if (i < 0)
+                    i += period;
+
+                return i < length ? i : period - i;
+            }
+
+            /**
+             * Blurs a line, which is readable from -radius up to width + radius.
+             * out[x] = taps[0] * in[x] + sum(taps[i] * (in[x - i] + in[x + i]))
+             * @param in the center of the padded input line
+             * @param out the output line
+             * @param width the count of output values
+             * @param taps the right half of the kernel
+             */
+            void convolveLine(const f32_t* in, f32_t* out, u32_t width, const std::vector<f32_t>& taps) {
+                const u32_t radius = taps.size() - 1;
+                u32_t x = 0;
+                for (; x + Lanes::size <= width; x += Lanes::size) {
+                    Lanes::type acc = Lanes::mul(Lanes::set(taps[0]), Lanes::load(in + x));
+                    for (u32_t i = 1; i <= radius; i++) {
+                        const Lanes::type pair = Lanes::add(Lanes::load(in + x - i), Lanes::load(in + x + i));
+                        acc = Lanes::add(acc, Lanes::mul(Lanes::set(taps[i]), pair));
+                    }
+                    Lanes::store(out + x, acc);
+                }
+                for (; x < width; x++) {
+                    f32_t acc = taps[0] * in[x];
+                    for (u32_t i = 1; i <= radius; i++) {
+                        acc = acc + taps[i] * (in[x - i] + in[x + i]);
+                    }
+                    out[x] = acc;
+                }
+            }
+
+            /**
+             * Blurs the even pixels of a line, which is split into its even and odd pixels. Both
+             * halves are readable from -(radius + 1) / 2 up to width + (radius + 1) / 2, so every
+             * tap reads contiguous values.
+             * out[x] = taps[0] * in[2x] + sum(taps[i] * (in[2x - i] + in[2x + i]))
+             * @param even the center of the padded even pixels, even[x] = in[2x]
+             * @param odd the center of the padded odd pixels, odd[x] = in[2x + 1]
+             * @param out the output line
+             * @param width the count of output values
+             * @param taps the right half of the kernel
+             */
+            void decimateLine(const f32_t* even, const f32_t* odd, f32_t* out, u32_t width,
+                    const std::vector<f32_t>& taps) {
+
+                const u32_t radius = taps.size() - 1;
+                u32_t x = 0;
+                for (; x + Lanes::size <= width; x += Lanes::size) {
+                    Lanes::type acc = Lanes::mul(Lanes::set(taps[0]), Lanes::load(even + x));
+                    for (u32_t i = 1; i <= radius; i++) {
+                        const Lanes::type pair = i % 2 == 0 ?
+                            Lanes::add(Lanes::load(even + x - i / 2), Lanes::load(even + x + i / 2)) :
+                            Lanes::add(Lanes::load(odd + x - (i + 1) / 2), Lanes::load(odd + x + (i - 1) / 2));
+                        acc = Lanes::add(acc, Lanes::mul(Lanes::set(taps[i]), pair));
+                    }
+                    Lanes::store(out + x, acc);
+                }
+                for (; x < width; x++) {
+                    f32_t acc = taps[0] * even[x];
+                    for (u32_t i = 1; i <= radius; i++) {
+                        const f32_t pair = i % 2 == 0 ? *(even + x - i / 2) + even[x + i / 2] :
+                            *(odd + x - (i + 1) / 2) + odd[x + (i - 1) / 2];
+                        acc = acc + taps[i] * pair;
+                    }
+                    out[x] = acc;
+                }
+            }
+
+            /**
+             * Blurs the center of the 2 * radius + 1 rows of a ring buffer vertically for the 
+             * columns [x0, x1).
+             * @param ring the ring buffer of rows
+             * @param width the length of a row
+             * @param first the slot of the top row in the ring buffer
+             * @param acc the output, which must hold x1 - x0 values
+             * @param x0 the first column
+             * @param x1 one past the last column
+             * @param taps the right half of the kernel
+             */
+            void combineRows(const f32_t* ring, u32_t width, u32_t first, f32_t* acc, u32_t x0, u32_t x1,
+                    const std::vector<f32_t>& taps) {
+
+                const u32_t radius = taps.size() - 1;
+                const u32_t window = 2 * radius + 1;
+                const u32_t n = x1 - x0;
+                const u32_t vectorized = n - n % Lanes::size;
+                auto row = [&](u32_t i) { return ring + ((first + i) % window) * width + x0; };
+
+                const f32_t* center = row(radius);
+                const Lanes::type k0 = Lanes::set(taps[0]);
+                for (u32_t x = 0; x < vectorized; x += Lanes::size) {
+                    Lanes::store(acc + x, Lanes::mul(k0, Lanes::load(center + x)));
+                }
+                for (u32_t x = vectorized; x < n; x++) {
+                    acc[x] = taps[0] * center[x];
+                }
+
+                //One tap after the other, so every row pair gets streamed through once
+                for (u32_t i = 1; i <= radius; i++) {
+                    const f32_t* above = row(radius - i);
+                    const f32_t* below = row(radius + i);
+                    const Lanes::type k = Lanes::set(taps[i]);
+                    for (u32_t x = 0; x < vectorized; x += Lanes::size) {
+                        const Lanes::type pair = Lanes::add(Lanes::load(above + x), Lanes::load(below + x));
+                        Lanes::store(acc + x, Lanes::add(Lanes::load(acc + x), Lanes::mul(k, pair)));
+                    }
+                    for (u32_t x = vectorized; x < n; x++) {
+                        acc[x] = acc[x] + taps[i] * (above[x] + below[x]);
+                    }
+                }
+            }
+        }
+
+        std::vector<f32_t> symmetricTaps(const vigra::Kernel1D<f32_t>& kernel) {
+            std::vector<f32_t> taps;
+            for (i32_t i = 0; i <= kernel.right(); i++) {
+                taps.push_back(kernel[i]);
+            }
+            return taps;
+        }
+
+        bool isSymmetric(const vigra::Kernel1D<f32_t>& kernel) {
+            if (kernel.left() != -kernel.right())
+                return false;
+
+            for (i32_t i = 1; i <= kernel.right(); i++) {
+                if (kernel[i] != kernel[-i])
+                    return false;
+            }
+            return true;
+        }
+
+        u32_t separableConvolveScratch(u32_t width, u32_t radius) {
+            return (2 * radius + 1) * width + width + 2 * radius + strip;
+        }
+
+        void separableConvolve(const vigra::MultiArrayView<2, f32_t>& src, vigra::MultiArrayView<2, f32_t> dst,
+                const std::vector<f32_t>& taps, u32_t begin, u32_t end, f32_t* scratch) {
+
+            const u32_t width = src.width();
+            const u32_t height = src.height();
+            const u32_t radius = taps.size() - 1;
+            const u32_t window = 2 * radius + 1;
+            if (begin >= end)
+                return;
+
+            std::vector<f32_t> own;
+            if (scratch == nullptr) {
+                own.resize(separableConvolveScratch(width, radius));
+                scratch = &own[0];
+            }
+
+            //The horizontally blurred rows [y - radius, y + radius] of the current output row y
+            f32_t* ring = scratch;
+            f32_t* padded = ring + window * width;
+            f32_t* acc = padded + width + 2 * radius;
+
+            auto index = [&](i64_t y) -> u32_t {
+                const i64_t i = y % static_cast<i64_t>(window);
+                return i < 0 ? i + window : i;
+            };
+
+            auto blurRow = [&](i64_t y) {
+                const i64_t sy = reflect(y, height);
+                if (src.stride(0) == 1) {
+                    std::copy(&src(0, sy), &src(0, sy) + width, &padded[radius]);
+                } else {
+                    for (u32_t x = 0; x < width; x++) {
+                        padded[x + radius] = src(x, sy);
+                    }
+                }
+                for (u32_t i = 1; i <= radius; i++) {
+                    padded[radius - i] = src(reflect(-static_cast<i64_t>(i), width), sy);
+                    padded[radius + width - 1 + i] = src(reflect(width - 1 + i, width), sy);
+                }
+                convolveLine(&padded[radius], ring + index(y) * width, width, taps);
+            };
+
+            const i64_t reach = radius;
+            for (i64_t y = static_cast<i64_t>(begin) - reach; y < static_cast<i64_t>(begin) + reach; y++) {
+                blurRow(y);
+            }
+
+            for (u32_t y = begin; y < end; y++) {
+                blurRow(y + reach);
+                const u32_t first = index(static_cast<i64_t>(y) - reach);
+
+                for (u32_t x0 = 0; x0 < width; x0 += strip) {
+                    const u32_t x1 = std::min(width, x0 + strip);
+                    if (dst.stride(0) == 1) {
+                        combineRows(ring, width, first, &dst(x0, y), x0, x1, taps);
+                        continue;
+                    }
+                    combineRows(ring, width, first, acc, x0, x1, taps);
+                    for (u32_t x = x0; x < x1; x++) {
+                        dst(x, y) = acc[x - x0];
+                    }
+                }
+            }
+        }
+
+        u32_t separableDecimateScratch(u32_t width, u32_t radius) {
+            const u32_t half = (width + 1) / 2;
+            const u32_t pad = (radius + 1) / 2;
+            return (2 * radius + 1) * half + 2 * (half + 2 * pad) + strip;
+        }
+
+        void separableDecimate(const vigra::MultiArrayView<2, f32_t>& src, vigra::MultiArrayView<2, f32_t> dst,
+                const std::vector<f32_t>& taps, u32_t begin, u32_t end, f32_t* scratch) {
+
+            const u32_t width = src.width();
+            const u32_t height = src.height();
+            const u32_t half = dst.width();
+            const u32_t radius = taps.size() - 1;
+            const u32_t window = 2 * radius + 1;
+            const u32_t pad = (radius + 1) / 2;
+            if (begin >= end)
+                return;
+
+            std::vector<f32_t> own;
+            if (scratch == nullptr) {
+                own.resize(separableDecimateScratch(width, radius));
+                scratch = &own[0];
+            }
+
+            //The horizontally blurred even columns of the input rows [2y - radius, 2y + radius] of
+            //the current output row y
+            f32_t* ring = scratch;
+            f32_t* even = ring + window * half;
+            f32_t* odd = even + half + 2 * pad;
+            f32_t* acc = odd + half + 2 * pad;
+
+            auto index = [&](i64_t y) -> u32_t {
+                const i64_t i = y % static_cast<i64_t>(window);
+                return i < 0 ? i + window : i;
+            };
+
+            auto blurRow = [&](i64_t y) {
+                const i64_t sy = reflect(y, height);
+                auto at = [&](i64_t x) { return src(reflect(x, width), sy); };
+
+                //Every pixel pair inside the row is copied straight, only the padding reflects
+                const u32_t inner = width / 2;
+                for (i64_t x = -static_cast<i64_t>(pad); x < 0; x++) {
+                    even[x + pad] = at(2 * x);
+                    odd[x + pad] = at(2 * x + 1);
+                }
+                for (u32_t x = 0; x < inner; x++) {
+                    even[x + pad] = src(2 * x, sy);
+                    odd[x + pad] = src(2 * x + 1, sy);
+                }
+                for (u32_t x = inner; x < half + pad; x++) {
+                    even[x + pad] = at(2 * x);
+                    odd[x + pad] = at(2 * x + 1);
+                }
+                decimateLine(even + pad, odd + pad, ring + index(y) * half, half, taps);
+            };
+
+            //The next input row, which has to be blurred horizontally
+            const i64_t reach = radius;
+            i64_t next = 2 * static_cast<i64_t>(begin) - reach;
+            for (u32_t y = begin; y < end; y++) {
+                const i64_t center = 2 * static_cast<i64_t>(y);
+                for (; next <= center + reach; next++) {
+                    blurRow(next);
+                }
+                const u32_t first = index(center - reach);
+
+                for (u32_t x0 = 0; x0 < half; x0 += strip) {
+                    const u32_t x1 = std::min(half, x0 + strip);
+                    if (dst.stride(0) == 1) {
+                        combineRows(ring, half, first, &dst(x0, y), x0, x1, taps);
+                        continue;
+                    }
+                    combineRows(ring, half, first, acc, x0, x1, taps);
+                    for (u32_t x = x0; x < x1; x++) {
+                        dst(x, y) = acc[x - x0];
+                    }
+                }
+            }
+        }
+
+        void bilinearUpsample(const vigra::MultiArrayView<2, f32_t>& src, vigra::MultiArrayView<2, f32_t> dst,
+                u32_t begin, u32_t end) {
+
+            const u32_t width = src.width();
+            const u32_t height = src.height();
+            const i64_t in = src.stride(0);
+            const i64_t out = dst.stride(0);
+            for (u32_t y = begin; y < end; y++) {
+                const f32_t* above = &src(0, y);
+                const f32_t* below = &src(0, std::min(y + 1, height - 1));
+                f32_t* even = &dst(0, 2 * y);
+                f32_t* odd = &dst(0, 2 * y + 1);
+                for (u32_t x = 0; x < width; x++) {
+                    const u32_t right = std::min(x + 1, width - 1);
+                    const f32_t a = above[x * in];
+                    const f32_t b = above[right * in];
+                    const f32_t c = below[x * in];
+                    const f32_t d = below[right * in];
+                    even[2 * x * out] = a;
+                    even[(2 * x + 1) * out] = (a + b) * 0.5f;
+                    odd[2 * x * out] = (a + c) * 0.5f;
+                    odd[(2 * x + 1) * out] = (a + b + c + d) * 0.25f;
+                }
+            }
+        }
+
+        const vigra::MultiArray<2, f32_t> convolveWithGaussVigra(const vigra::MultiArrayView<2, f32_t>& img,
+                const vigra::Kernel1D<f32_t>& filter) {
+
+            vigra::MultiArray<2, f32_t> tmp(img.shape());
+            vigra::MultiArray<2, f32_t> result(img.shape());
+
+            separableConvolveX(img, tmp, filter);
+            separableConvolveY(tmp, result, filter);
+
+            return result;
+        }
+    }
+}
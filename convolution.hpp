@@ -0,0 +1,101 @@
+#ifndef CONVOLUTION_HPP
+#define CONVOLUTION_HPP
+
+#include <vector>
+
+#include <vigra/multi_array.hxx>
+#include <vigra/convolution.hxx>
+
+#include "types.hpp"
+
+namespace sift {
+    namespace alg {
+        /**
+         * Takes the right half of a symmetric kernel, starting with the center tap.
+         * @param kernel the kernel, whose taps are mirrored around the center
+         * @return the taps from the center up to the right border of the kernel
+         */
+        std::vector<f32_t> symmetricTaps(const vigra::Kernel1D<f32_t>&);
+
+        /**
+         * Checks if a kernel is centered and has the same taps on both sides, which is true for
+         * every Gaussian kernel.
+         * @param kernel the kernel to check
+         * @return true if symmetricTaps describes the whole kernel
+         */
+        bool isSymmetric(const vigra::Kernel1D<f32_t>&);
+
+        /**
+         * The count of values separableConvolve needs as scratch memory
+         * @param width the width of the image
+         * @param radius the radius of the kernel
+         * @return the count of f32_t values
+         */
+        u32_t separableConvolveScratch(u32_t, u32_t);
+
+        /**
+         * Convolves an image with a symmetric kernel in x and y direction, but only produces the
+         * rows [begin, end) of the result. Each output row is blurred vertically out of a ring
+         * buffer of horizontally blurred rows, so no image sized intermediate is needed. Borders
+         * are reflected like vigra's BORDER_TREATMENT_REFLECT. Uses AVX-512, AVX2 or SSE if the compiler
+         * targets them and plain C++ otherwise.
+         * @param src the input image
+         * @param dst the output image with the same shape as the input
+         * @param taps the right half of the kernel as given by symmetricTaps
+         * @param begin the first row to produce
+         * @param end one past the last row to produce
+         * @param scratch separableConvolveScratch values of memory or nullptr to allocate them
+         */
+        void separableConvolve(const vigra::MultiArrayView<2, f32_t>&, vigra::MultiArrayView<2, f32_t>,
+                const std::vector<f32_t>&, u32_t, u32_t, f32_t*);
+
+        /**
+         * The count of values separableDecimate needs as scratch memory
+         * @param width the width of the input image
+         * @param radius the radius of the kernel
+         * @return the count of f32_t values
+         */
+        u32_t separableDecimateScratch(u32_t, u32_t);
+
+        /**
+         * Blurs an image like separableConvolve and samples every second pixel in x and y
+         * direction, but only produces the rows [begin, end) of the half sized result. The kernel
+         * is only evaluated at the pixels which are kept: the horizontal pass runs over the even
+         * columns of every needed input row and the vertical pass over every second row of the
+         * ring buffer. dst(x, y) is bitwise the same as the blurred input at (2x, 2y).
+         * @param src the input image
+         * @param dst the output image, which has half the size of the input rounded up
+         * @param taps the right half of the kernel as given by symmetricTaps
+         * @param begin the first output row to produce
+         * @param end one past the last output row to produce
+         * @param scratch separableDecimateScratch values of memory or nullptr to allocate them
+         */
+        void separableDecimate(const vigra::MultiArrayView<2, f32_t>&, vigra::MultiArrayView<2, f32_t>,
+                const std::vector<f32_t>&, u32_t, u32_t, f32_t*);
+
+        /**
+         * Doubles an image by bilinear interpolation and produces the output rows of the input
+         * rows [begin, end). The pixel (x, y) of the input lands on (2x, 2y) of the output and the
+         * pixels in between are the means of their neighbours. The last row and column repeat the
+         * border of the input.
+         * @param src the input image
+         * @param dst the output image with the doubled size of the input
+         * @param begin the first input row
+         * @param end one past the last input row
+         */
+        void bilinearUpsample(const vigra::MultiArrayView<2, f32_t>&, vigra::MultiArrayView<2, f32_t>, u32_t,
+                u32_t);
+
+        /**
+         * Convolves an image with a kernel through vigra's generic separableConvolveX/Y and an
+         * image sized temporary. This was the way before the own convolution and is kept for
+         * comparisons and for kernels which aren't symmetric.
+         * @param input the input image which will be convolved
+         * @param filter the kernel
+         * @return blured image
+         */
+        const vigra::MultiArray<2, f32_t> convolveWithGaussVigra(const vigra::MultiArrayView<2, f32_t>&,
+                const vigra::Kernel1D<f32_t>&);
+    }
+}
+#endif //CONVOLUTION_HPP
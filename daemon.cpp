@@ -0,0 +1,460 @@
+#include "daemon.hpp"
+
+#include <cmath>
+#include <sstream>
+#include <cstring>
+#include <cerrno>
+#include <algorithm>
+#include <stdexcept>
+#include <condition_variable>
+
+#include <vigra/impex.hxx>
+
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <unistd.h>
+#include <csignal>
+#include <sys/socket.h>
+#include <sys/un.h>
+#endif
+
+namespace sift {
+    namespace {
+        /**
+         * The largest request, which is accepted. A bigger size is taken for a broken stream.
+         */
+        const std::uint32_t maxRequest = 1u << 30;
+
+        /**
+         * Reads exactly size bytes
+         * @param fd the file descriptor
+         * @param data takes the bytes
+         * @param size the count of bytes
+         * @return false if the input ended or failed before
+         */
+        bool readAll(int fd, void* data, u64_t size) {
+            char* out = static_cast<char*>(data);
+            while (size > 0) {
+#ifdef _WIN32
+                const int got = _read(fd, out, static_cast<unsigned>(std::min<u64_t>(size, 1u << 30)));
+#else
+                const ssize_t got = ::read(fd, out, size);
+                if (got < 0 && errno == EINTR)
+                    continue;
+#endif
+                if (got <= 0)
+                    return false;
+                out += got;
+                size -= got;
+            }
+            return true;
+        }
+
+        /**
+         * Writes all bytes
+         * @param fd the file descriptor
+         * @param data the bytes
+         * @param size the count of bytes
+         * @return false if the output was closed
+         */
+        bool writeAll(int fd, const void* data, u64_t size) {
+            const char* in = static_cast<const char*>(data);
+            while (size > 0) {
+#ifdef _WIN32
+                const int put = _write(fd, in, static_cast<unsigned>(std::min<u64_t>(size, 1u << 30)));
+#else
+                const ssize_t put = ::write(fd, in, size);
+                if (put < 0 && errno == EINTR)
+                    continue;
+#endif
+                if (put <= 0)
+                    return false;
+                in += put;
+                size -= put;
+            }
+            return true;
+        }
+
+        /**
+         * A reply, which is built in memory and written at once
+         */
+        class Frame {
+            private:
+                std::vector<char> _data;
+
+            public:
+                Frame(std::uint32_t id, std::uint8_t status) {
+                    put<std::uint32_t>(0);
+                    put(id);
+                    put(status);
+                }
+
+                template <typename T>
+                void put(const T& value) {
+                    put(&value, sizeof(T));
+                }
+
+                void put(const void* data, u64_t size) {
+                    const char* bytes = static_cast<const char*>(data);
+                    _data.insert(_data.end(), bytes, bytes + size);
+                }
+
+                /**
+                 * @return the frame with the size in front
+                 */
+                const std::vector<char>& finish() {
+                    const std::uint32_t size = _data.size() - sizeof(std::uint32_t);
+                    std::memcpy(_data.data(), &size, sizeof(size));
+                    return _data;
+                }
+        };
+
+        Frame error(std::uint32_t id, const std::string& message) {
+            Frame reply(id, 1);
+            reply.put(message.data(), message.size());
+            return reply;
+        }
+
+        /**
+         * Copies the grey values of a pixel request into an image
+         * @param payload the payload after the kind
+         * @param bytes the bytes of a grey value, 1 or 4
+         * @param img takes the pixels
+         * @return false if the payload has the wrong size
+         */
+        bool pixels(const std::vector<char>& payload, u32_t bytes, vigra::MultiArray<2, f32_t>& img) {
+            std::uint32_t size[2];
+            if (payload.size() < sizeof(size))
+                return false;
+            std::memcpy(size, payload.data(), sizeof(size));
+            if (size[0] == 0 || size[1] == 0 ||
+                    payload.size() - sizeof(size) != static_cast<u64_t>(size[0]) * size[1] * bytes) {
+                return false;
+            }
+
+            img.reshape(vigra::Shape2(size[0], size[1]));
+            const char* data = payload.data() + sizeof(size);
+            for (u32_t y = 0; y < size[1]; y++) {
+                for (u32_t x = 0; x < size[0]; x++, data += bytes) {
+                    if (bytes == 1) {
+                        img(x, y) = static_cast<u8_t>(*data);
+                    } else {
+                        std::memcpy(&img(x, y), data, sizeof(f32_t));
+                    }
+                }
+            }
+            return true;
+        }
+    }
+
+    class Daemon::Connection {
+        public:
+            const int in;
+            const int out;
+
+            /**
+             * Wether the descriptor is a socket of the daemon, which gets closed
+             */
+            const bool socket;
+
+            /**
+             * Set by the reader, when the connection ended
+             */
+            std::atomic<bool> finished;
+
+        private:
+            std::mutex _write;
+
+            /**
+             * The count of requests, which are queued or calculated
+             */
+            u32_t _pending = 0;
+            std::mutex _mutex;
+            std::condition_variable _idle;
+
+        public:
+            Connection(int in, int out, bool socket) : in(in), out(out), socket(socket), finished(false) {
+            }
+
+            ~Connection() {
+#ifndef _WIN32
+                if (socket)
+                    ::close(in);
+#endif
+            }
+
+            /**
+             * Writes a reply. A client which went away is ignored.
+             * @param frame the reply
+             */
+            void send(Frame& frame) {
+                const std::vector<char>& data = frame.finish();
+                std::lock_guard<std::mutex> lock(_write);
+                writeAll(out, data.data(), data.size());
+            }
+
+            void begin() {
+                std::lock_guard<std::mutex> lock(_mutex);
+                _pending++;
+            }
+
+            void end() {
+                {
+                    std::lock_guard<std::mutex> lock(_mutex);
+                    _pending--;
+                }
+                _idle.notify_all();
+            }
+
+            /**
+             * Waits until all requests of the connection are answered
+             */
+            void wait() {
+                std::unique_lock<std::mutex> lock(_mutex);
+                _idle.wait(lock, [this]() { return _pending == 0; });
+            }
+    };
+
+    std::string DaemonStats::toJson() const {
+        std::ostringstream out;
+        out << "{\"requests\": " << requests << ", \"failed\": " << failed
+            << ", \"queueDepth\": " << queueDepth << ", \"maxQueueDepth\": " << maxQueueDepth
+            << ", \"latency\": {\"p50\": " << p50Seconds << ", \"p90\": " << p90Seconds
+            << ", \"p99\": " << p99Seconds << ", \"max\": " << maxSeconds << "}}";
+        return out.str();
+    }
+
+    Daemon::Daemon(std::unique_ptr<Sift> sift, u16_t workers, u32_t depth, u32_t window) :
+        _sift(std::move(sift)), _queue(depth), _latencies(std::max<u32_t>(window, 1)), _stopped(false),
+        _listener(-1) {
+
+#ifndef _WIN32
+        //A client, which goes away, must not kill the daemon while a reply is written
+        std::signal(SIGPIPE, SIG_IGN);
+#endif
+        for (u16_t w = 0; w < std::max<u16_t>(workers, 1); w++) {
+            _workers.emplace_back(&Daemon::_work, this);
+        }
+    }
+
+    Daemon::~Daemon() {
+        _queue.close();
+        for (std::thread& w : _workers) {
+            w.join();
+        }
+    }
+
+    void Daemon::serve(int in, int out) {
+        _read(std::make_shared<Connection>(in, out, false));
+    }
+
+    void Daemon::listen(const std::string& path) {
+#ifdef _WIN32
+        throw std::runtime_error("Unix domain sockets aren't supported on this platform");
+#else
+        sockaddr_un address;
+        std::memset(&address, 0, sizeof(address));
+        address.sun_family = AF_UNIX;
+        if (path.size() >= sizeof(address.sun_path))
+            throw std::runtime_error("The socket path " + path + " is too long");
+        std::memcpy(address.sun_path, path.c_str(), path.size());
+
+        const int fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+        if (fd < 0)
+            throw std::runtime_error("Can't create a socket");
+        ::unlink(path.c_str());
+        if (::bind(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0 || ::listen(fd, 64) != 0) {
+            ::close(fd);
+            throw std::runtime_error("Can't listen on " + path);
+        }
+        _listener = fd;
+
+        std::vector<std::pair<std::thread, std::shared_ptr<Connection>>> readers;
+        while (!_stopped) {
+            const int client = ::accept(fd, nullptr, nullptr);
+            if (client < 0) {
+                if (errno == EINTR || errno == ECONNABORTED)
+                    continue;
+                break;
+            }
+
+            //Joins the readers of the connections, which ended in the meantime
+            readers.erase(std::remove_if(readers.begin(), readers.end(),
+                        [](std::pair<std::thread, std::shared_ptr<Connection>>& r) {
+                            if (!r.second->finished)
+                                return false;
+                            r.first.join();
+                            return true;
+                        }), readers.end());
+
+            auto connection = std::make_shared<Connection>(client, client, true);
+            readers.emplace_back(std::thread(&Daemon::_read, this, connection), connection);
+        }
+
+        _listener = -1;
+        ::close(fd);
+        ::unlink(path.c_str());
+
+        //The other clients are cut off, their requests in the queue are still answered
+        for (auto& r : readers) {
+            ::shutdown(r.second->in, SHUT_RD);
+        }
+        for (auto& r : readers) {
+            r.first.join();
+        }
+#endif
+    }
+
+    DaemonStats Daemon::stats() {
+        DaemonStats s;
+        s.queueDepth = _queue.size();
+
+        std::vector<f64_t> latencies;
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            s.requests = _requests;
+            s.failed = _failed;
+            s.maxQueueDepth = std::max(_maxQueueDepth, s.queueDepth);
+            latencies.assign(_latencies.begin(), _latencies.begin() + std::min<u64_t>(_requests, _latencies.size()));
+        }
+        if (latencies.empty())
+            return s;
+
+        std::sort(latencies.begin(), latencies.end());
+        //The nearest rank percentile
+        auto percentile = [&latencies](f64_t p) {
+            const u64_t rank = static_cast<u64_t>(std::ceil(p * latencies.size()));
+            return latencies[std::max<u64_t>(rank, 1) - 1];
+        };
+        s.p50Seconds = percentile(0.5);
+        s.p90Seconds = percentile(0.9);
+        s.p99Seconds = percentile(0.99);
+        s.maxSeconds = latencies.back();
+        return s;
+    }
+
+    void Daemon::_read(const std::shared_ptr<Connection>& connection) {
+        std::vector<char> payload;
+        for (;;) {
+            std::uint32_t size;
+            if (!readAll(connection->in, &size, sizeof(size)))
+                break;
+
+            std::uint32_t id = 0;
+            std::uint8_t kind = 0;
+            const std::uint32_t head = sizeof(id) + sizeof(kind);
+            if (size < head || size - head > maxRequest) {
+                //The frames can't be found again, so the connection ends
+                Frame reply = error(0, "Invalid request size");
+                connection->send(reply);
+                break;
+            }
+            payload.resize(size - head);
+            if (!readAll(connection->in, &id, sizeof(id)) || !readAll(connection->in, &kind, sizeof(kind)) ||
+                    !readAll(connection->in, payload.data(), payload.size())) {
+                break;
+            }
+
+            Job job;
+            job.connection = connection;
+            job.id = id;
+            job.kind = static_cast<RequestKind>(kind);
+            job.received = Clock::now();
+
+            if (job.kind == RequestKind::stats) {
+                Frame reply(id, 0);
+                const std::string json = stats().toJson();
+                reply.put(json.data(), json.size());
+                connection->send(reply);
+                continue;
+            }
+            if (job.kind == RequestKind::shutdown) {
+                connection->wait();
+                Frame reply(id, 0);
+                connection->send(reply);
+                _stop();
+                break;
+            }
+
+            bool valid = true;
+            if (job.kind == RequestKind::path) {
+                job.path.assign(payload.begin(), payload.end());
+            } else if (job.kind == RequestKind::grey8 || job.kind == RequestKind::float32) {
+                valid = pixels(payload, job.kind == RequestKind::grey8 ? 1 : sizeof(f32_t), job.img);
+            } else {
+                Frame reply = error(id, "Unknown request kind");
+                connection->send(reply);
+                continue;
+            }
+            if (!valid) {
+                Frame reply = error(id, "The size of the pixels doesn't match the width and height");
+                connection->send(reply);
+                continue;
+            }
+
+            connection->begin();
+            if (!_queue.push(std::move(job))) {
+                connection->end();
+                Frame reply = error(id, "The daemon is stopping");
+                connection->send(reply);
+                break;
+            }
+            const u32_t depth = _queue.size();
+            std::lock_guard<std::mutex> lock(_mutex);
+            _maxQueueDepth = std::max(_maxQueueDepth, depth);
+        }
+
+        connection->wait();
+        connection->finished = true;
+    }
+
+    void Daemon::_work() {
+        SiftContext context;
+        QuantizedDescriptorSet set;
+        Job job;
+        while (_queue.pop(job)) {
+            Frame reply(job.id, 0);
+            bool failed = false;
+            try {
+                if (job.kind == RequestKind::path) {
+                    vigra::ImageImportInfo info(job.path.c_str());
+                    job.img.reshape(vigra::Shape2(info.shape()));
+                    vigra::importImage(info, job.img);
+                }
+                _sift->calculate(job.img, set, context);
+
+                reply.put<std::uint32_t>(set.size());
+                for (u32_t i = 0; i < set.size(); i++) {
+                    const f32_t point[4] = {set.x[i], set.y[i], set.scale[i], set.orientation[i]};
+                    reply.put(point, sizeof(point));
+                }
+                reply.put(set.descriptors.data(), set.descriptors.size());
+            } catch (std::exception& ex) {
+                reply = error(job.id, ex.what());
+                failed = true;
+            }
+            job.connection->send(reply);
+
+            const f64_t latency = std::chrono::duration<f64_t>(Clock::now() - job.received).count();
+            {
+                std::lock_guard<std::mutex> lock(_mutex);
+                _latencies[_requests % _latencies.size()] = latency;
+                _requests++;
+                _failed += failed;
+            }
+            job.connection->end();
+            //The connection may close as soon as its last job is dropped
+            job = Job();
+        }
+    }
+
+    void Daemon::_stop() {
+        _stopped = true;
+#ifndef _WIN32
+        const int fd = _listener;
+        if (fd >= 0)
+            ::shutdown(fd, SHUT_RDWR);
+#endif
+    }
+}
@@ -0,0 +1,203 @@
+#ifndef DAEMON_HPP
+#define DAEMON_HPP
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+
+#include <vigra/multi_array.hxx>
+
+#include "types.hpp"
+#include "sift.hpp"
+#include "boundedqueue.hpp"
+
+namespace sift {
+    /**
+     * The kinds of requests of the daemon protocol.
+     *
+     * A request is a frame of
+     *   uint32 size   the bytes after this field
+     *   uint32 id     echoed in the reply, so a client can send many requests before it reads
+     *   uint8  kind   one of the kinds below
+     * followed by the payload of the kind. A reply is a frame of
+     *   uint32 size, uint32 id, uint8 status (0 ok, 1 error)
+     * followed by the features, the statistics as JSON or an error message. Features are
+     *   uint32 count, count x 4 float32 (x, y, scale, orientation), count x 128 uint8 descriptors
+     * with the descriptors quantized like a QuantizedDescriptorSet. All values are in the byte
+     * order of the machine, because client and daemon run on the same host.
+     */
+    enum class RequestKind : std::uint8_t {
+        /**
+         * The payload is the path of an image file, which the daemon decodes
+         */
+        path = 1,
+
+        /**
+         * The payload is uint32 width, uint32 height and width x height uint8 grey values row by row
+         */
+        grey8 = 2,
+
+        /**
+         * The payload is uint32 width, uint32 height and width x height float32 grey values in
+         * [0, 255] row by row
+         */
+        float32 = 3,
+
+        /**
+         * No payload, the reply holds the DaemonStats as JSON
+         */
+        stats = 4,
+
+        /**
+         * No payload, the daemon stops after the requests before are answered
+         */
+        shutdown = 5
+    };
+
+    /**
+     * The state of a running daemon
+     */
+    class DaemonStats {
+        public:
+            /**
+             * The count of answered image requests and of the ones, which failed
+             */
+            u64_t requests = 0;
+            u64_t failed = 0;
+
+            /**
+             * The count of requests in the queue right now and the most there ever were
+             */
+            u32_t queueDepth = 0;
+            u32_t maxQueueDepth = 0;
+
+            /**
+             * The percentiles of the time between reading a request and writing its reply over
+             * the latest requests
+             */
+            f64_t p50Seconds = 0;
+            f64_t p90Seconds = 0;
+            f64_t p99Seconds = 0;
+            f64_t maxSeconds = 0;
+
+            /**
+             * @return the statistics as JSON object
+             */
+            std::string toJson() const;
+    };
+
+    /**
+     * A long running process, which calculates features for local clients over a framed binary
+     * protocol on stdin and stdout or on a Unix domain socket. The Sift object, the worker
+     * threads and a SiftContext per worker live as long as the daemon, so a request pays neither
+     * the start of a process nor cold pyramids. Readers put the requests of all connections into
+     * a single BoundedQueue, which stalls a client that sends faster than the workers calculate.
+     * The replies of a connection are written in the order the workers finish them.
+     */
+    class Daemon {
+        public:
+            /**
+             * A client of the daemon, which is read by its own thread and written by the workers
+             */
+            class Connection;
+
+        private:
+            typedef std::chrono::steady_clock Clock;
+
+            /**
+             * An image request between a reader and the workers
+             */
+            struct Job {
+                std::shared_ptr<Connection> connection;
+                std::uint32_t id;
+                RequestKind kind;
+                std::string path;
+                vigra::MultiArray<2, f32_t> img;
+                Clock::time_point received;
+            };
+
+            const std::unique_ptr<Sift> _sift;
+
+            BoundedQueue<Job> _queue;
+
+            std::vector<std::thread> _workers;
+
+            /**
+             * The latencies of the latest requests in a ring
+             */
+            std::vector<f64_t> _latencies;
+            u64_t _requests = 0;
+            u64_t _failed = 0;
+            u32_t _maxQueueDepth = 0;
+            std::mutex _mutex;
+
+            std::atomic<bool> _stopped;
+
+            /**
+             * The listening socket in the socket mode, -1 otherwise
+             */
+            std::atomic<int> _listener;
+
+        public:
+            /**
+             * Starts the workers
+             * @param sift the Sift object, which all workers share
+             * @param workers how many requests are calculated at the same time
+             * @param depth how many requests wait for a worker at most
+             * @param window over how many of the latest requests the latency percentiles are taken
+             */
+            explicit Daemon(std::unique_ptr<Sift> sift, u16_t workers = 1, u32_t depth = 64, u32_t window = 4096);
+
+            /**
+             * Answers the requests in the queue and stops the workers
+             */
+            ~Daemon();
+
+            Daemon(const Daemon&) = delete;
+            Daemon& operator=(const Daemon&) = delete;
+
+            /**
+             * Serves a single client on two file descriptors, like stdin and stdout. Returns when
+             * the input ends or a shutdown request arrives and all its requests are answered.
+             * @param in the descriptor the requests are read from
+             * @param out the descriptor the replies are written to
+             */
+            void serve(int, int);
+
+            /**
+             * Serves every client, which connects to a Unix domain socket, until a shutdown
+             * request arrives. An existing file at the path is replaced.
+             * @param path the path of the socket
+             * @throws std::runtime_error if the socket can't be created or on Windows
+             */
+            void listen(const std::string&);
+
+            /**
+             * @return the current statistics
+             */
+            DaemonStats stats();
+
+        private:
+            /**
+             * Reads the requests of a connection until it ends and queues them
+             * @param connection the connection
+             */
+            void _read(const std::shared_ptr<Connection>&);
+
+            /**
+             * The loop of a worker, which calculates the queued requests
+             */
+            void _work();
+
+            /**
+             * Stops all readers after a shutdown request
+             */
+            void _stop();
+    };
+}
+#endif //DAEMON_HPP
@@ -0,0 +1,73 @@
+#include "descriptor.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+
+namespace sift {
+    namespace alg {
+        namespace {
+            const u16_t cell = 4;
+            const u16_t bins = 8;
+        }
+
+        const DescriptorWeights descriptorWeights(f32_t sigma) {
+            DescriptorWeights weights;
+            const f32_t center = (descriptorWindow - 1) / 2.0f;
+            for (u16_t y = 0; y < descriptorWindow; y++) {
+                for (u16_t x = 0; x < descriptorWindow; x++) {
+                    const f32_t dx = x - center;
+                    const f32_t dy = y - center;
+                    weights[y * descriptorWindow + x] = std::exp(-(dx * dx + dy * dy) / (2 * sigma * sigma));
+                }
+            }
+            return weights;
+        }
+
+        void descriptor(const vigra::MultiArrayView<2, f32_t>& magnitudes,
+                const vigra::MultiArrayView<2, f32_t>& orientations, f32_t rotation,
+                const DescriptorWeights& weights, f32_t* out) {
+
+            assert(magnitudes.width() == descriptorWindow && magnitudes.height() == descriptorWindow);
+            assert(orientations.shape() == magnitudes.shape());
+
+            //The bin and the weighted magnitude of every pixel of the window
+            std::array<u16_t, descriptorWindow * descriptorWindow> bin;
+            std::array<f32_t, descriptorWindow * descriptorWindow> weighted;
+            for (u16_t y = 0; y < descriptorWindow; y++) {
+                for (u16_t x = 0; x < descriptorWindow; x++) {
+                    const u16_t i = y * descriptorWindow + x;
+                    f32_t angle = std::fmod(orientations(x, y) + rotation, 360.0f);
+                    if (angle < 0)
+                        angle += 360;
+                    const u16_t b = angle / (360 / bins);
+                    bin[i] = b < bins ? b : 0;
+                    weighted[i] = magnitudes(x, y) * weights[i];
+                }
+            }
+
+            for (u16_t cx = 0; cx < descriptorWindow / cell; cx++) {
+                for (u16_t cy = 0; cy < descriptorWindow / cell; cy++) {
+                    f32_t* histogram = out + (cx * (descriptorWindow / cell) + cy) * bins;
+                    std::fill(histogram, histogram + bins, 0.0f);
+                    for (u16_t y = cy * cell; y < (cy + 1) * cell; y++) {
+                        for (u16_t x = cx * cell; x < (cx + 1) * cell; x++) {
+                            const u16_t i = y * descriptorWindow + x;
+                            histogram[bin[i]] += weighted[i];
+                        }
+                    }
+
+                    f32_t sum = 0;
+                    for (u16_t b = 0; b < bins; b++) {
+                        sum += histogram[b];
+                    }
+                    if (sum == 0)
+                        continue;
+                    for (u16_t b = 0; b < bins; b++) {
+                        histogram[b] /= sum;
+                    }
+                }
+            }
+        }
+    }
+}
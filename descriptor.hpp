@@ -0,0 +1,51 @@
+#ifndef DESCRIPTOR_HPP
+#define DESCRIPTOR_HPP
+
+#include <array>
+
+#include <vigra/multi_array.hxx>
+
+#include "types.hpp"
+
+namespace sift {
+    namespace alg {
+        /**
+         * The edge length of the descriptor window in pixels
+         */
+        const u16_t descriptorWindow = 16;
+
+        /**
+         * The count of values of a descriptor: 4x4 cells with 8 orientation bins each
+         */
+        const u16_t descriptorSize = 128;
+
+        /**
+         * The weights of the descriptor window, row by row
+         */
+        typedef std::array<f32_t, descriptorWindow * descriptorWindow> DescriptorWeights;
+
+        /**
+         * Creates the Gaussian weights of the descriptor window around its center. They are 
+         * calculated once and used for every keypoint.
+         * @param sigma the standard deviation of the Gaussian, half the window size in Lowe's paper
+         * @return the weights of the 16x16 window
+         */
+        const DescriptorWeights descriptorWeights(f32_t);
+
+        /**
+         * Creates the descriptor of a keypoint out of the gradients of the 16x16 window around it.
+         * The orientations are rotated by the keypoint orientation and the magnitudes weighted in
+         * scratch buffers of the keypoint, so the gradient pyramids stay untouched. Every 4x4 cell
+         * gets a histogram of 8 bins of 45 degrees, which is normalized on its own.
+         * @param magnitudes the 16x16 magnitudes of the window
+         * @param orientations the 16x16 orientations of the window
+         * @param rotation the orientation of the keypoint
+         * @param weights the weights of descriptorWeights
+         * @param out the descriptorSize values of the descriptor. The cells are ordered by column
+         * and then by row
+         */
+        void descriptor(const vigra::MultiArrayView<2, f32_t>&, const vigra::MultiArrayView<2, f32_t>&,
+                f32_t, const DescriptorWeights&, f32_t*);
+    }
+}
+#endif //DESCRIPTOR_HPP
@@ -0,0 +1,45 @@
+#include "descriptorset.hpp"
+
+#include <algorithm>
+
+namespace sift {
+    void quantize(const f32_t* row, u8_t* out) {
+        for (u16_t i = 0; i < alg::descriptorSize; i++) {
+            const f32_t value = row[i] * quantizationFactor + 0.5f;
+            out[i] = static_cast<u8_t>(std::min(std::max(value, 0.0f), quantizationFactor));
+        }
+    }
+
+    void quantize(const DescriptorSet& set, QuantizedDescriptorSet& quantized) {
+        quantized.x = set.x;
+        quantized.y = set.y;
+        quantized.scale = set.scale;
+        quantized.orientation = set.orientation;
+        quantized.octave = set.octave;
+        quantized.descriptors.resize(set.descriptors.size());
+        for (u32_t i = 0; i < set.size(); i++) {
+            quantize(set.descriptor(i), quantized.descriptor(i));
+        }
+    }
+
+    void concatenate(const std::vector<DescriptorSet>& parts, DescriptorSet& set) {
+        u32_t size = 0;
+        for (const DescriptorSet& part : parts) {
+            size += part.size();
+        }
+        set.resize(size);
+
+        u32_t i = 0;
+        for (const DescriptorSet& part : parts) {
+            if (part.empty())
+                continue;
+            std::copy(part.x.begin(), part.x.end(), set.x.begin() + i);
+            std::copy(part.y.begin(), part.y.end(), set.y.begin() + i);
+            std::copy(part.scale.begin(), part.scale.end(), set.scale.begin() + i);
+            std::copy(part.orientation.begin(), part.orientation.end(), set.orientation.begin() + i);
+            std::copy(part.octave.begin(), part.octave.end(), set.octave.begin() + i);
+            std::copy(part.descriptors.begin(), part.descriptors.end(), set.descriptor(i));
+            i += part.size();
+        }
+    }
+}
@@ -0,0 +1,141 @@
+#ifndef DESCRIPTORSET_HPP
+#define DESCRIPTORSET_HPP
+
+#include <vector>
+#include <algorithm>
+
+#include "types.hpp"
+#include "aligned.hpp"
+#include "descriptor.hpp"
+
+namespace sift {
+    /**
+     * The interest points of an image with their descriptors in a structure of arrays. Every
+     * attribute lies in its own array and all descriptors lie row by row in one aligned matrix of
+     * alg::descriptorSize columns. A whole set is a handful of allocations, which can be reused by
+     * the next image, and every array can be written or matched as a single block of memory.
+     * @tparam T the type of a descriptor value, f32_t or u8_t for the quantized set
+     */
+    template <typename T>
+    class BasicDescriptorSet {
+        public:
+            /**
+             * The x coordinates in the input image
+             */
+            std::vector<f32_t> x;
+
+            /**
+             * The y coordinates in the input image
+             */
+            std::vector<f32_t> y;
+
+            /**
+             * The scales of the interest points
+             */
+            std::vector<f32_t> scale;
+
+            /**
+             * The orientations of the interest points
+             */
+            std::vector<f32_t> orientation;
+
+            /**
+             * The octaves the interest points were found in
+             */
+            std::vector<u16_t> octave;
+
+            /**
+             * The descriptors, size() rows of alg::descriptorSize values
+             */
+            std::vector<T, AlignedAllocator<T>> descriptors;
+
+            /**
+             * @return the count of interest points
+             */
+            u32_t size() const {
+                return x.size();
+            }
+
+            bool empty() const {
+                return x.empty();
+            }
+
+            /**
+             * Changes the count of interest points. The memory is kept, when the set gets smaller.
+             * @param n the new count
+             */
+            void resize(u32_t n) {
+                x.resize(n);
+                y.resize(n);
+                scale.resize(n);
+                orientation.resize(n);
+                octave.resize(n);
+                descriptors.resize(static_cast<u64_t>(n) * alg::descriptorSize);
+            }
+
+            /**
+             * @param i the index of the interest point
+             * @return the alg::descriptorSize values of its descriptor
+             */
+            T* descriptor(u32_t i) {
+                return &descriptors[static_cast<u64_t>(i) * alg::descriptorSize];
+            }
+
+            const T* descriptor(u32_t i) const {
+                return &descriptors[static_cast<u64_t>(i) * alg::descriptorSize];
+            }
+
+            /**
+             * Copies every attribute and the descriptor of an interest point into a slot of a set,
+             * which can be this one to compact it
+             * @param i the index of the interest point
+             * @param to the set, which already has the slot
+             * @param j the index of the slot, which gets overwritten
+             */
+            void copyTo(u32_t i, BasicDescriptorSet& to, u32_t j) const {
+                if (&to == this && i == j)
+                    return;
+                to.x[j] = x[i];
+                to.y[j] = y[i];
+                to.scale[j] = scale[i];
+                to.orientation[j] = orientation[i];
+                to.octave[j] = octave[i];
+                std::copy(descriptor(i), descriptor(i) + alg::descriptorSize, to.descriptor(j));
+            }
+    };
+
+    typedef BasicDescriptorSet<f32_t> DescriptorSet;
+
+    /**
+     * A descriptor set with 8 bit values, which is 4 times smaller
+     */
+    typedef BasicDescriptorSet<u8_t> QuantizedDescriptorSet;
+
+    /**
+     * Every value of a cell of a descriptor lies in [0, 1], so a quantized value is the float
+     * value times this factor
+     */
+    const f32_t quantizationFactor = 255;
+
+    /**
+     * Quantizes a single descriptor to 8 bit by rounding value * quantizationFactor
+     * @param row the alg::descriptorSize values of the descriptor
+     * @param out the alg::descriptorSize quantized values
+     */
+    void quantize(const f32_t*, u8_t*);
+
+    /**
+     * Quantizes the descriptors of a set to 8 bit by rounding value * quantizationFactor
+     * @param set the set with float descriptors
+     * @param quantized takes the attributes and the quantized descriptors
+     */
+    void quantize(const DescriptorSet&, QuantizedDescriptorSet&);
+
+    /**
+     * Copies the interest points of several sets one after the other into a single set
+     * @param parts the sets
+     * @param set takes the interest points of all parts
+     */
+    void concatenate(const std::vector<DescriptorSet>&, DescriptorSet&);
+}
+#endif //DESCRIPTORSET_HPP
@@ -0,0 +1,140 @@
+#include "extrema.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+
+#include "lanes.hpp"
+
+namespace sift {
+    namespace alg {
+        u32_t findExtremaScratch(u32_t width, u16_t dogs) {
+            return 3 * dogs * width;
+        }
+
+        void findExtrema(const std::vector<vigra::MultiArrayView<2, f32_t>>& gaussians, u32_t begin,
+                u32_t end, f32_t contrast, std::vector<Extremum>& extrema, f32_t* scratch) {
+
+            assert(gaussians.size() >= 4);
+
+            const u16_t dogs = gaussians.size() - 1;
+            const u32_t width = gaussians[0].width();
+            const u32_t height = gaussians[0].height();
+            if (width < 3 || height < 3)
+                return;
+
+            begin = std::max<u32_t>(begin, 1);
+            end = std::min<u32_t>(end, height - 1);
+            if (begin >= end)
+                return;
+
+            std::vector<f32_t> own;
+            if (scratch == nullptr) {
+                own.resize(findExtremaScratch(width, dogs));
+                scratch = &own[0];
+            }
+            auto row = [&](u16_t dog, u32_t y) -> f32_t* {
+                return scratch + ((y % 3) * dogs + dog) * width;
+            };
+
+            //The same arithmetic as alg::dog, so the values are identical
+            auto produce = [&](u32_t y) {
+                for (u16_t j = 0; j < dogs; j++) {
+                    assert(gaussians[j].stride(0) == 1 && gaussians[j + 1].stride(0) == 1);
+                    const f32_t* lower = &gaussians[j](0, y);
+                    const f32_t* higher = &gaussians[j + 1](0, y);
+                    f32_t* out = row(j, y);
+                    for (u32_t x = 0; x < width; x++) {
+                        const f32_t dif = higher[x] - lower[x];
+                        out[x] = 128 + dif;
+                    }
+                }
+            };
+
+            const Lanes::type offset = Lanes::set(128);
+            const Lanes::type zero = Lanes::set(0);
+            const Lanes::type threshold = Lanes::set(contrast);
+
+            produce(begin - 1);
+            produce(begin);
+            for (u32_t y = begin; y < end; y++) {
+                produce(y + 1);
+
+                //Outer DoGs will be ignored, because we need a upper and lower neighbor
+                for (u16_t i = 1; i < dogs - 1; i++) {
+                    const f32_t* rows[3][3];
+                    for (i16_t s = -1; s <= 1; s++) {
+                        for (i16_t dy = -1; dy <= 1; dy++) {
+                            rows[s + 1][dy + 1] = row(i + s, y + dy);
+                        }
+                    }
+                    const f32_t* center = rows[1][1];
+
+                    auto emit = [&](u32_t x) {
+                        Extremum e(Point<u32_t, u32_t>(x, y), i);
+                        for (i16_t s = -1; s <= 1; s++) {
+                            for (i16_t dy = -1; dy <= 1; dy++) {
+                                for (i16_t dx = -1; dx <= 1; dx++) {
+                                    e.neighborhood(dx, dy, s) = rows[s + 1][dy + 1][x + dx];
+                                }
+                            }
+                        }
+                        extrema.emplace_back(e);
+                    };
+
+                    //A pixel is a maximum if it isn't smaller than the maximum of its neighbours,
+                    //the same for the minimum. Lanes::size pixels are tested at once.
+                    u32_t x = 1;
+                    for (; x + Lanes::size < width; x += Lanes::size) {
+                        const Lanes::type value = Lanes::load(center + x);
+                        const Lanes::type shifted = Lanes::sub(value, offset);
+                        const Lanes::mask strong = Lanes::ge(Lanes::max(shifted, Lanes::sub(zero, shifted)), threshold);
+                        if (Lanes::bits(strong) == 0)
+                            continue;
+
+                        Lanes::type highest = Lanes::load(center + x - 1);
+                        Lanes::type lowest = highest;
+                        for (u16_t s = 0; s < 3; s++) {
+                            for (u16_t dy = 0; dy < 3; dy++) {
+                                for (u16_t dx = 0; dx < 3; dx++) {
+                                    if (s == 1 && dy == 1 && dx == 1)
+                                        continue;
+                                    const Lanes::type neighbour = Lanes::load(rows[s][dy] + x + dx - 1);
+                                    highest = Lanes::max(highest, neighbour);
+                                    lowest = Lanes::min(lowest, neighbour);
+                                }
+                            }
+                        }
+
+                        const Lanes::mask found = Lanes::both(strong,
+                                Lanes::either(Lanes::ge(value, highest), Lanes::le(value, lowest)));
+                        const u32_t bits = Lanes::bits(found);
+                        for (u32_t l = 0; bits >> l != 0; l++) {
+                            if ((bits >> l) & 1)
+                                emit(x + l);
+                        }
+                    }
+
+                    for (; x < width - 1; x++) {
+                        const f32_t value = center[x];
+                        if (std::abs(value - 128) < contrast)
+                            continue;
+
+                        bool maximum = true;
+                        bool minimum = true;
+                        for (u16_t s = 0; s < 3 && (maximum || minimum); s++) {
+                            for (u16_t dy = 0; dy < 3; dy++) {
+                                for (u32_t dx = x - 1; dx <= x + 1; dx++) {
+                                    maximum &= !(rows[s][dy][dx] > value);
+                                    minimum &= !(rows[s][dy][dx] < value);
+                                }
+                            }
+                        }
+                        if (maximum || minimum)
+                            emit(x);
+                    }
+                }
+            }
+        }
+    }
+}
@@ -0,0 +1,69 @@
+#ifndef EXTREMA_HPP
+#define EXTREMA_HPP
+
+#include <vector>
+
+#include <vigra/multi_array.hxx>
+
+#include "types.hpp"
+#include "point.hpp"
+#include "neighborhood.hpp"
+
+namespace sift {
+    namespace alg {
+        /**
+         * A pixel, which is the maximum or the minimum of its 26 neighbours in the DoG pyramid
+         */
+        class Extremum {
+            public:
+                /**
+                 * The position of the pixel
+                 */
+                Point<u32_t, u32_t> loc;
+
+                /**
+                 * The DoG of the octave the pixel lies in
+                 */
+                u16_t index;
+
+                /**
+                 * The pixel and its neighbours
+                 */
+                Neighborhood neighborhood;
+
+                Extremum() = default;
+                Extremum(Point<u32_t, u32_t> loc, u16_t index) : loc(loc), index(index) {
+                }
+        };
+
+        /**
+         * The count of values findExtrema needs as scratch memory
+         * @param width the width of the octave
+         * @param dogs the count of DoGs of the octave, which is one less than its Gaussians
+         * @return the count of f32_t values
+         */
+        u32_t findExtremaScratch(u32_t, u16_t);
+
+        /**
+         * Searches the scale space extrema of an octave for the rows [begin, end). The DoGs are
+         * never stored as whole images. Their rows are created on the fly out of the rows of two
+         * adjacent Gaussians and live in a ring buffer of 3 rows per DoG, which holds the row
+         * above, the current row and the row below of every DoG. A pixel is an extremum, if none
+         * of its 26 neighbours is bigger or none is smaller. Like the DoGs of alg::dog, the
+         * values are shifted by 128. Pixels whose DoG lies closer to 128 than the contrast are
+         * rejected before their neighbours are compared. The comparisons run on Lanes::size
+         * pixels at once.
+         * @param gaussians the Gaussians of an octave, with row wise contiguous pixels
+         * @param begin the first row to search, the border row 0 is skipped
+         * @param end one past the last row to search, the border row is skipped
+         * @param contrast the smallest |DoG - 128| of an extremum, 0 keeps all extrema
+         * @param extrema the vector the found extrema are appended to, ordered by row, DoG and
+         * column
+         * @param scratch findExtremaScratch values of memory for the ring buffer or nullptr to
+         * allocate them
+         */
+        void findExtrema(const std::vector<vigra::MultiArrayView<2, f32_t>>&, u32_t, u32_t, f32_t,
+                std::vector<Extremum>&, f32_t*);
+    }
+}
+#endif //EXTREMA_HPP
@@ -0,0 +1,229 @@
+#include "featurefile.hpp"
+
+#include <fstream>
+#include <cstring>
+#include <stdexcept>
+#include <limits>
+
+#if defined(_WIN32)
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+namespace sift {
+    namespace {
+        const char magic[8] = {'S', 'I', 'F', 'T', 'F', 'E', 'A', 'T'};
+        const std::uint32_t byteOrder = 0x01020304;
+        const std::uint64_t alignment = 64;
+
+        std::uint64_t aligned(std::uint64_t offset) {
+            return (offset + alignment - 1) / alignment * alignment;
+        }
+
+        /**
+         * Appends a section at the next aligned offset
+         * @param out the file
+         * @param offset the current size of the file, which gets moved behind the section
+         * @param data the values of the section
+         * @param bytes the size of the section
+         * @return the offset of the section
+         */
+        std::uint64_t section(std::ofstream& out, std::uint64_t& offset, const void* data, std::uint64_t bytes) {
+            static const char padding[alignment] = {0};
+            const std::uint64_t start = aligned(offset);
+            out.write(padding, start - offset);
+            out.write(static_cast<const char*>(data), bytes);
+            offset = start + bytes;
+            return start;
+        }
+
+        template <typename T>
+        void write(const std::string& file, const BasicDescriptorSet<T>& set) {
+            std::ofstream out(file, std::ios::binary);
+            if (!out)
+                throw std::runtime_error("Can't write " + file);
+
+            FeatureFileHeader header;
+            std::memset(&header, 0, sizeof(header));
+            std::memcpy(header.magic, magic, sizeof(magic));
+            header.version = featureFileVersion;
+            header.byteOrder = byteOrder;
+            header.count = set.size();
+            header.descriptorSize = alg::descriptorSize;
+            header.valueSize = sizeof(T);
+
+            //The offsets are only known after writing, so the header gets written twice
+            out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+            std::uint64_t offset = sizeof(header);
+            header.x = section(out, offset, set.x.data(), set.size() * sizeof(f32_t));
+            header.y = section(out, offset, set.y.data(), set.size() * sizeof(f32_t));
+            header.scale = section(out, offset, set.scale.data(), set.size() * sizeof(f32_t));
+            header.orientation = section(out, offset, set.orientation.data(), set.size() * sizeof(f32_t));
+            header.octave = section(out, offset, set.octave.data(), set.size() * sizeof(u16_t));
+            header.descriptors = section(out, offset, set.descriptors.data(), set.descriptors.size() * sizeof(T));
+
+            out.seekp(0);
+            out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+            if (!out)
+                throw std::runtime_error("Can't write " + file);
+        }
+    }
+
+    void writeFeatures(const std::string& file, const DescriptorSet& set) {
+        write(file, set);
+    }
+
+    void writeFeatures(const std::string& file, const QuantizedDescriptorSet& set) {
+        write(file, set);
+    }
+
+    FeatureFile::FeatureFile(const std::string& file) {
+#if defined(_WIN32)
+        _file = CreateFileA(file.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+                FILE_ATTRIBUTE_NORMAL, nullptr);
+        if (_file == INVALID_HANDLE_VALUE) {
+            _file = nullptr;
+            throw std::runtime_error("Can't open " + file);
+        }
+        LARGE_INTEGER size;
+        if (!GetFileSizeEx(_file, &size)) {
+            _close();
+            throw std::runtime_error("Can't read the size of " + file);
+        }
+        _size = size.QuadPart;
+        if (_size > 0) {
+            _mapping = CreateFileMappingA(_file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+            if (_mapping != nullptr)
+                _memory = static_cast<const u8_t*>(MapViewOfFile(_mapping, FILE_MAP_READ, 0, 0, 0));
+            if (_memory == nullptr) {
+                _close();
+                throw std::runtime_error("Can't map " + file);
+            }
+        }
+#else
+        const int fd = open(file.c_str(), O_RDONLY);
+        if (fd < 0)
+            throw std::runtime_error("Can't open " + file);
+
+        struct stat info;
+        if (fstat(fd, &info) != 0) {
+            ::close(fd);
+            throw std::runtime_error("Can't read the size of " + file);
+        }
+        _size = info.st_size;
+        if (_size > 0) {
+            void* memory = mmap(nullptr, _size, PROT_READ, MAP_SHARED, fd, 0);
+            if (memory == MAP_FAILED) {
+                ::close(fd);
+                throw std::runtime_error("Can't map " + file);
+            }
+            _memory = static_cast<const u8_t*>(memory);
+        }
+        //The mapping stays valid without the descriptor
+        ::close(fd);
+#endif
+
+        if (_size < sizeof(FeatureFileHeader)) {
+            _close();
+            throw std::runtime_error(file + " is no feature file");
+        }
+        _header = reinterpret_cast<const FeatureFileHeader*>(_memory);
+        if (std::memcmp(_header->magic, magic, sizeof(magic)) != 0) {
+            _close();
+            throw std::runtime_error(file + " is no feature file");
+        }
+        if (_header->byteOrder != byteOrder) {
+            _close();
+            throw std::runtime_error(file + " was written with another byte order");
+        }
+        if (_header->version != featureFileVersion || _header->descriptorSize != alg::descriptorSize ||
+                (_header->valueSize != sizeof(f32_t) && _header->valueSize != sizeof(u8_t))) {
+
+            _close();
+            throw std::runtime_error(file + " has an unsupported version or layout");
+        }
+
+        //Every section has to lie inside of the file. The sizes aren't multiplied out, so a damaged
+        //count can't wrap them around. The sets and matchers index the points with 32 bit.
+        const std::uint64_t count = _header->count;
+        const std::uint64_t sections[][2] = {
+            {_header->x, sizeof(f32_t)},
+            {_header->y, sizeof(f32_t)},
+            {_header->scale, sizeof(f32_t)},
+            {_header->orientation, sizeof(f32_t)},
+            {_header->octave, sizeof(u16_t)},
+            {_header->descriptors, static_cast<std::uint64_t>(_header->descriptorSize) * _header->valueSize}
+        };
+        bool valid = count <= std::numeric_limits<std::uint32_t>::max();
+        for (const auto& s : sections) {
+            valid = valid && s[0] % alignment == 0 && s[0] <= _size && count <= (_size - s[0]) / s[1];
+        }
+        if (!valid) {
+            _close();
+            throw std::runtime_error(file + " is truncated or damaged");
+        }
+    }
+
+    FeatureFile::~FeatureFile() {
+        _close();
+    }
+
+    void FeatureFile::_close() {
+#if defined(_WIN32)
+        if (_memory != nullptr)
+            UnmapViewOfFile(_memory);
+        if (_mapping != nullptr)
+            CloseHandle(_mapping);
+        if (_file != nullptr)
+            CloseHandle(_file);
+        _mapping = nullptr;
+        _file = nullptr;
+#else
+        if (_memory != nullptr)
+            munmap(const_cast<u8_t*>(_memory), _size);
+#endif
+        _memory = nullptr;
+        _header = nullptr;
+    }
+
+    template <typename T>
+    Span<T> FeatureFile::_section(std::uint64_t offset, u64_t count) const {
+        return Span<T>(reinterpret_cast<const T*>(_memory + offset), count);
+    }
+
+    Span<f32_t> FeatureFile::x() const {
+        return _section<f32_t>(_header->x, size());
+    }
+
+    Span<f32_t> FeatureFile::y() const {
+        return _section<f32_t>(_header->y, size());
+    }
+
+    Span<f32_t> FeatureFile::scale() const {
+        return _section<f32_t>(_header->scale, size());
+    }
+
+    Span<f32_t> FeatureFile::orientation() const {
+        return _section<f32_t>(_header->orientation, size());
+    }
+
+    Span<u16_t> FeatureFile::octave() const {
+        return _section<u16_t>(_header->octave, size());
+    }
+
+    Span<f32_t> FeatureFile::descriptors() const {
+        if (quantized())
+            throw std::runtime_error("The descriptors are quantized");
+        return _section<f32_t>(_header->descriptors, size() * _header->descriptorSize);
+    }
+
+    Span<u8_t> FeatureFile::quantizedDescriptors() const {
+        if (!quantized())
+            throw std::runtime_error("The descriptors aren't quantized");
+        return _section<u8_t>(_header->descriptors, size() * _header->descriptorSize);
+    }
+}
@@ -0,0 +1,181 @@
+#ifndef FEATUREFILE_HPP
+#define FEATUREFILE_HPP
+
+#include <string>
+#include <cstdint>
+
+#include "types.hpp"
+#include "descriptorset.hpp"
+
+namespace sift {
+    /**
+     * The header of a binary feature file. The file starts with the header and is followed by
+     * the sections x, y, scale, orientation, octave and descriptors. Every section starts at a
+     * multiple of 64 bytes, which is given by its offset from the start of the file. All values
+     * are stored in the byte order of the writing machine, which the reader checks by byteOrder.
+     * The fields have fixed widths, because u32_t isn't 32 bit on every platform.
+     */
+    struct FeatureFileHeader {
+        /**
+         * "SIFTFEAT"
+         */
+        char magic[8];
+
+        std::uint32_t version;
+
+        /**
+         * 0x01020304 as written by the writing machine
+         */
+        std::uint32_t byteOrder;
+
+        /**
+         * The count of interest points
+         */
+        std::uint64_t count;
+
+        /**
+         * The count of values of a descriptor
+         */
+        std::uint32_t descriptorSize;
+
+        /**
+         * The size of a descriptor value in bytes, 4 for f32_t and 1 for quantized u8_t values
+         */
+        std::uint32_t valueSize;
+
+        std::uint64_t x;
+        std::uint64_t y;
+        std::uint64_t scale;
+        std::uint64_t orientation;
+        std::uint64_t octave;
+        std::uint64_t descriptors;
+    };
+
+    /**
+     * The current version of the binary feature file
+     */
+    const std::uint32_t featureFileVersion = 1;
+
+    /**
+     * Writes a descriptor set as binary feature file
+     * @param file the path of the file
+     * @param set the interest points with their descriptors
+     */
+    void writeFeatures(const std::string&, const DescriptorSet&);
+
+    /**
+     * Writes a set of quantized descriptors as binary feature file
+     * @param file the path of the file
+     * @param set the interest points with their quantized descriptors
+     */
+    void writeFeatures(const std::string&, const QuantizedDescriptorSet&);
+
+    /**
+     * A contiguous range of values inside of a mapped file
+     */
+    template <typename T>
+    class Span {
+        private:
+            const T* _data = nullptr;
+            u64_t _size = 0;
+
+        public:
+            Span() = default;
+            Span(const T* data, u64_t size) : _data(data), _size(size) {
+            }
+
+            const T* data() const {
+                return _data;
+            }
+
+            u64_t size() const {
+                return _size;
+            }
+
+            const T& operator[](u64_t i) const {
+                return _data[i];
+            }
+
+            const T* begin() const {
+                return _data;
+            }
+
+            const T* end() const {
+                return _data + _size;
+            }
+    };
+
+    /**
+     * Reads a binary feature file without copying or parsing it. The file gets mapped into memory
+     * and all sections are handed out as Spans into the mapping, so millions of features are
+     * available as soon as the file is opened. Uses mmap on POSIX systems and a file mapping on
+     * Windows.
+     */
+    class FeatureFile {
+        private:
+            const u8_t* _memory = nullptr;
+            u64_t _size = 0;
+            const FeatureFileHeader* _header = nullptr;
+
+#if defined(_WIN32)
+            void* _file = nullptr;
+            void* _mapping = nullptr;
+#endif
+
+            /**
+             * @param offset the offset of the section
+             * @param count the count of values of the section
+             * @return the values of the section
+             */
+            template <typename T>
+            Span<T> _section(std::uint64_t, u64_t) const;
+
+            void _close();
+
+        public:
+            /**
+             * Maps a feature file and checks its header and sections
+             * @param file the path of the file
+             * @throws std::runtime_error if the file can't be mapped or isn't a valid feature file
+             */
+            explicit FeatureFile(const std::string&);
+
+            ~FeatureFile();
+
+            FeatureFile(const FeatureFile&) = delete;
+            FeatureFile& operator=(const FeatureFile&) = delete;
+
+            /**
+             * @return the count of interest points
+             */
+            u64_t size() const {
+                return _header->count;
+            }
+
+            /**
+             * @return true if the descriptors are quantized to u8_t
+             */
+            bool quantized() const {
+                return _header->valueSize == 1;
+            }
+
+            Span<f32_t> x() const;
+            Span<f32_t> y() const;
+            Span<f32_t> scale() const;
+            Span<f32_t> orientation() const;
+            Span<u16_t> octave() const;
+
+            /**
+             * @return all float descriptors row by row
+             * @throws std::runtime_error if the descriptors are quantized
+             */
+            Span<f32_t> descriptors() const;
+
+            /**
+             * @return all quantized descriptors row by row
+             * @throws std::runtime_error if the descriptors aren't quantized
+             */
+            Span<u8_t> quantizedDescriptors() const;
+    };
+}
+#endif //FEATUREFILE_HPP
@@ -0,0 +1,173 @@
+#include "gradient.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <cfloat>
+#include <cmath>
+
+#include "lanes.hpp"
+
+namespace sift {
+    namespace alg {
+        namespace {
+            const f32_t pi = 3.14159265358979f;
+
+            /**
+             * The count of gradients, which the packed overload calculates at once before it
+             * stores them
+             */
+            const u32_t packedSpan = 64;
+
+            /**
+             * The coefficients of atan(a) / a as a polynomial in a^2 for a in [0, 1], from
+             * Abramowitz and Stegun 4.4.49
+             */
+            const f32_t c1 = 0.9998660f;
+            const f32_t c3 = -0.3302995f;
+            const f32_t c5 = 0.1801410f;
+            const f32_t c7 = -0.0851330f;
+            const f32_t c9 = 0.0208351f;
+
+            /**
+             * The orientation of gradientOrientation: atan2 plus 360, wrapped below 360
+             */
+            f32_t wrap(f32_t angle) {
+                const f32_t shifted = angle + 360;
+                return shifted >= 360 ? shifted - 360 : shifted;
+            }
+        }
+
+        f32_t fastAtan2(f32_t y, f32_t x) {
+            const f32_t ax = std::abs(x);
+            const f32_t ay = std::abs(y);
+            const f32_t a = std::min(ax, ay) / std::max(std::max(ax, ay), FLT_MIN);
+            const f32_t s = a * a;
+            f32_t r = ((((c9 * s + c7) * s + c5) * s + c3) * s + c1) * a;
+            if (ay > ax)
+                r = pi / 2 - r;
+            if (x < 0)
+                r = pi - r;
+            if (y < 0)
+                r = -r;
+            return r;
+        }
+
+        namespace {
+            /**
+             * Calculates the gradients of a part of an image row
+             * @param img the image
+             * @param y the row, which has a row above and below
+             * @param x0 the left column
+             * @param x1 one past the right column
+             * @param mag takes the magnitudes, starting with the one of x0
+             * @param ori takes the orientations, starting with the one of x0
+             */
+            void gradientRow(const vigra::MultiArrayView<2, f32_t>& img, u32_t y, u32_t x0, u32_t x1,
+                    f32_t* mag, f32_t* ori) {
+
+                const u32_t width = img.width();
+                u32_t x = x0;
+                if (x == 0) {
+                    mag[0] = ori[0] = 0;
+                    x = 1;
+                }
+                const u32_t end = std::min(x1, width - 1);
+                const f32_t* above = &img(0, y - 1);
+                const f32_t* row = &img(0, y);
+                const f32_t* below = &img(0, y + 1);
+
+                const Lanes::type zero = Lanes::set(0);
+                const Lanes::type tiny = Lanes::set(FLT_MIN);
+                const Lanes::type halfPi = Lanes::set(pi / 2);
+                const Lanes::type fullPi = Lanes::set(pi);
+                const Lanes::type full = Lanes::set(360);
+                for (; x + Lanes::size <= end; x += Lanes::size) {
+                    const Lanes::type dx = Lanes::sub(Lanes::load(row + x + 1), Lanes::load(row + x - 1));
+                    const Lanes::type dy = Lanes::sub(Lanes::load(below + x), Lanes::load(above + x));
+                    Lanes::store(mag + x - x0, Lanes::sqrt(Lanes::add(Lanes::mul(dx, dx), Lanes::mul(dy, dy))));
+
+                    const Lanes::type ax = Lanes::max(dx, Lanes::sub(zero, dx));
+                    const Lanes::type ay = Lanes::max(dy, Lanes::sub(zero, dy));
+                    const Lanes::type a = Lanes::div(Lanes::min(ax, ay), Lanes::max(Lanes::max(ax, ay), tiny));
+                    const Lanes::type s = Lanes::mul(a, a);
+                    Lanes::type r = Lanes::add(Lanes::mul(Lanes::set(c9), s), Lanes::set(c7));
+                    r = Lanes::add(Lanes::mul(r, s), Lanes::set(c5));
+                    r = Lanes::add(Lanes::mul(r, s), Lanes::set(c3));
+                    r = Lanes::add(Lanes::mul(r, s), Lanes::set(c1));
+                    r = Lanes::mul(r, a);
+                    r = Lanes::select(Lanes::lt(ax, ay), Lanes::sub(halfPi, r), r);
+                    r = Lanes::select(Lanes::lt(dx, zero), Lanes::sub(fullPi, r), r);
+                    r = Lanes::select(Lanes::lt(dy, zero), Lanes::sub(zero, r), r);
+
+                    const Lanes::type shifted = Lanes::add(r, full);
+                    Lanes::store(ori + x - x0, Lanes::select(Lanes::ge(shifted, full), Lanes::sub(shifted, full), shifted));
+                }
+                for (; x < end; x++) {
+                    const f32_t dx = row[x + 1] - row[x - 1];
+                    const f32_t dy = below[x] - above[x];
+                    mag[x - x0] = std::sqrt(dx * dx + dy * dy);
+                    ori[x - x0] = wrap(fastAtan2(dy, dx));
+                }
+                if (x1 == width) {
+                    mag[width - 1 - x0] = ori[width - 1 - x0] = 0;
+                }
+            }
+        }
+
+        void gradients(const vigra::MultiArrayView<2, f32_t>& img, vigra::MultiArrayView<2, f32_t> magnitudes,
+                vigra::MultiArrayView<2, f32_t> orientations, u32_t x0, u32_t y0, u32_t x1, u32_t y1) {
+
+            assert(img.shape() == magnitudes.shape() && img.shape() == orientations.shape());
+            assert(img.stride(0) == 1 && magnitudes.stride(0) == 1 && orientations.stride(0) == 1);
+
+            const u32_t width = img.width();
+            const u32_t height = img.height();
+            x1 = std::min(x1, width);
+            y1 = std::min(y1, height);
+            if (x0 >= x1 || y0 >= y1)
+                return;
+
+            for (u32_t y = y0; y < y1; y++) {
+                f32_t* mag = &magnitudes(x0, y);
+                f32_t* ori = &orientations(x0, y);
+                if (y == 0 || y == height - 1) {
+                    std::fill(mag, mag + x1 - x0, 0);
+                    std::fill(ori, ori + x1 - x0, 0);
+                    continue;
+                }
+                gradientRow(img, y, x0, x1, mag, ori);
+            }
+        }
+
+        void gradients(const vigra::MultiArrayView<2, f32_t>& img, vigra::MultiArrayView<2, u16_t> magnitudes,
+                vigra::MultiArrayView<2, u16_t> orientations, Precision precision, u32_t x0, u32_t y0,
+                u32_t x1, u32_t y1) {
+
+            assert(img.shape() == magnitudes.shape() && img.shape() == orientations.shape());
+            assert(img.stride(0) == 1 && magnitudes.stride(0) == 1 && orientations.stride(0) == 1);
+
+            const u32_t width = img.width();
+            const u32_t height = img.height();
+            x1 = std::min(x1, width);
+            y1 = std::min(y1, height);
+            if (x0 >= x1 || y0 >= y1)
+                return;
+
+            //The rows go through the buffers in spans, so no call allocates
+            f32_t mag[packedSpan], ori[packedSpan];
+            for (u32_t y = y0; y < y1; y++) {
+                for (u32_t x = x0; x < x1; x += packedSpan) {
+                    const u32_t count = std::min(packedSpan, x1 - x);
+                    if (y == 0 || y == height - 1) {
+                        std::fill(mag, mag + count, 0);
+                        std::fill(ori, ori + count, 0);
+                    } else {
+                        gradientRow(img, y, x, x + count, mag, ori);
+                    }
+                    storeMagnitudes(mag, &magnitudes(x, y), count, precision);
+                    storeOrientations(ori, &orientations(x, y), count, precision);
+                }
+            }
+        }
+    }
+}
@@ -0,0 +1,53 @@
+#ifndef GRADIENT_HPP
+#define GRADIENT_HPP
+
+#include <vigra/multi_array.hxx>
+
+#include "types.hpp"
+#include "precision.hpp"
+
+namespace sift {
+    namespace alg {
+        /**
+         * Approximates std::atan2 with a polynomial of degree 9 on the octant [0, 1], which is
+         * mirrored into the other octants. The absolute error is below 2e-5 radians.
+         * @param y the y coordinate
+         * @param x the x coordinate
+         * @return the angle of (x, y) in radians in [-pi, pi]
+         */
+        f32_t fastAtan2(f32_t, f32_t);
+
+        /**
+         * Calculates the gradient magnitudes and orientations of a rectangle of an image in one
+         * pass, reading every pixel once for both. The values are those of gradientMagnitude and
+         * gradientOrientation, except that the orientation comes from fastAtan2. Pixels on the
+         * border of the image have no gradient and are set to 0. Uses the widest Lanes the compiler
+         * targets.
+         * @param img the given image
+         * @param magnitudes the magnitudes with the shape of the image
+         * @param orientations the orientations with the shape of the image
+         * @param x0 the left column of the rectangle
+         * @param y0 the top row of the rectangle
+         * @param x1 one past the right column of the rectangle
+         * @param y1 one past the bottom row of the rectangle
+         */
+        void gradients(const vigra::MultiArrayView<2, f32_t>&, vigra::MultiArrayView<2, f32_t>,
+                vigra::MultiArrayView<2, f32_t>, u32_t, u32_t, u32_t, u32_t);
+
+        /**
+         * Calculates the gradients of a rectangle like the overload above, but stores them with
+         * 16 bits. Every row is calculated into floats first and then converted.
+         * @param img the given image
+         * @param magnitudes the 16 bit magnitudes with the shape of the image
+         * @param orientations the 16 bit orientations with the shape of the image
+         * @param precision f16 or u16
+         * @param x0 the left column of the rectangle
+         * @param y0 the top row of the rectangle
+         * @param x1 one past the right column of the rectangle
+         * @param y1 one past the bottom row of the rectangle
+         */
+        void gradients(const vigra::MultiArrayView<2, f32_t>&, vigra::MultiArrayView<2, u16_t>,
+                vigra::MultiArrayView<2, u16_t>, Precision, u32_t, u32_t, u32_t, u32_t);
+    }
+}
+#endif //GRADIENT_HPP
@@ -33,10 +33,15 @@ namespace sift {
              */
             bool filtered = false;
 
+            /**
+             * The |DoG - 128| of the interest point, which ranks it against the keypoint budget
+             */
+            f32_t response = 0;
+
             /**
              * the x and y coordinates of the interest point
              */
-            Point<u16_t, u16_t> loc;
+            Point<u32_t, u32_t> loc;
 
             /**
              * The orientations of the interest point
@@ -46,7 +51,7 @@ namespace sift {
             std::vector<f32_t> descriptors;
 
             InterestPoint() = default;
-            explicit InterestPoint(Point<u16_t, u16_t> loc, f32_t scale, u16_t octave, u16_t index) 
+            explicit InterestPoint(Point<u32_t, u32_t> loc, f32_t scale, u16_t octave, u16_t index) 
                 :  scale(scale), octave(octave), index(index), loc(loc) {
             }
 
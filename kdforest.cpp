@@ -0,0 +1,424 @@
+#include "kdforest.hpp"
+
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <numeric>
+#include <fstream>
+#include <stdexcept>
+#include <algorithm>
+
+namespace sift {
+    namespace {
+        /**
+         * The count of descriptors, whose mean and variance choose the split of a node
+         */
+        const u32_t sampleSize = 100;
+
+        /**
+         * The count of dimensions with the highest variance, of which one is chosen randomly
+         */
+        const u32_t randomDims = 5;
+
+        /**
+         * The count of queries, which share the marks of their visited descriptors. The marks
+         * are 8 bit, so a block can't have more than 255 queries.
+         */
+        const u32_t queryBlock = 128;
+
+        const char magic[8] = {'S', 'I', 'F', 'T', 'K', 'D', 'F', 'O'};
+        const std::uint32_t version = 1;
+        const std::uint32_t byteOrder = 0x01020304;
+
+        /**
+         * A branch, which wasn't taken on the way down a tree
+         */
+        struct Branch {
+            /**
+             * The smallest squared distance, which a descriptor of the branch can have
+             */
+            f32_t distance;
+            u16_t tree;
+            u32_t node;
+
+            bool operator>(const Branch& other) const {
+                return distance > other.distance;
+            }
+        };
+
+        template <typename T>
+        void put(std::ostream& out, const T& value) {
+            out.write(reinterpret_cast<const char*>(&value), sizeof(T));
+        }
+
+        template <typename T>
+        T get(std::istream& in) {
+            T value = T();
+            in.read(reinterpret_cast<char*>(&value), sizeof(T));
+            return value;
+        }
+
+        /**
+         * @param in a stream of a file
+         * @return the count of bytes after the current position
+         */
+        std::uint64_t remaining(std::istream& in) {
+            const std::streampos current = in.tellg();
+            in.seekg(0, std::ios::end);
+            const std::streampos end = in.tellg();
+            in.seekg(current);
+            return in && end >= current ? static_cast<std::uint64_t>(end - current) : 0;
+        }
+
+        /**
+         * The bytes of a node in a file without its points
+         */
+        const std::uint64_t nodeBytes = sizeof(f32_t) + 4 * sizeof(std::uint32_t);
+    }
+
+    KdForest::KdForest(u16_t trees, u32_t leafSize, u16_t threads, u32_t seed) :
+        _trees(std::max<u16_t>(trees, 1)), _leafSize(std::max<u32_t>(leafSize, 1)), _seed(seed), _pool(threads) {
+
+        //Every tree starts as an empty leaf, so descriptors can be added without a build
+        _forest.assign(_trees, Tree(1));
+        for (u16_t t = 0; t < _trees; t++) {
+            _random.push_back(std::mt19937(_seed + t));
+        }
+    }
+
+    void KdForest::_chooseSplit(const u32_t* points, u32_t count, std::mt19937& random, u32_t& dim,
+            f32_t& split) const {
+
+        const u32_t samples = std::min(count, sampleSize);
+        std::vector<f64_t> mean(alg::descriptorSize, 0);
+        std::vector<f64_t> variance(alg::descriptorSize, 0);
+        for (u32_t i = 0; i < samples; i++) {
+            const f32_t* d = descriptor(points[i]);
+            for (u32_t j = 0; j < alg::descriptorSize; j++) {
+                mean[j] += d[j];
+            }
+        }
+        for (u32_t j = 0; j < alg::descriptorSize; j++) {
+            mean[j] /= samples;
+        }
+        for (u32_t i = 0; i < samples; i++) {
+            const f32_t* d = descriptor(points[i]);
+            for (u32_t j = 0; j < alg::descriptorSize; j++) {
+                variance[j] += (d[j] - mean[j]) * (d[j] - mean[j]);
+            }
+        }
+
+        std::vector<u32_t> dims(alg::descriptorSize);
+        std::iota(dims.begin(), dims.end(), 0);
+        std::partial_sort(dims.begin(), dims.begin() + randomDims, dims.end(), [&variance](u32_t a, u32_t b) {
+                    return variance[a] > variance[b];
+                });
+        dim = dims[random() % randomDims];
+        split = mean[dim];
+    }
+
+    u32_t KdForest::_partition(u32_t* points, u32_t count, std::mt19937& random, u32_t& dim, f32_t& split) const {
+        _chooseSplit(points, count, random, dim, split);
+        const u32_t d = dim;
+        const f32_t s = split;
+        u32_t left = std::partition(points, points + count, [this, d, s](u32_t p) {
+                    return descriptor(p)[d] < s;
+                }) - points;
+
+        //If all values lie on one side of the mean, the median splits them in halves
+        if (left == 0 || left == count) {
+            left = count / 2;
+            std::nth_element(points, points + left, points + count, [this, d](u32_t a, u32_t b) {
+                        return descriptor(a)[d] < descriptor(b)[d];
+                    });
+            split = descriptor(points[left])[d];
+        }
+        return left;
+    }
+
+    u32_t KdForest::_build(Tree& tree, u32_t* points, u32_t count, std::mt19937& random) const {
+        const u32_t index = tree.size();
+        tree.push_back(Node());
+        if (count <= _leafSize) {
+            tree[index].points.assign(points, points + count);
+            return index;
+        }
+
+        u32_t dim;
+        f32_t split;
+        const u32_t left = _partition(points, count, random, dim, split);
+        //The children may move the nodes of the tree, so the node is written afterwards
+        const u32_t l = _build(tree, points, left, random);
+        const u32_t r = _build(tree, points + left, count - left, random);
+        tree[index].dim = dim;
+        tree[index].split = split;
+        tree[index].left = l;
+        tree[index].right = r;
+        return index;
+    }
+
+    void KdForest::_insert(Tree& tree, u32_t point, std::mt19937& random) const {
+        const f32_t* d = descriptor(point);
+        u32_t n = 0;
+        while (!tree[n].leaf()) {
+            n = d[tree[n].dim] < tree[n].split ? tree[n].left : tree[n].right;
+        }
+        tree[n].points.push_back(point);
+        if (tree[n].points.size() <= 2 * _leafSize)
+            return;
+
+        std::vector<u32_t> points;
+        points.swap(tree[n].points);
+        u32_t dim;
+        f32_t split;
+        const u32_t left = _partition(points.data(), points.size(), random, dim, split);
+
+        const u32_t l = tree.size();
+        tree.push_back(Node());
+        tree.push_back(Node());
+        tree[l].points.assign(points.begin(), points.begin() + left);
+        tree[l + 1].points.assign(points.begin() + left, points.end());
+        tree[n].dim = dim;
+        tree[n].split = split;
+        tree[n].left = l;
+        tree[n].right = l + 1;
+    }
+
+    void KdForest::build(const f32_t* descriptors, u32_t count) {
+        _descriptors.assign(descriptors, descriptors + static_cast<u64_t>(count) * alg::descriptorSize);
+        _forest.assign(_trees, Tree());
+        for (u16_t t = 0; t < _trees; t++) {
+            _random[t] = std::mt19937(_seed + t);
+        }
+
+        _pool.parallelFor(0, _trees, [&](u32_t t) {
+            //The sample of a split is taken from the first descriptors of a node, so they are
+            //shuffled once
+            std::vector<u32_t> points(count);
+            std::iota(points.begin(), points.end(), 0);
+            std::shuffle(points.begin(), points.end(), _random[t]);
+            _build(_forest[t], points.data(), count, _random[t]);
+        });
+    }
+
+    void KdForest::build(const DescriptorSet& set) {
+        build(set.descriptors.data(), set.size());
+    }
+
+    void KdForest::add(const f32_t* descriptors, u32_t count) {
+        const u32_t first = size();
+        _descriptors.insert(_descriptors.end(), descriptors, descriptors + static_cast<u64_t>(count) * alg::descriptorSize);
+
+        _pool.parallelFor(0, _trees, [&](u32_t t) {
+            for (u32_t i = first; i < first + count; i++) {
+                _insert(_forest[t], i, _random[t]);
+            }
+        });
+    }
+
+    void KdForest::add(const DescriptorSet& set) {
+        add(set.descriptors.data(), set.size());
+    }
+
+    void KdForest::_search(const f32_t* query, u32_t k, u32_t checks, std::vector<u8_t>& visited, u8_t mark,
+            u32_t* indices, f32_t* distances) const {
+
+        std::vector<Branch> branches;
+        u32_t checked = 0;
+
+        auto descend = [&](u16_t t, u32_t n, f32_t bound) {
+            const Tree& tree = _forest[t];
+            while (!tree[n].leaf()) {
+                const Node& node = tree[n];
+                const f32_t diff = query[node.dim] - node.split;
+                //Every descriptor of the far side is at least as far away as the split
+                const f32_t far = std::max(bound, diff * diff);
+                if (far < distances[k - 1]) {
+                    branches.push_back({far, t, diff < 0 ? node.right : node.left});
+                    std::push_heap(branches.begin(), branches.end(), std::greater<Branch>());
+                }
+                n = diff < 0 ? node.left : node.right;
+            }
+
+            for (u32_t p : tree[n].points) {
+                if (visited[p] == mark)
+                    continue;
+                visited[p] = mark;
+                checked++;
+
+                const f32_t distance = alg::squaredDistance(query, descriptor(p));
+                if (distance < distances[k - 1]) {
+                    u32_t i = k - 1;
+                    for (; i > 0 && distances[i - 1] > distance; i--) {
+                        distances[i] = distances[i - 1];
+                        indices[i] = indices[i - 1];
+                    }
+                    distances[i] = distance;
+                    indices[i] = p;
+                }
+            }
+        };
+
+        for (u16_t t = 0; t < _trees; t++) {
+            descend(t, 0, 0);
+        }
+        while (!branches.empty() && (checks == 0 || checked < checks)) {
+            std::pop_heap(branches.begin(), branches.end(), std::greater<Branch>());
+            const Branch b = branches.back();
+            branches.pop_back();
+            //The branches come in the order of their distance, so none of the others is closer
+            if (b.distance >= distances[k - 1])
+                break;
+            descend(b.tree, b.node, b.distance);
+        }
+    }
+
+    void KdForest::search(const f32_t* queries, u32_t count, u32_t k, u32_t checks, std::vector<u32_t>& indices,
+            std::vector<f32_t>& distances) {
+
+        indices.assign(static_cast<u64_t>(count) * k, size());
+        distances.assign(static_cast<u64_t>(count) * k, std::numeric_limits<f32_t>::infinity());
+        if (k == 0)
+            return;
+
+        const u32_t blocks = (count + queryBlock - 1) / queryBlock;
+        _pool.parallelFor(0, blocks, [&](u32_t b) {
+            std::vector<u8_t> visited(size(), 0);
+            const u32_t begin = b * queryBlock;
+            const u32_t end = std::min(count, begin + queryBlock);
+            for (u32_t q = begin; q < end; q++) {
+                _search(queries + static_cast<u64_t>(q) * alg::descriptorSize, k, checks, visited, q - begin + 1,
+                        &indices[static_cast<u64_t>(q) * k], &distances[static_cast<u64_t>(q) * k]);
+            }
+        });
+    }
+
+    std::vector<Match> KdForest::match(const f32_t* queries, u32_t count, f32_t ratio, u32_t checks) {
+        std::vector<u32_t> indices;
+        std::vector<f32_t> distances;
+        search(queries, count, 2, checks, indices, distances);
+
+        std::vector<Match> matches;
+        for (u32_t q = 0; q < count; q++) {
+            const f32_t first = distances[2 * q];
+            if (indices[2 * q] == size())
+                continue;
+            //The distances are squared, so is the ratio
+            if (ratio < 1 && !(first < ratio * ratio * distances[2 * q + 1]))
+                continue;
+            matches.push_back({q, indices[2 * q], std::sqrt(first)});
+        }
+        return matches;
+    }
+
+    std::vector<Match> KdForest::match(const DescriptorSet& set, f32_t ratio, u32_t checks) {
+        return match(set.descriptors.data(), set.size(), ratio, checks);
+    }
+
+    void KdForest::save(const std::string& file) const {
+        std::ofstream out(file, std::ios::binary);
+        if (!out)
+            throw std::runtime_error("Can't write " + file);
+
+        //Fixed widths, because u32_t isn't 32 bit on every platform
+        out.write(magic, sizeof(magic));
+        put<std::uint32_t>(out, version);
+        put<std::uint32_t>(out, byteOrder);
+        put<std::uint32_t>(out, _trees);
+        put<std::uint32_t>(out, _leafSize);
+        put<std::uint32_t>(out, _seed);
+        put<std::uint32_t>(out, alg::descriptorSize);
+        put<std::uint64_t>(out, size());
+        out.write(reinterpret_cast<const char*>(_descriptors.data()), _descriptors.size() * sizeof(f32_t));
+
+        for (const Tree& tree : _forest) {
+            put<std::uint64_t>(out, tree.size());
+            for (const Node& node : tree) {
+                put<f32_t>(out, node.split);
+                put<std::uint32_t>(out, node.dim);
+                put<std::uint32_t>(out, node.left);
+                put<std::uint32_t>(out, node.right);
+                put<std::uint32_t>(out, node.points.size());
+                for (u32_t p : node.points) {
+                    put<std::uint32_t>(out, p);
+                }
+            }
+        }
+        if (!out)
+            throw std::runtime_error("Can't write " + file);
+    }
+
+    std::unique_ptr<KdForest> KdForest::load(const std::string& file, u16_t threads) {
+        std::ifstream in(file, std::ios::binary);
+        if (!in)
+            throw std::runtime_error("Can't open " + file);
+
+        char m[sizeof(magic)];
+        in.read(m, sizeof(m));
+        if (!in || std::memcmp(m, magic, sizeof(magic)) != 0)
+            throw std::runtime_error(file + " is no index");
+        const std::uint32_t v = get<std::uint32_t>(in);
+        const std::uint32_t order = get<std::uint32_t>(in);
+        const std::uint32_t trees = get<std::uint32_t>(in);
+        const std::uint32_t leafSize = get<std::uint32_t>(in);
+        const std::uint32_t seed = get<std::uint32_t>(in);
+        const std::uint32_t descriptorSize = get<std::uint32_t>(in);
+        const std::uint64_t count = get<std::uint64_t>(in);
+        if (!in || v != version || order != byteOrder || descriptorSize != alg::descriptorSize || trees == 0 ||
+                trees > std::numeric_limits<u16_t>::max()) {
+
+            throw std::runtime_error(file + " has an unsupported version or layout");
+        }
+
+        //Every size is checked against the rest of the file before it is allocated, so a damaged
+        //size can't ask for more memory than the file holds
+        const std::string damaged = file + " is truncated or damaged";
+        if (count > std::numeric_limits<std::uint32_t>::max() ||
+                count > remaining(in) / (alg::descriptorSize * sizeof(f32_t))) {
+
+            throw std::runtime_error(damaged);
+        }
+
+        std::unique_ptr<KdForest> forest(new KdForest(trees, leafSize, threads, seed));
+        forest->_descriptors.resize(count * alg::descriptorSize);
+        in.read(reinterpret_cast<char*>(forest->_descriptors.data()), forest->_descriptors.size() * sizeof(f32_t));
+
+        for (Tree& tree : forest->_forest) {
+            const std::uint64_t nodes = get<std::uint64_t>(in);
+            if (!in || nodes > remaining(in) / nodeBytes)
+                throw std::runtime_error(damaged);
+            tree.resize(nodes);
+            for (u32_t i = 0; i < tree.size(); i++) {
+                Node& node = tree[i];
+                node.split = get<f32_t>(in);
+                node.dim = get<std::uint32_t>(in);
+                node.left = get<std::uint32_t>(in);
+                node.right = get<std::uint32_t>(in);
+                const std::uint32_t points = get<std::uint32_t>(in);
+                if (!in || points > remaining(in) / sizeof(std::uint32_t))
+                    throw std::runtime_error(damaged);
+                node.points.resize(points);
+                for (u32_t& p : node.points) {
+                    p = get<std::uint32_t>(in);
+                }
+                //Children always come after their parent, so a damaged file can't make a cycle
+                const bool children = node.leaf() || (node.left > i && node.right > i &&
+                        node.left < tree.size() && node.right < tree.size());
+                if (!in || node.dim >= alg::descriptorSize || !children ||
+                        std::any_of(node.points.begin(), node.points.end(), [count](u32_t p) { return p >= count; })) {
+
+                    throw std::runtime_error(damaged);
+                }
+            }
+            if (tree.empty())
+                throw std::runtime_error(damaged);
+        }
+
+        //Inserts after loading continue with new random numbers
+        for (u16_t t = 0; t < forest->_trees; t++) {
+            forest->_random[t] = std::mt19937(seed + t + count);
+        }
+        return forest;
+    }
+}
@@ -0,0 +1,217 @@
+#ifndef KDFOREST_HPP
+#define KDFOREST_HPP
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <random>
+
+#include "types.hpp"
+#include "aligned.hpp"
+#include "descriptorset.hpp"
+#include "matcher.hpp"
+#include "threadpool.hpp"
+
+namespace sift {
+    /**
+     * An approximate nearest neighbour index over a large database of descriptors. It is a
+     * forest of randomized KD-trees: every tree splits the descriptors at the mean of one of the
+     * dimensions with the highest variance, which is chosen randomly, so the trees partition the
+     * space differently. A search descends all trees and then visits the most promising branches
+     * of all trees in the order of their distance to the query, until a given count of
+     * descriptors was compared. More checks give a higher recall and a lower throughput.
+     */
+    class KdForest {
+        private:
+            /**
+             * A node of a tree. Inner nodes split at a value of a dimension, leaves keep the
+             * indices of their descriptors.
+             */
+            struct Node {
+                f32_t split = 0;
+                u32_t dim = 0;
+
+                /**
+                 * The children of an inner node. The root can't be a child, so 0 marks a leaf.
+                 */
+                u32_t left = 0;
+                u32_t right = 0;
+
+                std::vector<u32_t> points;
+
+                bool leaf() const {
+                    return left == 0;
+                }
+            };
+
+            typedef std::vector<Node> Tree;
+
+            const u16_t _trees;
+
+            /**
+             * The count of descriptors, up to which a node stays a leaf
+             */
+            const u32_t _leafSize;
+
+            const u32_t _seed;
+
+            /**
+             * All descriptors of the index row by row
+             */
+            std::vector<f32_t, AlignedAllocator<f32_t>> _descriptors;
+
+            std::vector<Tree> _forest;
+
+            /**
+             * The random numbers of each tree, which are continued by inserts
+             */
+            std::vector<std::mt19937> _random;
+
+            ThreadPool _pool;
+
+            /**
+             * Chooses the dimension and the value at which a set of descriptors gets split
+             * @param points the indices of the descriptors
+             * @param count the count of indices
+             * @param random the random numbers of the tree
+             * @param dim takes the dimension
+             * @param split takes the value
+             */
+            void _chooseSplit(const u32_t*, u32_t, std::mt19937&, u32_t&, f32_t&) const;
+
+            /**
+             * Splits descriptors into two halves at a chosen dimension
+             * @param points the indices of the descriptors, which get reordered
+             * @param count the count of indices
+             * @param random the random numbers of the tree
+             * @param dim takes the dimension
+             * @param split takes the value
+             * @return the count of descriptors of the left half, which are the first ones
+             */
+            u32_t _partition(u32_t*, u32_t, std::mt19937&, u32_t&, f32_t&) const;
+
+            /**
+             * Builds the subtree of a range of descriptors
+             * @param tree the tree, which gets the nodes
+             * @param points the indices of the descriptors
+             * @param count the count of indices
+             * @param random the random numbers of the tree
+             * @return the index of the root of the subtree
+             */
+            u32_t _build(Tree&, u32_t*, u32_t, std::mt19937&) const;
+
+            /**
+             * Inserts a descriptor into the leaf it belongs to and splits the leaf, when it got
+             * twice as big as a leaf of a fresh tree
+             * @param tree the tree
+             * @param point the index of the descriptor
+             * @param random the random numbers of the tree
+             */
+            void _insert(Tree&, u32_t, std::mt19937&) const;
+
+            /**
+             * Searches the nearest descriptors of a single query
+             * @param query the descriptor to search
+             * @param k how many neighbours are searched
+             * @param checks how many descriptors are compared at most, 0 for an exact search
+             * @param visited a mark for every descriptor, which is set once it was compared
+             * @param mark the value of the mark of this query
+             * @param indices takes the k indices of the neighbours
+             * @param distances takes the k squared distances of the neighbours
+             */
+            void _search(const f32_t*, u32_t, u32_t, std::vector<u8_t>&, u8_t, u32_t*, f32_t*) const;
+
+        public:
+            /**
+             * @param trees the count of randomized trees
+             * @param leafSize the largest count of descriptors in a leaf
+             * @param threads how many threads build the trees and search the queries. 0 uses
+             * all cores
+             * @param seed the seed of the random numbers, so the same seed builds the same trees
+             */
+            explicit KdForest(u16_t trees = 4, u32_t leafSize = 16, u16_t threads = 1, u32_t seed = 0);
+
+            KdForest(const KdForest&) = delete;
+            KdForest& operator=(const KdForest&) = delete;
+
+            /**
+             * Replaces the content of the index and builds all trees. The trees are built in
+             * parallel.
+             * @param descriptors the descriptors row by row
+             * @param count the count of descriptors
+             */
+            void build(const f32_t*, u32_t);
+
+            void build(const DescriptorSet&);
+
+            /**
+             * Adds descriptors to an index without building it again. They get the next
+             * indices and are inserted into all trees in parallel.
+             * @param descriptors the descriptors row by row
+             * @param count the count of descriptors
+             */
+            void add(const f32_t*, u32_t);
+
+            void add(const DescriptorSet&);
+
+            /**
+             * @return the count of descriptors in the index
+             */
+            u32_t size() const {
+                return _descriptors.size() / alg::descriptorSize;
+            }
+
+            /**
+             * @param i the index of a descriptor
+             * @return its alg::descriptorSize values
+             */
+            const f32_t* descriptor(u32_t i) const {
+                return &_descriptors[static_cast<u64_t>(i) * alg::descriptorSize];
+            }
+
+            /**
+             * Searches the k nearest descriptors of many queries in parallel. If the index has
+             * less than k descriptors, the missing neighbours get the index size() and an
+             * infinite distance.
+             * @param queries the query descriptors row by row
+             * @param count the count of queries
+             * @param k how many neighbours are searched per query
+             * @param checks how many descriptors are compared at most per query. 0 compares
+             * as many as needed for the exact result
+             * @param indices takes count * k indices of the neighbours, nearest first
+             * @param distances takes count * k squared distances of the neighbours
+             */
+            void search(const f32_t*, u32_t, u32_t, u32_t, std::vector<u32_t>&, std::vector<f32_t>&);
+
+            /**
+             * Matches query descriptors against the index with Lowe's ratio test
+             * @param queries the query descriptors row by row
+             * @param count the count of queries
+             * @param ratio the largest ratio of the nearest to the second nearest distance
+             * @param checks how many descriptors are compared at most per query
+             * @return the matches ordered by their query index, whose train index is the index
+             * in this index
+             */
+            std::vector<Match> match(const f32_t*, u32_t, f32_t = 0.8, u32_t = 128);
+
+            std::vector<Match> match(const DescriptorSet&, f32_t = 0.8, u32_t = 128);
+
+            /**
+             * Writes the descriptors and all trees to a file, so the index doesn't need to be
+             * built again
+             * @param file the path of the file
+             * @throws std::runtime_error if the file can't be written
+             */
+            void save(const std::string&) const;
+
+            /**
+             * Reads an index, which was written by save
+             * @param file the path of the file
+             * @param threads how many threads search the queries. 0 uses all cores
+             * @return the index
+             * @throws std::runtime_error if the file can't be read or isn't an index
+             */
+            static std::unique_ptr<KdForest> load(const std::string&, u16_t = 1);
+    };
+}
+#endif //KDFOREST_HPP
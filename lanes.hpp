@@ -0,0 +1,136 @@
+#ifndef LANES_HPP
+#define LANES_HPP
+
+#include <cmath>
+
+#include "types.hpp"
+
+#if defined(__AVX512F__)
+#include <immintrin.h>
+#elif defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#endif
+
+namespace sift {
+    namespace alg {
+#if defined(__AVX512F__)
+        /**
+         * 16 floats in an AVX-512 register
+         */
+        struct Lanes {
+            typedef __m512 type;
+            typedef __mmask16 mask;
+            static const u32_t size = 16;
+            static type load(const f32_t* p) { return _mm512_loadu_ps(p); }
+            static void store(f32_t* p, type v) { _mm512_storeu_ps(p, v); }
+            static type set(f32_t v) { return _mm512_set1_ps(v); }
+            static type add(type a, type b) { return _mm512_add_ps(a, b); }
+            static type sub(type a, type b) { return _mm512_sub_ps(a, b); }
+            static type mul(type a, type b) { return _mm512_mul_ps(a, b); }
+            static type div(type a, type b) { return _mm512_div_ps(a, b); }
+            static type sqrt(type a) { return _mm512_sqrt_ps(a); }
+            static type max(type a, type b) { return _mm512_max_ps(a, b); }
+            static type min(type a, type b) { return _mm512_min_ps(a, b); }
+            static mask ge(type a, type b) { return _mm512_cmp_ps_mask(a, b, _CMP_GE_OQ); }
+            static mask le(type a, type b) { return _mm512_cmp_ps_mask(a, b, _CMP_LE_OQ); }
+            static mask lt(type a, type b) { return _mm512_cmp_ps_mask(a, b, _CMP_LT_OQ); }
+            static mask both(mask a, mask b) { return a & b; }
+            static mask either(mask a, mask b) { return a | b; }
+            static type select(mask m, type a, type b) { return _mm512_mask_blend_ps(m, b, a); }
+            static u32_t bits(mask m) { return m; }
+            static f32_t sum(type a) { return _mm512_reduce_add_ps(a); }
+        };
+#elif defined(__AVX2__)
+        /**
+         * 8 floats in an AVX register
+         */
+        struct Lanes {
+            typedef __m256 type;
+            typedef __m256 mask;
+            static const u32_t size = 8;
+            static type load(const f32_t* p) { return _mm256_loadu_ps(p); }
+            static void store(f32_t* p, type v) { _mm256_storeu_ps(p, v); }
+            static type set(f32_t v) { return _mm256_set1_ps(v); }
+            static type add(type a, type b) { return _mm256_add_ps(a, b); }
+            static type sub(type a, type b) { return _mm256_sub_ps(a, b); }
+            static type mul(type a, type b) { return _mm256_mul_ps(a, b); }
+            static type div(type a, type b) { return _mm256_div_ps(a, b); }
+            static type sqrt(type a) { return _mm256_sqrt_ps(a); }
+            static type max(type a, type b) { return _mm256_max_ps(a, b); }
+            static type min(type a, type b) { return _mm256_min_ps(a, b); }
+            static mask ge(type a, type b) { return _mm256_cmp_ps(a, b, _CMP_GE_OQ); }
+            static mask le(type a, type b) { return _mm256_cmp_ps(a, b, _CMP_LE_OQ); }
+            static mask lt(type a, type b) { return _mm256_cmp_ps(a, b, _CMP_LT_OQ); }
+            static mask both(mask a, mask b) { return _mm256_and_ps(a, b); }
+            static mask either(mask a, mask b) { return _mm256_or_ps(a, b); }
+            static type select(mask m, type a, type b) { return _mm256_blendv_ps(b, a, m); }
+            static u32_t bits(mask m) { return _mm256_movemask_ps(m); }
+            static f32_t sum(type a) {
+                const __m128 half = _mm_add_ps(_mm256_castps256_ps128(a), _mm256_extractf128_ps(a, 1));
+                const __m128 quarter = _mm_add_ps(half, _mm_movehl_ps(half, half));
+                return _mm_cvtss_f32(_mm_add_ss(quarter, _mm_shuffle_ps(quarter, quarter, 1)));
+            }
+        };
+#elif defined(__SSE2__) || defined(_M_X64)
+        /**
+         * 4 floats in a SSE register
+         */
+        struct Lanes {
+            typedef __m128 type;
+            typedef __m128 mask;
+            static const u32_t size = 4;
+            static type load(const f32_t* p) { return _mm_loadu_ps(p); }
+            static void store(f32_t* p, type v) { _mm_storeu_ps(p, v); }
+            static type set(f32_t v) { return _mm_set1_ps(v); }
+            static type add(type a, type b) { return _mm_add_ps(a, b); }
+            static type sub(type a, type b) { return _mm_sub_ps(a, b); }
+            static type mul(type a, type b) { return _mm_mul_ps(a, b); }
+            static type div(type a, type b) { return _mm_div_ps(a, b); }
+            static type sqrt(type a) { return _mm_sqrt_ps(a); }
+            static type max(type a, type b) { return _mm_max_ps(a, b); }
+            static type min(type a, type b) { return _mm_min_ps(a, b); }
+            static mask ge(type a, type b) { return _mm_cmpge_ps(a, b); }
+            static mask le(type a, type b) { return _mm_cmple_ps(a, b); }
+            static mask lt(type a, type b) { return _mm_cmplt_ps(a, b); }
+            static mask both(mask a, mask b) { return _mm_and_ps(a, b); }
+            static mask either(mask a, mask b) { return _mm_or_ps(a, b); }
+            static type select(mask m, type a, type b) { return _mm_or_ps(_mm_and_ps(m, a), _mm_andnot_ps(m, b)); }
+            static u32_t bits(mask m) { return _mm_movemask_ps(m); }
+            static f32_t sum(type a) {
+                const __m128 half = _mm_add_ps(a, _mm_movehl_ps(a, a));
+                return _mm_cvtss_f32(_mm_add_ss(half, _mm_shuffle_ps(half, half, 1)));
+            }
+        };
+#else
+        /**
+         * A single float for targets without a known vector extension
+         */
+        struct Lanes {
+            typedef f32_t type;
+            typedef bool mask;
+            static const u32_t size = 1;
+            static type load(const f32_t* p) { return *p; }
+            static void store(f32_t* p, type v) { *p = v; }
+            static type set(f32_t v) { return v; }
+            static type add(type a, type b) { return a + b; }
+            static type sub(type a, type b) { return a - b; }
+            static type mul(type a, type b) { return a * b; }
+            static type div(type a, type b) { return a / b; }
+            static type sqrt(type a) { return std::sqrt(a); }
+            static type max(type a, type b) { return a < b ? b : a; }
+            static type min(type a, type b) { return b < a ? b : a; }
+            static mask ge(type a, type b) { return a >= b; }
+            static mask le(type a, type b) { return a <= b; }
+            static mask lt(type a, type b) { return a < b; }
+            static mask both(mask a, mask b) { return a && b; }
+            static mask either(mask a, mask b) { return a || b; }
+            static type select(mask m, type a, type b) { return m ? a : b; }
+            static u32_t bits(mask m) { return m; }
+            static f32_t sum(type a) { return a; }
+        };
+#endif
+    }
+}
+#endif //LANES_HPP
@@ -1,29 +1,83 @@
 #include <iostream>
-#include <fstream>
 #include <vector>
 #include <string>
+#include <memory>
+#include <thread>
+#include <algorithm>
+#include <chrono>
+#include <sstream>
+#include <stdexcept>
 
 #include <vigra/impex.hxx>
 #include <vigra/multi_array.hxx>
 
-#include <opencv/cv.hpp>
-
 #include <boost/program_options.hpp>
 
 #include "sift.hpp"
-#include "interestpoint.hpp"
+#include "descriptorset.hpp"
+#include "output.hpp"
+#include "batch.hpp"
+#include "matcher.hpp"
+#include "tiled.hpp"
+#include "daemon.hpp"
+#include "stream.hpp"
+#include "roi.hpp"
 
 namespace po = boost::program_options;
 
+namespace {
+    /**
+     * @param file the path of the image
+     * @return the image as grey values
+     */
+    vigra::MultiArray<2, f32_t> load(const std::string& file) {
+        vigra::ImageImportInfo info(file.c_str());
+        vigra::MultiArray<2, f32_t> img(vigra::Shape2(info.shape()));
+        vigra::importImage(info, img);
+        return img;
+    }
+
+    /**
+     * @param text a rectangle as x,y,width,height
+     * @return the rectangle
+     */
+    sift::Roi parseRoi(const std::string& text) {
+        std::istringstream in(text);
+        sift::Roi roi;
+        char a = 0, b = 0, c = 0;
+        in >> roi.x >> a >> roi.y >> b >> roi.width >> c >> roi.height;
+        if (!in || a != ',' || b != ',' || c != ',' || !(in >> std::ws).eof())
+            throw std::invalid_argument("The region of interest " + text + " isn't x,y,width,height");
+        return roi;
+    }
+}
+
 /*
- * Main Function takes a greyvalue image as input
+ * Main Function takes a greyvalue image or a batch of them as input. "sift match a b" matches
+ * the features of two images instead and "sift daemon" serves requests until it is shut down.
  */
 int main(int argc, char** argv) {
-    std::string img_file;
-    f32_t sigma, k; 
-    u16_t octaves, dogsPerEpoch; 
+    const bool matching = argc > 1 && std::string(argv[1]) == "match";
+    const bool serving = argc > 1 && std::string(argv[1]) == "daemon";
+    if (matching || serving) {
+        argv[1] = argv[0];
+        argv++;
+        argc--;
+    }
+
+    std::string img_file, second_file, batch, format, socket, precision;
+    std::vector<std::string> roiTexts;
+    f32_t sigma, k, contrast, ratio; 
+    bool crossCheck;
+    u16_t octaves, dogsPerEpoch, threads, decoders; 
+    u32_t queue, budget, tileSize, maxKeypoints, streamTile;
     bool subpixel;
+    bool incremental;
     bool result;
+    bool overlay;
+    bool profile;
+    bool tiled;
+    bool streaming;
 
     po::options_description desc("Options");
 
@@ -36,9 +90,30 @@ int main(int argc, char** argv) {
         ("dogsPerEpoch,d", po::value<u16_t>(&dogsPerEpoch)->default_value(3), "How many DoGs should be created per epoch")
         ("subpixel,p", po::value<bool>(&subpixel)->default_value(false), "Starts with the doubled size of initial image")
         ("result,r", po::value<bool>(&result)->default_value(false), "Print the resulting InterestPoints in a file")
+        ("format,f", po::value<std::string>(&format)->default_value("text"), "The format of the result: text, binary or quantized")
+        ("threads,t", po::value<u16_t>(&threads)->default_value(1), "How many threads build the scale space. 0 uses all cores")
+        ("incremental,n", po::value<bool>(&incremental)->default_value(false), "Blur every level by the incremental sigma to the level below")
+        ("contrast,c", po::value<f32_t>(&contrast)->default_value(0), "The smallest |DoG - 128| of an interest point candidate")
+        ("precision", po::value<std::string>(&precision)->default_value("f32"), "How the magnitude and orientation pyramids are stored: f32, f16 or u16")
+        ("maxKeypoints", po::value<u32_t>(&maxKeypoints)->default_value(0), "The most interest points of an image, the strongest spread over the image. 0 keeps all")
+        ("overlay,v", po::value<bool>(&overlay), "Draw the interest points onto the image. On by default for a single image")
+        ("batch,b", po::value<std::string>(&batch), "A directory or a file with one image per line, whose images are all processed")
+        ("decoders", po::value<u16_t>(&decoders)->default_value(2), "How many images are decoded at the same time in the batch mode")
+        ("queue", po::value<u32_t>(&queue)->default_value(8), "How many images may wait between two stages of the batch mode")
+        ("profile", po::bool_switch(&profile), "Print the times, counts and memory of the calculation as JSON")
+        ("tiled", po::bool_switch(&tiled), "Read a PGM image tile by tile, so only a part of it is in memory")
+        ("budget", po::value<u32_t>(&budget)->default_value(1024), "The memory of the tiled mode for all workers in MB")
+        ("tileSize", po::value<u32_t>(&tileSize)->default_value(0), "The size of a tile in the tiled mode. 0 derives it from the budget")
+        ("stream", po::bool_switch(&streaming), "Calculate the images of --batch in their order as the frames of a video, which all have the same size")
+        ("streamTile", po::value<u32_t>(&streamTile)->default_value(0), "The size of the tiles of the stream mode, which are only calculated again, if their pixels changed. 0 calculates every frame as a whole")
+        ("roi", po::value<std::vector<std::string>>(&roiTexts)->composing(), "Only calculate the interest points inside of the rectangle x,y,width,height of the image. Can be given several times")
+        ("second", po::value<std::string>(&second_file), "The second image of the match mode")
+        ("ratio", po::value<f32_t>(&ratio)->default_value(0.8), "The largest ratio of the nearest to the second nearest distance of a match")
+        ("crossCheck,x", po::value<bool>(&crossCheck)->default_value(false), "Only keep matches, which are nearest neighbours in both directions")
+        ("socket", po::value<std::string>(&socket), "The Unix domain socket of the daemon mode. Without it the daemon serves stdin and stdout")
         ;  
     po::positional_options_description p; 
-    p.add("img", 1);
+    p.add("img", 1).add("second", 1);
     po::variables_map vm; 
     try {
         po::store(po::command_line_parser(argc, argv).options(desc).positional(p).run(), vm); 
@@ -49,44 +124,150 @@ int main(int argc, char** argv) {
             return 1;
         }
 
-        vigra::ImageImportInfo info(img_file.c_str());
-        vigra::MultiArray<2, f32_t> img(vigra::Shape2(info.shape()));
-        vigra::importImage(info, img);
+        const sift::ResultFormat resultFormat = sift::resultFormat(format);
+        const sift::Precision storage = sift::precision(precision);
+
+        if (streaming) {
+            const std::vector<std::string> frames = sift::Batch::collect(batch);
+            if (frames.empty())
+                throw std::runtime_error("The stream has no frames");
+
+            sift::Sift sift(dogsPerEpoch, octaves, sigma, k, subpixel, threads, incremental, contrast, storage,
+                    maxKeypoints);
+            vigra::MultiArray<2, f32_t> frame = load(frames[0]);
+            sift::SiftStream stream(sift, frame.shape(), streamTile);
+
+            //The features of a frame come out of the stream with the next one
+            sift::DescriptorSet set;
+            u64_t keypoints = 0;
+            u32_t described = 0;
+            auto handOut = [&]() {
+                keypoints += set.size();
+                if (result)
+                    sift::writeResult(frames[described], set, resultFormat);
+                described++;
+            };
+            for (u32_t f = 0; f < frames.size(); f++) {
+                if (f > 0)
+                    frame = load(frames[f]);
+                if (stream.push(frame, set))
+                    handOut();
+            }
+            if (stream.finish(set))
+                handOut();
+
+            const sift::StreamStats& stats = stream.stats();
+            std::cout << stats.frames << " frames, " << keypoints << " interest points in " << stats.seconds 
+                << "s: " << stats.framesPerSecond() << " frames/s, " << stats.meanLatencySeconds() 
+                << "s mean latency, " << stats.reusedTiles << " of " << stats.tiles << " tiles reused\n";
+            if (profile)
+                std::cout << stats.toJson() << std::endl;
+            return 0;
+        }
 
-        sift::Sift sift(dogsPerEpoch, octaves, sigma, k, subpixel);
-        std::vector<sift::InterestPoint> interestPoints = sift.calculate(img);
-
-        auto image = cv::imread(img_file.c_str(), CV_LOAD_IMAGE_COLOR);
-        u16_t subpixel_divisor = sift.subpixel ? 2 : 1;
-        for (const sift::InterestPoint& p : interestPoints) {
-            u16_t x = (p.loc.x * std::pow(2, p.octave)) / subpixel_divisor;
-            u16_t y = (p.loc.y * std::pow(2, p.octave)) / subpixel_divisor;
-            cv::RotatedRect r(cv::Point2f(x, y), 
-                    cv::Size(p.scale * 10, p.scale * 10),
-                    p.orientation);
-
-            cv::Point2f points[4]; 
-            r.points( points );
-            cv::line(image, points[0], points[1], cv::Scalar(255, 0, 0));
-            cv::line(image, points[0], points[3], cv::Scalar(255, 0, 0));
-            cv::line(image, points[2], points[3], cv::Scalar(255, 0, 0));
-            cv::line(image, points[1], points[2], cv::Scalar(255, 0, 0));
+        if (vm.count("batch")) {
+            //Every compute worker gets a Sift object with a single thread
+            const u16_t workers = threads > 0 ? threads : std::max(1u, std::thread::hardware_concurrency());
+            sift::Batch runner([&]() {
+                        return std::unique_ptr<sift::Sift>(new sift::Sift(dogsPerEpoch, octaves, sigma, k, 
+                                    subpixel, 1, incremental, contrast, storage, maxKeypoints));
+                    }, workers, decoders, queue, vm.count("overlay") && overlay, result, resultFormat);
+
+            const sift::BatchStats stats = runner.run(sift::Batch::collect(batch));
+            std::cout << stats.images << " images, " << stats.failed << " failed, " << stats.keypoints 
+                << " interest points in " << stats.seconds << "s: " << stats.imagesPerSecond() << " images/s\n";
+            return stats.failed > 0 ? 1 : 0;
+        }
+
+        if (serving) {
+            //The workers share one Sift object and keep a context each
+            const u16_t workers = threads > 0 ? threads : std::max(1u, std::thread::hardware_concurrency());
+            sift::Daemon daemon(std::unique_ptr<sift::Sift>(new sift::Sift(dogsPerEpoch, octaves, sigma, k, 
+                            subpixel, 1, incremental, contrast, storage, maxKeypoints)), workers, queue);
+            if (vm.count("socket")) {
+                daemon.listen(socket);
+            } else {
+                daemon.serve(0, 1);
+            }
+            std::cerr << daemon.stats().toJson() << std::endl;
+            return 0;
+        }
+
+        if (matching) {
+            sift::Sift sift(dogsPerEpoch, octaves, sigma, k, subpixel, threads, incremental, contrast, storage,
+                    maxKeypoints);
+            sift::DescriptorSet first, second;
+            sift.calculate(load(img_file), first);
+            sift.calculate(load(second_file), second);
+
+            sift::Matcher matcher(ratio, crossCheck, threads);
+            const auto start = std::chrono::steady_clock::now();
+            const std::vector<sift::Match> matches = matcher.match(first, second);
+            const std::chrono::duration<f64_t> took = std::chrono::steady_clock::now() - start;
+
+            const f64_t pairs = static_cast<f64_t>(first.size()) * second.size();
+            std::cout << matches.size() << " matches of " << first.size() << " x " << second.size() 
+                << " descriptors in " << took.count() << "s: " << (took.count() > 0 ? matches.size() / took.count() : 0)
+                << " matches/s, " << (took.count() > 0 ? pairs / took.count() : 0) << " comparisons/s\n";
+
+            if (result)
+                sift::writeMatches("matches.txt", first, second, matches);
+            return 0;
         }
 
-        cv::imwrite(img_file + "_orientation.png", image);
-
-        if (result) {
-            std::ofstream out("interstpoints.txt");
-            out << "Location\tscale\torientation\tdescriptors\n";
-            for (const sift::InterestPoint& p : interestPoints) {
-               out << "[" << p.loc.x << ", " << p.loc.y <<  "]\t" << p.scale << "\t" << p.orientation << "\t" << "[";
-               for (f32_t d : p.descriptors) {
-                   out << d << ", ";
-               }
-               out << "]\n";
+        if (tiled) {
+            //Every tile worker gets a Sift object with a single thread
+            const u16_t workers = threads > 0 ? threads : std::max(1u, std::thread::hardware_concurrency());
+            sift::TiledSift runner([&]() {
+                        return std::unique_ptr<sift::Sift>(new sift::Sift(dogsPerEpoch, octaves, sigma, k, 
+                                    subpixel, 1, incremental, contrast, storage, maxKeypoints));
+                    }, static_cast<u64_t>(budget) << 20, workers, tileSize);
+
+            sift::DescriptorSet set;
+            const auto start = std::chrono::steady_clock::now();
+            const sift::TilePlan plan = runner.extract(img_file, set);
+            const std::chrono::duration<f64_t> took = std::chrono::steady_clock::now() - start;
+            std::cout << set.size() << " interest points in " << took.count() << "s from " << plan.columns << " x " 
+                << plan.rows << " tiles of " << plan.tileSize << " pixels with a halo of " << plan.halo << ", " 
+                << plan.workers << " workers with " << (plan.bytesPerWorker >> 20) << "MB each\n";
+
+            if (result)
+                sift::writeResult("interstpoints", set, resultFormat);
+            return 0;
+        }
+
+        const vigra::MultiArray<2, f32_t> img = load(img_file);
+
+        sift::Sift sift(dogsPerEpoch, octaves, sigma, k, subpixel, threads, incremental, contrast, storage,
+                maxKeypoints);
+        sift::DescriptorSet set;
+        if (!roiTexts.empty()) {
+            std::vector<sift::Roi> rois;
+            for (const std::string& text : roiTexts) {
+                rois.push_back(parseRoi(text));
             }
-            out.close();
+            const auto start = std::chrono::steady_clock::now();
+            const std::vector<sift::RoiGroup> groups = sift::calculateRois(sift, img, rois, set);
+            const std::chrono::duration<f64_t> took = std::chrono::steady_clock::now() - start;
+
+            u64_t pixels = 0;
+            for (const sift::RoiGroup& g : groups) {
+                pixels += static_cast<u64_t>(g.region.shape[0]) * g.region.shape[1];
+            }
+            std::cout << set.size() << " interest points in " << took.count() << "s from " << groups.size() 
+                << " regions with " << pixels << " of " << img.size() << " pixels\n";
+        } else {
+            sift::SiftStats stats;
+            sift.calculate(img, set, profile ? &stats : nullptr);
+            if (profile)
+                std::cout << stats.toJson() << std::endl;
         }
+
+        if (!vm.count("overlay") || overlay)
+            sift::writeOverlay(img_file + "_orientation.png", img, set);
+
+        if (result)
+            sift::writeResult("interstpoints", set, resultFormat);
     } catch (std::exception& ex) {
         std::cerr << ex.what() << std::endl;
     }
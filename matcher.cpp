@@ -0,0 +1,139 @@
+#include "matcher.hpp"
+
+#include <cmath>
+#include <limits>
+#include <algorithm>
+
+#include "lanes.hpp"
+
+namespace sift {
+    namespace {
+        /**
+         * The count of query descriptors, which are compared with a train descriptor at once
+         */
+        const u32_t group = 4;
+
+        /**
+         * The count of query descriptors of a parallel task
+         */
+        const u32_t queryBlock = 64;
+
+        /**
+         * The count of train descriptors, which are compared with all queries of a block before
+         * the next ones are loaded. 256 descriptors are 128KB and fit into the L2 cache.
+         */
+        const u32_t trainTile = 256;
+
+        static_assert(alg::descriptorSize % alg::Lanes::size == 0,
+                "A descriptor has to fill whole vector registers");
+
+        /**
+         * Calculates the squared distances of a group of query descriptors to one train descriptor
+         * @param q the query descriptors of the group
+         * @param t the train descriptor
+         * @param out takes the squared distances
+         */
+        inline void distances(const f32_t* const* q, const f32_t* t, f32_t* out) {
+            using alg::Lanes;
+            Lanes::type acc0 = Lanes::set(0);
+            Lanes::type acc1 = Lanes::set(0);
+            Lanes::type acc2 = Lanes::set(0);
+            Lanes::type acc3 = Lanes::set(0);
+            for (u32_t i = 0; i < alg::descriptorSize; i += Lanes::size) {
+                const Lanes::type v = Lanes::load(t + i);
+                const Lanes::type d0 = Lanes::sub(Lanes::load(q[0] + i), v);
+                const Lanes::type d1 = Lanes::sub(Lanes::load(q[1] + i), v);
+                const Lanes::type d2 = Lanes::sub(Lanes::load(q[2] + i), v);
+                const Lanes::type d3 = Lanes::sub(Lanes::load(q[3] + i), v);
+                acc0 = Lanes::add(acc0, Lanes::mul(d0, d0));
+                acc1 = Lanes::add(acc1, Lanes::mul(d1, d1));
+                acc2 = Lanes::add(acc2, Lanes::mul(d2, d2));
+                acc3 = Lanes::add(acc3, Lanes::mul(d3, d3));
+            }
+            out[0] = Lanes::sum(acc0);
+            out[1] = Lanes::sum(acc1);
+            out[2] = Lanes::sum(acc2);
+            out[3] = Lanes::sum(acc3);
+        }
+    }
+
+    namespace alg {
+        f32_t squaredDistance(const f32_t* a, const f32_t* b) {
+            Lanes::type acc = Lanes::set(0);
+            for (u32_t i = 0; i < descriptorSize; i += Lanes::size) {
+                const Lanes::type d = Lanes::sub(Lanes::load(a + i), Lanes::load(b + i));
+                acc = Lanes::add(acc, Lanes::mul(d, d));
+            }
+            return Lanes::sum(acc);
+        }
+    }
+
+    void Matcher::_nearest(const f32_t* query, u32_t queries, const f32_t* train, u32_t trains,
+            std::vector<Nearest>& nearest) {
+
+        const Nearest none = {0, std::numeric_limits<f32_t>::infinity(), std::numeric_limits<f32_t>::infinity()};
+        nearest.assign(queries, none);
+
+        const u32_t blocks = (queries + queryBlock - 1) / queryBlock;
+        _pool.parallelFor(0, blocks, [&](u32_t b) {
+            const u32_t begin = b * queryBlock;
+            const u32_t end = std::min(queries, begin + queryBlock);
+
+            for (u32_t tile = 0; tile < trains; tile += trainTile) {
+                const u32_t tileEnd = std::min(trains, tile + trainTile);
+                for (u32_t g = begin; g < end; g += group) {
+                    //A group at the end of the block repeats its last query
+                    const f32_t* q[group];
+                    for (u32_t i = 0; i < group; i++) {
+                        q[i] = query + std::min(g + i, end - 1) * alg::descriptorSize;
+                    }
+                    const u32_t count = std::min(group, end - g);
+
+                    for (u32_t t = tile; t < tileEnd; t++) {
+                        f32_t d[group];
+                        distances(q, train + t * alg::descriptorSize, d);
+                        for (u32_t i = 0; i < count; i++) {
+                            Nearest& n = nearest[g + i];
+                            if (d[i] < n.first) {
+                                n.second = n.first;
+                                n.first = d[i];
+                                n.index = t;
+                            } else if (d[i] < n.second) {
+                                n.second = d[i];
+                            }
+                        }
+                    }
+                }
+            }
+        });
+    }
+
+    std::vector<Match> Matcher::match(const f32_t* query, u32_t queries, const f32_t* train, u32_t trains) {
+        std::vector<Match> matches;
+        if (queries == 0 || trains == 0)
+            return matches;
+
+        std::vector<Nearest> forward;
+        _nearest(query, queries, train, trains, forward);
+
+        std::vector<Nearest> backward;
+        if (_crossCheck)
+            _nearest(train, trains, query, queries, backward);
+
+        //The distances are squared, so is the ratio
+        const f32_t ratio = _ratio * _ratio;
+        for (u32_t i = 0; i < queries; i++) {
+            const Nearest& n = forward[i];
+            if (_ratio < 1 && !(n.first < ratio * n.second))
+                continue;
+            if (_crossCheck && backward[n.index].index != i)
+                continue;
+            matches.push_back({i, n.index, std::sqrt(n.first)});
+        }
+        return matches;
+    }
+
+    std::vector<Match> Matcher::match(const DescriptorSet& query, const DescriptorSet& train) {
+        return match(query.descriptors.data(), query.size(), train.descriptors.data(), train.size());
+    }
+}
@@ -0,0 +1,114 @@
+#ifndef MATCHER_HPP
+#define MATCHER_HPP
+
+#include <vector>
+
+#include "types.hpp"
+#include "descriptorset.hpp"
+#include "threadpool.hpp"
+
+namespace sift {
+    namespace alg {
+        /**
+         * Calculates the squared euclidean distance of two descriptors with the vector unit
+         * @param a the descriptorSize values of the first descriptor
+         * @param b the descriptorSize values of the second descriptor
+         * @return the sum of the squared differences
+         */
+        f32_t squaredDistance(const f32_t*, const f32_t*);
+    }
+
+    /**
+     * A pair of descriptors, which describe the same point in two images
+     */
+    class Match {
+        public:
+            /**
+             * The index of the descriptor in the query set
+             */
+            u32_t query;
+
+            /**
+             * The index of the nearest descriptor in the train set
+             */
+            u32_t train;
+
+            /**
+             * The euclidean distance of both descriptors
+             */
+            f32_t distance;
+    };
+
+    /**
+     * Matches the descriptors of two images by comparing every query descriptor with every train
+     * descriptor. The squared distances are computed by a vectorized kernel, which compares a
+     * few query descriptors with a tile of train descriptors at once, so every train descriptor
+     * is loaded once per group of queries while the tile stays in the cache. The nearest and the
+     * second nearest descriptor of each query are kept to apply Lowe's ratio test.
+     */
+    class Matcher {
+        private:
+            /**
+             * The nearest and the second nearest train descriptor of a query
+             */
+            struct Nearest {
+                u32_t index;
+                f32_t first;
+                f32_t second;
+            };
+
+            /**
+             * The largest ratio of the nearest to the second nearest distance of a match
+             */
+            const f32_t _ratio;
+
+            /**
+             * Wether a match also needs to be the nearest query of its train descriptor
+             */
+            const bool _crossCheck;
+
+            ThreadPool _pool;
+
+            /**
+             * Searches the two nearest train descriptors of every query descriptor. The queries
+             * are split into blocks, which are shared by the threads of the pool.
+             * @param query the query descriptors row by row
+             * @param queries the count of query descriptors
+             * @param train the train descriptors row by row
+             * @param trains the count of train descriptors
+             * @param nearest takes the result of every query
+             */
+            void _nearest(const f32_t*, u32_t, const f32_t*, u32_t, std::vector<Nearest>&);
+
+        public:
+            /**
+             * @param ratio the largest ratio of the nearest to the second nearest distance, which
+             * is accepted as match. Lowe suggests 0.8, 1 accepts every nearest neighbour
+             * @param crossCheck wether the query also has to be the nearest neighbour of the train
+             * descriptor
+             * @param threads how many threads compare descriptors. 0 uses all cores
+             */
+            explicit Matcher(f32_t ratio = 0.8, bool crossCheck = false, u16_t threads = 1) :
+                _ratio(ratio), _crossCheck(crossCheck), _pool(threads) {
+            }
+
+            /**
+             * Matches two sets of descriptors
+             * @param query the query descriptors row by row with alg::descriptorSize values each
+             * @param queries the count of query descriptors
+             * @param train the train descriptors row by row with alg::descriptorSize values each
+             * @param trains the count of train descriptors
+             * @return the matches ordered by their query index, at most one per query
+             */
+            std::vector<Match> match(const f32_t*, u32_t, const f32_t*, u32_t);
+
+            /**
+             * Matches the descriptors of two images
+             * @param query the descriptors of the first image
+             * @param train the descriptors of the second image
+             * @return the matches ordered by their query index, at most one per query
+             */
+            std::vector<Match> match(const DescriptorSet&, const DescriptorSet&);
+    };
+}
+#endif //MATCHER_HPP
@@ -21,8 +21,8 @@ namespace sift {
          */
         class Matrix {
             private:
-                u16_t _width;
-                u16_t _height;
+                u32_t _width;
+                u32_t _height;
 
                 std::shared_ptr<T> _data;
 
@@ -33,49 +33,49 @@ namespace sift {
                  * allocates a data structure with the given dimensions and sets everything to a 
                  * default value
                  */
-                explicit Matrix(u16_t width, u16_t height, const T& def = T()) : _height(height), _width(width) {
+                explicit Matrix(u32_t width, u32_t height, const T& def = T()) : _width(width), _height(height) {
                     assert(width > 0 && height > 0);
 
-                    const u32_t size = _width * _height;
+                    const u64_t size = static_cast<u64_t>(_width) * _height;
 
                     _data = std::shared_ptr<T>(new T[size], std::default_delete<T[]>());
-                    for (u32_t i = 0; i < size; i++) {
+                    for (u64_t i = 0; i < size; i++) {
                         _data.get()[i] = def; 
                     }
                 }
 
-                u16_t width() const {
+                u32_t width() const {
                     return _width;
                 }
 
-                u16_t height() const {
+                u32_t height() const {
                     return _height;
                 }
 
-                T& operator [](const Point<u16_t, u16_t>& vec) {
+                T& operator [](const Point<u32_t, u32_t>& vec) {
                     assert(vec.x < _width && vec.y < _height);
 
-                    const u32_t index = vec.x * _height + vec.y;
-                    assert(index < (_width * _height));
+                    const u64_t index = static_cast<u64_t>(vec.x) * _height + vec.y;
+                    assert(index < static_cast<u64_t>(_width) * _height);
 
                     return _data.get()[index];
                 }
 
-                const T& operator [](const Point<u16_t, u16_t>& vec) const {
+                const T& operator [](const Point<u32_t, u32_t>& vec) const {
                     assert(vec.x < _width && vec.y < _height);
 
-                    const u32_t index = vec.x * _height + vec.y;
-                    assert(index < (_width * _height));
+                    const u64_t index = static_cast<u64_t>(vec.x) * _height + vec.y;
+                    assert(index < static_cast<u64_t>(_width) * _height);
 
                     return _data.get()[index];
                 }
 
-                T& operator()(u16_t x, u16_t y) {
-                    return (*this)[Point<u16_t, u16_t>(x, y)];
+                T& operator()(u32_t x, u32_t y) {
+                    return (*this)[Point<u32_t, u32_t>(x, y)];
                 }
 
-                const T& operator()(u16_t x, u16_t y) const {
-                    return (*this)[Point<u16_t, u16_t>(x, y)];
+                const T& operator()(u32_t x, u32_t y) const {
+                    return (*this)[Point<u32_t, u32_t>(x, y)];
                 }
 
                 T* begin() {
@@ -83,13 +83,13 @@ namespace sift {
                 }
 
                 T* end() {
-                    return &_data.get()[_width * _height];
+                    return &_data.get()[static_cast<u64_t>(_width) * _height];
                 }
 
                 friend std::ostream& operator <<(std::ostream& out, Matrix& m) {
-                    const u32_t size = m._width * m._height;
+                    const u64_t size = static_cast<u64_t>(m._width) * m._height;
 
-                    for (u32_t i = 0, x = 1; i < size; i++, x++) {
+                    for (u64_t i = 0, x = 1; i < size; i++, x++) {
                         out << m._data.get()[i] << ',';
                         if (x >= m._width) {
                             x = 0;
@@ -0,0 +1,34 @@
+#ifndef NEIGHBORHOOD_HPP
+#define NEIGHBORHOOD_HPP
+
+#include <array>
+
+#include "types.hpp"
+
+namespace sift {
+    /**
+     * The 3x3x3 DoG values around an interest point. These are the 9 pixels of its own DoG and the
+     * 9 pixels at the same place in the DoG below and above. It holds everything the derivatives of
+     * the keypoint localization need, so the DoGs themselves don't have to be kept.
+     */
+    class Neighborhood {
+        private:
+            std::array<f32_t, 27> _values;
+
+        public:
+            /**
+             * @param x the horizontal offset from -1 to 1
+             * @param y the vertical offset from -1 to 1
+             * @param s the scale offset from -1(DoG below) to 1(DoG above)
+             * @return the DoG value at the offset
+             */
+            f32_t& operator()(i16_t x, i16_t y, i16_t s) {
+                return _values[((s + 1) * 3 + y + 1) * 3 + x + 1];
+            }
+
+            const f32_t& operator()(i16_t x, i16_t y, i16_t s) const {
+                return _values[((s + 1) * 3 + y + 1) * 3 + x + 1];
+            }
+    };
+}
+#endif //NEIGHBORHOOD_HPP
@@ -0,0 +1,98 @@
+#include "output.hpp"
+
+#include <fstream>
+#include <algorithm>
+#include <stdexcept>
+
+#include <opencv/cv.hpp>
+
+#include "featurefile.hpp"
+
+namespace sift {
+    void writeText(const std::string& file, const DescriptorSet& set) {
+        std::ofstream out(file);
+        if (!out)
+            throw std::runtime_error("Can't write " + file);
+
+        out << "Location\tscale\torientation\tdescriptors\n";
+        for (u32_t i = 0; i < set.size(); i++) {
+            out << "[" << set.x[i] << ", " << set.y[i] <<  "]\t" << set.scale[i] << "\t" << set.orientation[i] << "\t" << "[";
+            const f32_t* descriptor = set.descriptor(i);
+            for (u16_t j = 0; j < alg::descriptorSize; j++) {
+                out << descriptor[j] << ", ";
+            }
+            out << "]\n";
+        }
+    }
+
+    ResultFormat resultFormat(const std::string& name) {
+        if (name == "text")
+            return ResultFormat::text;
+        if (name == "binary")
+            return ResultFormat::binary;
+        if (name == "quantized")
+            return ResultFormat::quantized;
+        throw std::invalid_argument("Unknown format " + name);
+    }
+
+    void writeResult(const std::string& file, const DescriptorSet& set, ResultFormat format) {
+        switch (format) {
+            case ResultFormat::text:
+                writeText(file + ".txt", set);
+                break;
+            case ResultFormat::binary:
+                writeFeatures(file + ".sift", set);
+                break;
+            case ResultFormat::quantized: {
+                QuantizedDescriptorSet quantized;
+                quantize(set, quantized);
+                writeFeatures(file + ".sift", quantized);
+                break;
+            }
+        }
+    }
+
+    void writeMatches(const std::string& file, const DescriptorSet& query, const DescriptorSet& train,
+            const std::vector<Match>& matches) {
+
+        std::ofstream out(file);
+        if (!out)
+            throw std::runtime_error("Can't write " + file);
+
+        out << "Query\ttrain\tdistance\n";
+        for (const Match& m : matches) {
+            out << "[" << query.x[m.query] << ", " << query.y[m.query] << "]\t[" << train.x[m.train] << ", " 
+                << train.y[m.train] << "]\t" << m.distance << "\n";
+        }
+    }
+
+    void writeOverlay(const std::string& file, const vigra::MultiArrayView<2, f32_t>& img, const DescriptorSet& set) {
+        cv::Mat grey(img.height(), img.width(), CV_8UC1);
+        const u32_t width = img.width();
+        const u32_t height = img.height();
+        for (u32_t y = 0; y < height; y++) {
+            u8_t* row = grey.ptr<u8_t>(y);
+            for (u32_t x = 0; x < width; x++) {
+                row[x] = static_cast<u8_t>(std::min(std::max(img(x, y), 0.0f), 255.0f));
+            }
+        }
+        cv::Mat image;
+        cv::cvtColor(grey, image, cv::COLOR_GRAY2BGR);
+
+        for (u32_t i = 0; i < set.size(); i++) {
+            cv::RotatedRect r(cv::Point2f(set.x[i], set.y[i]), 
+                    cv::Size(set.scale[i] * 10, set.scale[i] * 10),
+                    set.orientation[i]);
+
+            cv::Point2f points[4]; 
+            r.points( points );
+            cv::line(image, points[0], points[1], cv::Scalar(255, 0, 0));
+            cv::line(image, points[0], points[3], cv::Scalar(255, 0, 0));
+            cv::line(image, points[2], points[3], cv::Scalar(255, 0, 0));
+            cv::line(image, points[1], points[2], cv::Scalar(255, 0, 0));
+        }
+
+        if (!cv::imwrite(file, image))
+            throw std::runtime_error("Can't write " + file);
+    }
+}
@@ -0,0 +1,76 @@
+#ifndef OUTPUT_HPP
+#define OUTPUT_HPP
+
+#include <string>
+
+#include <vigra/multi_array.hxx>
+
+#include "types.hpp"
+#include "descriptorset.hpp"
+#include "matcher.hpp"
+
+namespace sift {
+    /**
+     * Writes the interest points as a table like listing. The listed data are: positions,
+     * scale, orientation and their descriptors.
+     * @param file the path of the text file
+     * @param set the interest points with their descriptors
+     */
+    void writeText(const std::string&, const DescriptorSet&);
+
+    /**
+     * The formats in which the features of an image can be written
+     */
+    enum class ResultFormat {
+        /**
+         * The table of writeText in a .txt file
+         */
+        text,
+
+        /**
+         * A binary feature file with float descriptors in a .sift file
+         */
+        binary,
+
+        /**
+         * A binary feature file with descriptors quantized to u8_t in a .sift file
+         */
+        quantized
+    };
+
+    /**
+     * @param name "text", "binary" or "quantized"
+     * @return the format of the given name
+     * @throws std::invalid_argument if there is no format of this name
+     */
+    ResultFormat resultFormat(const std::string&);
+
+    /**
+     * Writes the features in the given format
+     * @param file the path of the file without extension, which is added by the format
+     * @param set the interest points with their descriptors
+     * @param format the format of the file
+     */
+    void writeResult(const std::string&, const DescriptorSet&, ResultFormat);
+
+    /**
+     * Writes the matches of two images as a table like listing of the positions in both images
+     * and the distance of the descriptors
+     * @param file the path of the text file
+     * @param query the interest points of the first image
+     * @param train the interest points of the second image
+     * @param matches the matches of both images
+     */
+    void writeMatches(const std::string&, const DescriptorSet&, const DescriptorSet&, const std::vector<Match>&);
+
+    /**
+     * Draws every interest point as a square, which is rotated by its orientation, onto the image
+     * and writes it as png. The image is the one, which was decoded for the calculation, so it
+     * doesn't get decoded a second time.
+     * @param file the path of the png file
+     * @param img the grey value image
+     * @param set the interest points
+     */
+    void writeOverlay(const std::string&, const vigra::MultiArrayView<2, f32_t>&, const DescriptorSet&);
+}
+#endif //OUTPUT_HPP
@@ -0,0 +1,192 @@
+#include "precision.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <cstdint>
+#include <cstring>
+#include <cmath>
+#include <stdexcept>
+
+#if defined(__F16C__)
+#include <immintrin.h>
+#endif
+
+namespace sift {
+    Precision precision(const std::string& name) {
+        if (name == "f32")
+            return Precision::f32;
+        if (name == "f16")
+            return Precision::f16;
+        if (name == "u16")
+            return Precision::u16;
+        throw std::invalid_argument("Unknown precision " + name);
+    }
+
+    std::string toString(Precision precision) {
+        switch (precision) {
+            case Precision::f16:
+                return "f16";
+            case Precision::u16:
+                return "u16";
+            default:
+                return "f32";
+        }
+    }
+
+    namespace alg {
+        namespace {
+            /**
+             * The orientation of a 16 bit float, which stores the orientations above 180 minus
+             * 360, wrapped below 360 like gradientOrientation
+             */
+            f32_t unwrap(f32_t angle) {
+                const f32_t shifted = angle < 0 ? angle + 360 : angle;
+                return shifted >= 360 ? shifted - 360 : shifted;
+            }
+        }
+
+        u16_t toHalf(f32_t value) {
+            std::uint32_t bits;
+            std::memcpy(&bits, &value, sizeof(bits));
+            const std::uint32_t sign = (bits >> 16) & 0x8000;
+            const std::uint32_t abs = bits & 0x7fffffff;
+
+            //Infinity and NaN
+            if (abs >= 0x7f800000)
+                return sign | 0x7c00 | (abs > 0x7f800000 ? 0x200 : 0);
+            //Rounds to 65520 or more, which is beyond the largest 16 bit float
+            if (abs >= 0x477ff000)
+                return sign | 0x7c00;
+            //Below 2^-25, which rounds to 0
+            if (abs < 0x33000000)
+                return sign;
+
+            //Below 2^-14 the 16 bit float is subnormal and keeps the bits above 2^-24
+            if (abs < 0x38800000) {
+                const std::uint32_t shift = 126 - (abs >> 23);
+                const std::uint32_t mantissa = (abs & 0x7fffff) | 0x800000;
+                std::uint32_t half = mantissa >> shift;
+                const std::uint32_t rest = mantissa & ((1u << shift) - 1);
+                const std::uint32_t tie = 1u << (shift - 1);
+                if (rest > tie || (rest == tie && (half & 1)))
+                    half++;
+                return sign | half;
+            }
+
+            //The exponent bias of 127 becomes one of 15, the mantissa loses its 13 lowest bits.
+            //A carry of the rounding moves into the exponent, which is still correct.
+            std::uint32_t half = (abs - 0x38000000) >> 13;
+            const std::uint32_t rest = abs & 0x1fff;
+            if (rest > 0x1000 || (rest == 0x1000 && (half & 1)))
+                half++;
+            return sign | half;
+        }
+
+        f32_t fromHalf(u16_t half) {
+            const std::uint32_t sign = static_cast<std::uint32_t>(half & 0x8000) << 16;
+            const std::uint32_t exponent = (half >> 10) & 0x1f;
+            const std::uint32_t mantissa = half & 0x3ff;
+
+            if (exponent == 0) {
+                const f32_t value = std::ldexp(static_cast<f32_t>(mantissa), -24);
+                return sign ? -value : value;
+            }
+            const std::uint32_t bits = exponent == 31 ?
+                sign | 0x7f800000 | (mantissa << 13) :
+                sign | ((exponent + 112) << 23) | (mantissa << 13);
+            f32_t value;
+            std::memcpy(&value, &bits, sizeof(value));
+            return value;
+        }
+
+        void storeMagnitudes(const f32_t* in, u16_t* out, u32_t count, Precision precision) {
+            assert(precision != Precision::f32);
+            u32_t i = 0;
+            if (precision == Precision::u16) {
+                for (; i < count; i++) {
+                    out[i] = static_cast<u16_t>(std::min(in[i] * magnitudeScale + 0.5f, 65535.0f));
+                }
+                return;
+            }
+#if defined(__F16C__)
+            for (; i + 8 <= count; i += 8) {
+                const __m128i half = _mm256_cvtps_ph(_mm256_loadu_ps(in + i), _MM_FROUND_TO_NEAREST_INT);
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i), half);
+            }
+#endif
+            for (; i < count; i++) {
+                out[i] = toHalf(in[i]);
+            }
+        }
+
+        void loadMagnitudes(const u16_t* in, f32_t* out, u32_t count, Precision precision) {
+            assert(precision != Precision::f32);
+            u32_t i = 0;
+            if (precision == Precision::u16) {
+                for (; i < count; i++) {
+                    out[i] = in[i] / magnitudeScale;
+                }
+                return;
+            }
+#if defined(__F16C__)
+            for (; i + 8 <= count; i += 8) {
+                const __m128i half = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + i));
+                _mm256_storeu_ps(out + i, _mm256_cvtph_ps(half));
+            }
+#endif
+            for (; i < count; i++) {
+                out[i] = fromHalf(in[i]);
+            }
+        }
+
+        void storeOrientations(const f32_t* in, u16_t* out, u32_t count, Precision precision) {
+            assert(precision != Precision::f32);
+            u32_t i = 0;
+            if (precision == Precision::u16) {
+                for (; i < count; i++) {
+                    out[i] = static_cast<std::uint32_t>(in[i] * orientationScale + 0.5f) & 0xffff;
+                }
+                return;
+            }
+#if defined(__F16C__)
+            const __m256 straight = _mm256_set1_ps(180);
+            const __m256 full = _mm256_set1_ps(360);
+            for (; i + 8 <= count; i += 8) {
+                const __m256 angle = _mm256_loadu_ps(in + i);
+                const __m256 above = _mm256_cmp_ps(angle, straight, _CMP_GE_OQ);
+                const __m256 shifted = _mm256_blendv_ps(angle, _mm256_sub_ps(angle, full), above);
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i),
+                        _mm256_cvtps_ph(shifted, _MM_FROUND_TO_NEAREST_INT));
+            }
+#endif
+            for (; i < count; i++) {
+                out[i] = toHalf(in[i] >= 180 ? in[i] - 360 : in[i]);
+            }
+        }
+
+        void loadOrientations(const u16_t* in, f32_t* out, u32_t count, Precision precision) {
+            assert(precision != Precision::f32);
+            u32_t i = 0;
+            if (precision == Precision::u16) {
+                for (; i < count; i++) {
+                    out[i] = in[i] / orientationScale;
+                }
+                return;
+            }
+#if defined(__F16C__)
+            const __m256 zero = _mm256_setzero_ps();
+            const __m256 full = _mm256_set1_ps(360);
+            for (; i + 8 <= count; i += 8) {
+                const __m256 angle = _mm256_cvtph_ps(_mm_loadu_si128(reinterpret_cast<const __m128i*>(in + i)));
+                const __m256 negative = _mm256_cmp_ps(angle, zero, _CMP_LT_OQ);
+                const __m256 shifted = _mm256_blendv_ps(angle, _mm256_add_ps(angle, full), negative);
+                const __m256 wrapped = _mm256_cmp_ps(shifted, full, _CMP_GE_OQ);
+                _mm256_storeu_ps(out + i, _mm256_blendv_ps(shifted, _mm256_sub_ps(shifted, full), wrapped));
+            }
+#endif
+            for (; i < count; i++) {
+                out[i] = unwrap(fromHalf(in[i]));
+            }
+        }
+    }
+}
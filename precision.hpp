@@ -0,0 +1,109 @@
+#ifndef PRECISION_HPP
+#define PRECISION_HPP
+
+#include <string>
+
+#include "types.hpp"
+
+namespace sift {
+    /**
+     * How the magnitude and orientation pyramids are stored. All calculations stay in f32_t, the
+     * values are only converted when they are written to and read from the pyramids.
+     */
+    enum class Precision {
+        /**
+         * 32 bit floats, the values are stored as they are calculated
+         */
+        f32,
+
+        /**
+         * 16 bit floats with 11 significant bits, converted by F16C if the compiler targets it
+         */
+        f16,
+
+        /**
+         * 16 bit unsigned fixed point with a constant scale per pyramid. Expects grey values in
+         * [0, 255], larger magnitudes are clamped.
+         */
+        u16
+    };
+
+    /**
+     * @param name "f32", "f16" or "u16"
+     * @return the precision of the given name
+     * @throws std::invalid_argument if there is no precision of this name
+     */
+    Precision precision(const std::string&);
+
+    /**
+     * @param precision a precision
+     * @return the name of the precision
+     */
+    std::string toString(Precision);
+
+    namespace alg {
+        /**
+         * The fixed point magnitudes are multiples of 1 / magnitudeScale up to 65535 /
+         * magnitudeScale, which is above the largest magnitude of grey values in [0, 255]
+         */
+        const f32_t magnitudeScale = 128;
+
+        /**
+         * The fixed point orientations are multiples of 360 / 65536 and wrap around at 360
+         */
+        const f32_t orientationScale = 65536 / 360.0f;
+
+        /**
+         * Converts a float into a 16 bit float, rounding to the nearest even
+         * @param value the float
+         * @return the bits of the 16 bit float
+         */
+        u16_t toHalf(f32_t);
+
+        /**
+         * Converts a 16 bit float into a float
+         * @param half the bits of the 16 bit float
+         * @return the float, which has exactly the same value
+         */
+        f32_t fromHalf(u16_t);
+
+        /**
+         * Converts a row of magnitudes into 16 bit storage
+         * @param in the magnitudes
+         * @param out takes the 16 bit values
+         * @param count the count of values
+         * @param precision f16 or u16
+         */
+        void storeMagnitudes(const f32_t*, u16_t*, u32_t, Precision);
+
+        /**
+         * Converts a row of magnitudes from 16 bit storage back into floats
+         * @param in the 16 bit values
+         * @param out takes the magnitudes
+         * @param count the count of values
+         * @param precision the precision the values were stored with
+         */
+        void loadMagnitudes(const u16_t*, f32_t*, u32_t, Precision);
+
+        /**
+         * Converts a row of orientations in [0, 360) into 16 bit storage. The 16 bit floats
+         * store the orientations above 180 minus 360, so the ones just below 360 keep as many
+         * significant bits as the ones just above 0.
+         * @param in the orientations
+         * @param out takes the 16 bit values
+         * @param count the count of values
+         * @param precision f16 or u16
+         */
+        void storeOrientations(const f32_t*, u16_t*, u32_t, Precision);
+
+        /**
+         * Converts a row of orientations from 16 bit storage back into floats in [0, 360)
+         * @param in the 16 bit values
+         * @param out takes the orientations
+         * @param count the count of values
+         * @param precision the precision the values were stored with
+         */
+        void loadOrientations(const u16_t*, f32_t*, u32_t, Precision);
+    }
+}
+#endif //PRECISION_HPP
@@ -0,0 +1,122 @@
+#include "roi.hpp"
+
+#include <stdexcept>
+#include <algorithm>
+
+namespace sift {
+    namespace {
+        /**
+         * @param a the one rectangle
+         * @param b the other rectangle
+         * @return true if both rectangles share a pixel
+         */
+        bool overlaps(const Roi& a, const Roi& b) {
+            return a.x < b.x + b.width && b.x < a.x + a.width && a.y < b.y + b.height && b.y < a.y + a.height;
+        }
+
+        /**
+         * @param region a padded rectangle
+         * @return the rectangle, which is calculated
+         */
+        Roi padded(const TileRegion& region) {
+            return Roi(region.x, region.y, region.shape[0], region.shape[1]);
+        }
+
+        u64_t pixels(const TileRegion& region) {
+            return static_cast<u64_t>(region.shape[0]) * region.shape[1];
+        }
+
+        /**
+         * Keeps the interest points inside of the rectangles of a group and moves them into image
+         * coordinates
+         * @param set the interest points of the group, relative to the padded rectangle
+         * @param group the group
+         */
+        void keepRois(DescriptorSet& set, const RoiGroup& group) {
+            u32_t kept = 0;
+            for (u32_t i = 0; i < set.size(); i++) {
+                const f32_t gx = set.x[i] + group.region.x;
+                const f32_t gy = set.y[i] + group.region.y;
+                const bool inside = std::any_of(group.rois.begin(), group.rois.end(), [&](const Roi& r) {
+                            return gx >= r.x && gx < r.x + r.width && gy >= r.y && gy < r.y + r.height;
+                        });
+                if (!inside)
+                    continue;
+                set.copyTo(i, set, kept);
+                set.x[kept] = gx;
+                set.y[kept] = gy;
+                kept++;
+            }
+            set.resize(kept);
+        }
+    }
+
+    std::vector<RoiGroup> groupRois(const Sift& sift, u32_t width, u32_t height, const std::vector<Roi>& rois) {
+        const u32_t halo = sift.halo();
+        const u32_t alignment = sift.alignment();
+        auto pad = [&](const RoiGroup& g) {
+            u32_t x0 = width, y0 = height, x1 = 0, y1 = 0;
+            for (const Roi& r : g.rois) {
+                x0 = std::min(x0, r.x);
+                y0 = std::min(y0, r.y);
+                x1 = std::max(x1, r.x + r.width);
+                y1 = std::max(y1, r.y + r.height);
+            }
+            return padRegion(x0, y0, x1, y1, halo, alignment, width, height);
+        };
+
+        std::vector<RoiGroup> groups;
+        for (const Roi& roi : rois) {
+            if (roi.x >= width || roi.y >= height || roi.width == 0 || roi.height == 0)
+                throw std::invalid_argument("A region of interest has no pixel inside of the image");
+
+            RoiGroup g;
+            g.rois.emplace_back(roi.x, roi.y, std::min(roi.width, width - roi.x), std::min(roi.height, height - roi.y));
+            g.region = pad(g);
+            groups.push_back(g);
+        }
+
+        //Merging grows the padded rectangles, which can make them overlap with further groups
+        bool merged = true;
+        while (merged) {
+            merged = false;
+            for (u32_t i = 0; i < groups.size() && !merged; i++) {
+                for (u32_t j = i + 1; j < groups.size() && !merged; j++) {
+                    if (!overlaps(padded(groups[i].region), padded(groups[j].region)))
+                        continue;
+
+                    RoiGroup both = groups[i];
+                    both.rois.insert(both.rois.end(), groups[j].rois.begin(), groups[j].rois.end());
+                    both.region = pad(both);
+                    const bool shared = std::any_of(groups[i].rois.begin(), groups[i].rois.end(), [&](const Roi& a) {
+                                return std::any_of(groups[j].rois.begin(), groups[j].rois.end(),
+                                        [&](const Roi& b) { return overlaps(a, b); });
+                            });
+                    if (!shared && pixels(both.region) > pixels(groups[i].region) + pixels(groups[j].region))
+                        continue;
+
+                    groups[i] = both;
+                    groups.erase(groups.begin() + j);
+                    merged = true;
+                }
+            }
+        }
+        return groups;
+    }
+
+    std::vector<RoiGroup> calculateRois(const Sift& sift, const vigra::MultiArrayView<2, f32_t>& img,
+            const std::vector<Roi>& rois, DescriptorSet& set) {
+
+        const std::vector<RoiGroup> groups = groupRois(sift, img.shape(0), img.shape(1), rois);
+        std::vector<DescriptorSet> parts(groups.size());
+        for (u32_t g = 0; g < groups.size(); g++) {
+            const TileRegion& region = groups[g].region;
+            const vigra::Shape2 from(region.x, region.y);
+            const vigra::Shape2 to(region.x + region.shape[0], region.y + region.shape[1]);
+            sift.calculate(img.subarray(from, to), parts[g]);
+            keepRois(parts[g], groups[g]);
+        }
+        concatenate(parts, set);
+        return groups;
+    }
+}
@@ -0,0 +1,77 @@
+#ifndef ROI_HPP
+#define ROI_HPP
+
+#include <vector>
+
+#include <vigra/multi_array.hxx>
+
+#include "types.hpp"
+#include "sift.hpp"
+#include "descriptorset.hpp"
+#include "tiled.hpp"
+
+namespace sift {
+    /**
+     * A rectangle of an image, whose interest points are wanted
+     */
+    class Roi {
+        public:
+            u32_t x = 0;
+            u32_t y = 0;
+            u32_t width = 0;
+            u32_t height = 0;
+
+            Roi() = default;
+
+            Roi(u32_t x, u32_t y, u32_t width, u32_t height) : x(x), y(y), width(width), height(height) {
+            }
+    };
+
+    /**
+     * Rectangles of interest, which are calculated together on a single padded rectangle
+     */
+    class RoiGroup {
+        public:
+            /**
+             * The padded rectangle, which is calculated, and the bounding box of the rectangles
+             * of interest as its core
+             */
+            TileRegion region;
+
+            /**
+             * The rectangles of interest, whose interest points are kept
+             */
+            std::vector<Roi> rois;
+    };
+
+    /**
+     * Puts the rectangles of interest into groups, which are calculated on their own. Every
+     * rectangle gets a halo of Sift::halo, which covers the blur of all octaves and the window of
+     * a descriptor. Overlapping rectangles always share a group, so no interest point is found
+     * twice. Groups, whose padded rectangles overlap, are merged as well, as long as the padded
+     * bounding box has no more pixels than both padded rectangles on their own.
+     * @param sift the Sift object, which calculates the groups
+     * @param width the width of the image
+     * @param height the height of the image
+     * @param rois the rectangles of interest, which are clipped to the image
+     * @return the groups
+     * @throws std::invalid_argument if a rectangle has no pixel inside of the image
+     */
+    std::vector<RoiGroup> groupRois(const Sift&, u32_t, u32_t, const std::vector<Roi>&);
+
+    /**
+     * Calculates the features inside of a few rectangles of an image without the pyramids of the
+     * whole image. Every group of groupRois is calculated on its padded rectangle, so the cost
+     * grows with the area of the rectangles instead of the one of the image. The interest points
+     * are the same as the ones of the whole image inside of the rectangles, only a keypoint
+     * budget applies to every group.
+     * @param sift the Sift object, which calculates the groups
+     * @param img the whole image
+     * @param rois the rectangles of interest
+     * @param set takes the features inside of the rectangles in image coordinates, ordered by group
+     * @return the groups, which were calculated
+     */
+    std::vector<RoiGroup> calculateRois(const Sift&, const vigra::MultiArrayView<2, f32_t>&,
+            const std::vector<Roi>&, DescriptorSet&);
+}
+#endif //ROI_HPP
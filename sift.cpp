@@ -1,7 +1,11 @@
 #include "sift.hpp"
 
 #include <string>
+#include <algorithm>
 #include <cassert>
+#include <chrono>
+#include <atomic>
+#include <stdexcept>
 
 #include <vigra/impex.hxx>
 #include <vigra/multi_math.hxx>
@@ -11,39 +15,300 @@
 
 #include "point.hpp"
 #include "algorithms.hpp"
+#include "extrema.hpp"
+#include "gradient.hpp"
 
 using namespace vigra::multi_math;
 using namespace vigra::linalg;
 
 namespace sift {
-    std::vector<InterestPoint> Sift::calculate(vigra::MultiArray<2, f32_t>& img) {
-        if (subpixel)
-            img = alg::increaseToNextLevel(img, 1.0);
-
-        auto dogs = _createDOGs(img);
-        //Save DoGs for Demonstration purposes
-        //for (u16_t i = 0; i < dogs.width(); i++) {
-            //for (u16_t j = 0; j < dogs.height(); j++) {
-                //const std::string fnStr = "images/dog" + std::to_string(i) + std::to_string(j) + ".png";
-                //exportImage(dogs(i, j).img, vigra::ImageExportInfo(fnStr.c_str()));
-            //}
-        //}
+    namespace {
+        /**
+         * The count of interest points a thread handles at once in the orientation assignment
+         * and the descriptor creation
+         */
+        const u32_t keypointChunk = 64;
+
+        /**
+         * The count of grid cells the keypoint budget is spread over
+         */
+        const u32_t budgetCells = 64;
+
+        void storeDescriptor(const f32_t* row, f32_t* out) {
+            std::copy(row, row + alg::descriptorSize, out);
+        }
+
+        void storeDescriptor(const f32_t* row, u8_t* out) {
+            quantize(row, out);
+        }
+
+        typedef std::chrono::steady_clock Clock;
+
+        /**
+         * Measures the stages of a calculation one after the other into a SiftStats, if there is one
+         */
+        class StageTimer {
+            private:
+                SiftStats* const _stats;
+                const Clock::time_point _start;
+                Clock::time_point _last;
+
+            public:
+                explicit StageTimer(SiftStats* stats) : _stats(stats), _start(Clock::now()), _last(_start) {
+                }
+
+                /**
+                 * Ends a stage, which started when the stage before ended
+                 * @param field the time of the stage
+                 */
+                void stage(f64_t SiftStats::* field) {
+                    if (_stats == nullptr)
+                        return;
+                    const Clock::time_point now = Clock::now();
+                    _stats->*field = std::chrono::duration<f64_t>(now - _last).count();
+                    _last = now;
+                }
+
+                /**
+                 * Starts the next stage now without recording the time since the last one, which
+                 * was already measured in more detail
+                 */
+                void restart() {
+                    _last = Clock::now();
+                }
+
+                /**
+                 * Ends the whole calculation
+                 */
+                void total() {
+                    if (_stats != nullptr)
+                        _stats->totalSeconds = std::chrono::duration<f64_t>(Clock::now() - _start).count();
+                }
+        };
+    }
+
+    void Sift::_createKernels() {
+        assert(_octaves > 0); // pre condition
+        assert(_dogsPerEpoch >= 3); // pre condition
+
+        _kernels = Matrix<vigra::Kernel1D<f32_t>>(_octaves, _dogsPerEpoch + 1);
+        _scales = Matrix<f32_t>(_octaves, _dogsPerEpoch + 1);
+        _kernels(0, 0).initGaussian(_sigma);
+        _scales(0, 0) = _sigma;
+
+        //The kernels of the absolute mode blur every level by its own scale
+        u16_t exp = 0;
+        for (u16_t i = 0; i < _octaves; i++) {
+            f32_t carried = i == 0 ? _sigma : _sigma * std::pow(_k, _dogsPerEpoch - 1) / 2;
+            for (u16_t j = 1; j < _dogsPerEpoch + 1; j++) {
+                //The scales stay the same in the incremental mode, only the blur per level changes
+                _scales(i, j) = std::pow(_k, exp) * _sigma;
+                if (_incremental) {
+                    const f32_t target = _sigma * std::pow(_k, j);
+                    //Level 1 of a deeper octave would get no blur at all and equal level 0, which
+                    //only gives empty DoGs. The tolerance covers the rounding of k^dogsPerEpoch.
+                    if (j == 1 && carried >= target * (1 - 1e-5f)) {
+                        throw std::invalid_argument("The incremental mode needs k^(dogsPerEpoch - 2) < 2, " 
+                                "otherwise the first level of an octave isn't blurred");
+                    }
+                    _kernels(i, j).initGaussian(std::sqrt(std::max(0.0f, target * target - carried * carried)));
+                    carried = target;
+                } else {
+                    _kernels(i, j).initGaussian(_scales(i, j));
+                }
+                exp++;
+            }
+            if (i < (_octaves - 1)) {
+                _scales(i + 1, 0) = _scales(i, _dogsPerEpoch - 1);
+                exp -= 2;
+                if (_incremental) {
+                    _kernels(i + 1, 0).initGaussian(0);
+                } else {
+                    const f32_t scale = std::pow(_k, exp) * _sigma;
+                    _kernels(i + 1, 0).initGaussian(scale);
+                }
+            }
+        }
+
+        _radius = 0;
+        for (const vigra::Kernel1D<f32_t>& kernel : _kernels) {
+            _radius = std::max<u32_t>(_radius, kernel.right());
+        }
+    }
+
+    u32_t Sift::halo() const {
+        //Pixels of the input image per pixel of an octave
+        auto factor = [this](u16_t octave) {
+            return std::pow(2.0f, octave) / (subpixel ? 2 : 1);
+        };
+
+        //The bilinear doubling reads the right and lower neighbour of every pixel
+        f32_t halo = subpixel ? 1 : 0;
+        for (u16_t o = 0; o < _octaves; o++) {
+            //Every level is blurred out of the one before
+            for (u16_t i = 0; i < _dogsPerEpoch + 1; i++) {
+                halo += factor(o) * _kernels(o, i).right();
+            }
+        }
+        //The orientation and descriptor windows and the neighbours of their gradients
+        halo += factor(_octaves - 1) * (alg::descriptorWindow / 2 + 2);
+
+        const u32_t a = alignment();
+        return (static_cast<u32_t>(std::ceil(halo)) + a - 1) / a * a;
+    }
+
+    u32_t Sift::alignment() const {
+        return 1u << (_octaves - 1);
+    }
+
+    u64_t Sift::workspaceBytes(const vigra::Shape2& shape) const {
+        return SiftWorkspace::requiredBytes(shape, _octaves, _dogsPerEpoch, subpixel, _radius, _pool.size(),
+                _precision);
+    }
+
+    std::unique_ptr<SiftContext> Sift::_acquire() const {
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            if (!_contexts.empty()) {
+                std::unique_ptr<SiftContext> context = std::move(_contexts.back());
+                _contexts.pop_back();
+                return context;
+            }
+        }
+        return std::unique_ptr<SiftContext>(new SiftContext());
+    }
+
+    void Sift::_release(std::unique_ptr<SiftContext> context) const {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _contexts.emplace_back(std::move(context));
+    }
+
+    std::vector<InterestPoint> Sift::calculate(const vigra::MultiArrayView<2, f32_t>& img, SiftStats* stats) const {
+        //A context, which is lost to an exception, is simply freed
+        std::unique_ptr<SiftContext> context = _acquire();
+        std::vector<InterestPoint> interestPoints = calculate(img, *context, stats);
+        _release(std::move(context));
+        return interestPoints;
+    }
+
+    void Sift::calculate(const vigra::MultiArrayView<2, f32_t>& img, DescriptorSet& set, SiftStats* stats) const {
+        std::unique_ptr<SiftContext> context = _acquire();
+        calculate(img, set, *context, stats);
+        _release(std::move(context));
+    }
+
+    void Sift::calculate(const vigra::MultiArrayView<2, f32_t>& img, QuantizedDescriptorSet& set,
+            SiftStats* stats) const {
+
+        std::unique_ptr<SiftContext> context = _acquire();
+        calculate(img, set, *context, stats);
+        _release(std::move(context));
+    }
+
+    std::vector<InterestPoint> Sift::calculate(const vigra::MultiArrayView<2, f32_t>& img, SiftContext& context,
+            SiftStats* stats) const {
+
+        StageTimer timer(stats);
+        _buildPyramid(img, context._workspace, stats);
+        std::vector<InterestPoint> interestPoints = _detectInterestPoints(context._workspace, stats);
+        timer.restart();
+        _createDecriptors(context._workspace, interestPoints);
+        timer.stage(&SiftStats::descriptorSeconds);
+        timer.total();
+        if (stats) {
+            stats->descriptors = std::count_if(interestPoints.begin(), interestPoints.end(),
+                    [](const InterestPoint& p) { return !p.filtered; });
+        }
+        return interestPoints;
+    }
+
+    void Sift::calculate(const vigra::MultiArrayView<2, f32_t>& img, DescriptorSet& set, SiftContext& context,
+            SiftStats* stats) const {
+
+        StageTimer timer(stats);
+        build(img, context, stats);
+        describe(context, set, stats);
+        timer.total();
+    }
+
+    void Sift::calculate(const vigra::MultiArrayView<2, f32_t>& img, QuantizedDescriptorSet& set,
+            SiftContext& context, SiftStats* stats) const {
+
+        StageTimer timer(stats);
+        build(img, context, stats);
+        describe(context, set, stats);
+        timer.total();
+    }
+
+    void Sift::build(const vigra::MultiArrayView<2, f32_t>& img, SiftContext& context, SiftStats* stats) const {
+        _buildPyramid(img, context._workspace, stats);
+    }
+
+    void Sift::describe(SiftContext& context, DescriptorSet& set, SiftStats* stats) const {
+        const std::vector<InterestPoint> interestPoints = _detectInterestPoints(context._workspace, stats);
+        StageTimer timer(stats);
+        _createDescriptors(context._workspace, interestPoints, set);
+        timer.stage(&SiftStats::descriptorSeconds);
+        if (stats)
+            stats->descriptors = set.size();
+    }
+
+    void Sift::describe(SiftContext& context, QuantizedDescriptorSet& set, SiftStats* stats) const {
+        const std::vector<InterestPoint> interestPoints = _detectInterestPoints(context._workspace, stats);
+        StageTimer timer(stats);
+        _createDescriptors(context._workspace, interestPoints, set);
+        timer.stage(&SiftStats::descriptorSeconds);
+        if (stats)
+            stats->descriptors = set.size();
+    }
 
+    void Sift::_buildPyramid(const vigra::MultiArrayView<2, f32_t>& img, SiftWorkspace& workspace,
+            SiftStats* stats) const {
+
+        StageTimer timer(stats);
+        workspace.reserve(img.shape(), _octaves, _dogsPerEpoch, subpixel, _radius, _pool.size(), _precision);
+        if (stats) {
+            stats->pyramidBytes = workspace.pyramidBytes();
+            stats->gradientBytes = workspace.gradientBytes();
+            stats->workspaceBytes = workspace.usedBytes();
+            stats->allocatedBytes = workspace.allocatedBytes();
+            stats->peakBytes = workspace.bytes();
+        }
+
+        const vigra::MultiArrayView<2, f32_t> input = subpixel ? workspace.input() : img;
+        if (subpixel) {
+            alg::increaseToNextLevel(img, input, _pool);
+        }
+        timer.stage(&SiftStats::setupSeconds);
+
+        _createGaussians(input, workspace);
+        timer.stage(&SiftStats::gaussianSeconds);
+    }
+
+    std::vector<InterestPoint> Sift::_detectInterestPoints(SiftWorkspace& workspace, SiftStats* stats) const {
+        StageTimer timer(stats);
         std::vector<InterestPoint> interestPoints;
-        _findScaleSpaceExtrema(dogs, interestPoints);
-        _eliminateEdgeResponses(interestPoints, dogs);
+        std::vector<Neighborhood> neighborhoods;
+        _findScaleSpaceExtrema(workspace, interestPoints, neighborhoods);
+        timer.stage(&SiftStats::extremaSeconds);
+        const u64_t candidates = interestPoints.size();
+        _eliminateEdgeResponses(interestPoints, neighborhoods);
 
         //Cleanup
         std::sort(interestPoints.begin(), interestPoints.end(), InterestPoint::cmpByFilter);
         auto result = std::find_if(interestPoints.begin(), interestPoints.end(), 
                 [](const InterestPoint& p) { return p.filtered; });
 
-        u16_t size = std::distance(interestPoints.begin(), result);
+        u32_t size = std::distance(interestPoints.begin(), result);
         interestPoints.resize(size);
+        const u64_t afterEdges = interestPoints.size();
+        _cullKeypoints(interestPoints, workspace.gaussians(0, 0).img.shape());
+        timer.stage(&SiftStats::edgeSeconds);
+        const u64_t afterBudget = interestPoints.size();
 
-        _createMagnitudePyramid();
-        _createOrientationPyramid();
-        _orientationAssignment(interestPoints);
+        _createGradients(workspace, interestPoints);
+        timer.stage(&SiftStats::gradientSeconds);
+        _orientationAssignment(workspace, interestPoints);
 
         //Cleanup
         std::sort(interestPoints.begin(), interestPoints.end(), InterestPoint::cmpByFilter);
@@ -52,162 +317,210 @@ namespace sift {
 
         size = std::distance(interestPoints.begin(), result);
         interestPoints.resize(size);
-        _createDecriptors(interestPoints);
+        timer.stage(&SiftStats::orientationSeconds);
+
+        if (stats) {
+            stats->candidates = candidates;
+            stats->afterEdges = afterEdges;
+            stats->afterBudget = afterBudget;
+            stats->afterOrientation = interestPoints.size();
+        }
         return interestPoints;
     }
 
 
-    void Sift::_createDecriptors(std::vector<InterestPoint>& interestPoints) {
-        const u16_t region = 8;
-        for (InterestPoint& p: interestPoints) {
-            Point<u16_t, u16_t> current_point = _findNearestGaussian(p.scale);
-            const vigra::MultiArray<2, f32_t>& current = _gaussians(current_point.x, current_point.y).img;
-            if (p.loc.x < region || p.loc.x > current.width() - region ||
-                    p.loc.y < region || p.loc.y > current.height() - region) {
+    void Sift::_createDecriptors(const SiftWorkspace& workspace, std::vector<InterestPoint>& interestPoints) const {
+        const u32_t chunks = (interestPoints.size() + keypointChunk - 1) / keypointChunk;
+        _pool.parallelFor(0, chunks, [&](u32_t c) {
+            const u32_t end = std::min<u32_t>(interestPoints.size(), (c + 1) * keypointChunk);
+            for (u32_t i = c * keypointChunk; i < end; i++) {
+                InterestPoint& p = interestPoints[i];
+                p.descriptors.resize(alg::descriptorSize);
+                if (!_createDescriptor(workspace, p, &p.descriptors[0])) {
+                    p.filtered = true;
+                    p.descriptors.clear();
+                }
+            }
+        });
+    }
 
-                p.filtered = true;
-                continue;
+    template <typename T>
+    void Sift::_createDescriptors(const SiftWorkspace& workspace, const std::vector<InterestPoint>& interestPoints,
+            BasicDescriptorSet<T>& set) const {
+
+        set.resize(interestPoints.size());
+        std::vector<u8_t> created(interestPoints.size());
+        const f32_t subpixel_divisor = subpixel ? 2 : 1;
+
+        const u32_t chunks = (interestPoints.size() + keypointChunk - 1) / keypointChunk;
+        _pool.parallelFor(0, chunks, [&](u32_t c) {
+            f32_t row[alg::descriptorSize];
+            const u32_t end = std::min<u32_t>(interestPoints.size(), (c + 1) * keypointChunk);
+            for (u32_t i = c * keypointChunk; i < end; i++) {
+                const InterestPoint& p = interestPoints[i];
+                created[i] = _createDescriptor(workspace, p, row);
+                //The row is only written for a created descriptor and the point gets dropped anyway
+                if (!created[i])
+                    continue;
+                set.x[i] = p.loc.x * std::pow(2, p.octave) / subpixel_divisor;
+                set.y[i] = p.loc.y * std::pow(2, p.octave) / subpixel_divisor;
+                set.scale[i] = p.scale;
+                set.orientation[i] = p.orientation;
+                set.octave[i] = p.octave;
+                storeDescriptor(row, set.descriptor(i));
             }
+        });
 
-            auto leftUpCorner = vigra::Shape2(p.loc.x - region, p.loc.y - region);
-            auto rightDownCorner = vigra::Shape2(p.loc.x + region, p.loc.y + region);
-            auto orientations = _orientations(current_point.x, current_point.y).subarray(leftUpCorner, rightDownCorner);
-            auto magnitudes = _magnitudes(current_point.x, current_point.y).subarray(leftUpCorner, rightDownCorner);
-            auto gauss = _gaussians(current_point.x, current_point.y).img.subarray(leftUpCorner, rightDownCorner);
+        //Interest points whose window doesn't fit are dropped, the order of the others stays
+        u32_t kept = 0;
+        for (u32_t i = 0; i < interestPoints.size(); i++) {
+            if (!created[i])
+                continue;
+            set.copyTo(i, set, kept++);
+        }
+        set.resize(kept);
+    }
 
+    bool Sift::_createDescriptor(const SiftWorkspace& workspace, const InterestPoint& p, f32_t* out) const {
+        const u16_t region = alg::descriptorWindow / 2;
+        Point<u16_t, u16_t> current_point = _findNearestGaussian(p.scale);
+        const vigra::MultiArrayView<2, f32_t>& current = workspace.gaussians(current_point.x, current_point.y).img;
+        const u32_t width = current.width();
+        const u32_t height = current.height();
+        if (p.loc.x < region || p.loc.x + region > width || p.loc.y < region || p.loc.y + region > height) {
 
-            //Rotate orientations relative to keypoint orientation
-            for (u16_t x = 0; x < orientations.width(); x++) {
-                for (u16_t y = 0; y < orientations.height(); y++) {
-                    orientations(x, y) += p.orientation;
-                }
-            }
+            return false;
+        }
 
-            //weight magnitudes by a gauss which is half the descriptor window size
-            auto weighting = alg::convolveWithGauss(current, 1.6);
-            for (u16_t x = 0; x < magnitudes.width(); x++) {
-                for (u16_t y = 0; y < magnitudes.height(); y++) {
-                    magnitudes(x, y) += weighting(x, y);
-                }
-            }
-            std::vector<f32_t> descriptors;
-            //Create histograms of the 4x4 regions of the descriptor window
-            for (u16_t x = 0; x < gauss.width(); x += 4) {
-                for (u16_t y = 0; y < gauss.height(); y += 4) {
-                    auto lu = vigra::Shape2(x, y);
-                    auto rb = vigra::Shape2(x + 4, y + 4);
-                    auto cur_orientations = orientations.subarray(lu, rb);
-                    auto cur_magnitudes = magnitudes.subarray(lu, rb);
-                    auto cur_gauss = gauss.subarray(lu, rb);
-                    std::vector<f32_t> result = alg::orientationHistogram8(cur_orientations, cur_magnitudes, cur_gauss);
-                    _eliminateVectorThreshold(result);
-                    
-                    descriptors.insert(descriptors.end(), result.begin(), result.end());
-                }
-            }
-            p.descriptors = descriptors;
-        } 
-    }
+        auto leftUpCorner = vigra::Shape2(p.loc.x - region, p.loc.y - region);
+        auto rightDownCorner = vigra::Shape2(p.loc.x + region, p.loc.y + region);
+        std::array<f32_t, alg::descriptorWindow * alg::descriptorWindow> orientationBuffer, magnitudeBuffer;
+        auto orientations = workspace.orientationWindow(current_point.x, current_point.y, leftUpCorner, rightDownCorner,
+                orientationBuffer.data());
+        auto magnitudes = workspace.magnitudeWindow(current_point.x, current_point.y, leftUpCorner, rightDownCorner,
+                magnitudeBuffer.data());
 
+        alg::descriptor(magnitudes, orientations, p.orientation, _descriptorWeights, out);
+        return true;
+    }
 
-    std::vector<f32_t> Sift::_eliminateVectorThreshold(std::vector<f32_t>& vec) const {
-        alg::normalizeVector(vec);
-        std::vector<f32_t> result;
-        result.reserve(vec.size());
-        bool threshold = false;
-        for (auto& elem : vec) {
-            if (elem <= 0.2) {
-                result.emplace_back(elem);
-            } else {
-                threshold = true;
+    void Sift::_createGradients(SiftWorkspace& workspace, const std::vector<InterestPoint>& interestPoints) const {
+        const u16_t region = 8;
+        const u32_t tile = 32;
+        const Matrix<OctaveElem>& gaussians = workspace.gaussians;
+
+        //Mark the tiles of every level, which the regions of the interest points overlap
+        Matrix<std::vector<bool>> marked(gaussians.width(), gaussians.height());
+        for (u16_t o = 0; o < gaussians.width(); o++) {
+            for (u16_t i = 0; i < gaussians.height(); i++) {
+                const vigra::MultiArrayView<2, f32_t>& img = gaussians(o, i).img;
+                marked(o, i).assign(((img.width() + tile - 1) / tile) * ((img.height() + tile - 1) / tile), false);
             }
         }
-        if (threshold)
-            alg::normalizeVector(result);
-        return result;
-    }
 
-    void Sift::_createMagnitudePyramid() {
-        _magnitudes = Matrix<vigra::MultiArray<2, f32_t>>(_gaussians.width(), _gaussians.height());
-        for (u16_t o = 0; o < _gaussians.width(); o++) {
-            for (u16_t i = 0; i < _gaussians.height(); i++) {
-                const vigra::MultiArray<2, f32_t>& current_gauss = _gaussians(o, i).img;
-                _magnitudes(o, i) = vigra::MultiArray<2, f32_t>(current_gauss.shape());
-                vigra::MultiArray<2, f32_t>& current_mag = _magnitudes(o, i);
-                for (u16_t x = 1; x < _gaussians(o, i).img.width() - 1; x++) {
-                    for (u16_t y = 1; y < _gaussians(o, i).img.height() - 1; y++) {
-                        current_mag(x, y) = alg::gradientMagnitude(current_gauss, Point<u16_t, u16_t>(x, y));
+        std::vector<std::array<u32_t, 4>> tiles;
+        for (const InterestPoint& p : interestPoints) {
+            const Point<u16_t, u16_t> nearest = _findNearestGaussian(p.scale);
+            const vigra::MultiArrayView<2, f32_t>& img = gaussians(nearest.x, nearest.y).img;
+            const u32_t columns = (img.width() + tile - 1) / tile;
+            const u32_t left = (p.loc.x > region ? p.loc.x - region : 0) / tile;
+            const u32_t top = (p.loc.y > region ? p.loc.y - region : 0) / tile;
+            const u32_t right = std::min<u32_t>(p.loc.x + region, img.width() - 1) / tile;
+            const u32_t bottom = std::min<u32_t>(p.loc.y + region, img.height() - 1) / tile;
+            for (u32_t ty = top; ty <= bottom; ty++) {
+                for (u32_t tx = left; tx <= right; tx++) {
+                    std::vector<bool>::reference seen = marked(nearest.x, nearest.y)[ty * columns + tx];
+                    if (!seen) {
+                        seen = true;
+                        tiles.push_back({{nearest.x, nearest.y, tx * tile, ty * tile}});
                     }
                 }
             }
         }
+
+        _pool.parallelFor(0, tiles.size(), [&](u32_t t) {
+            const std::array<u32_t, 4>& current = tiles[t];
+            if (_precision == Precision::f32) {
+                alg::gradients(gaussians(current[0], current[1]).img, workspace.magnitudes(current[0], current[1]),
+                        workspace.orientations(current[0], current[1]), current[2], current[3],
+                        current[2] + tile, current[3] + tile);
+            } else {
+                alg::gradients(gaussians(current[0], current[1]).img,
+                        workspace.packedMagnitudes(current[0], current[1]),
+                        workspace.packedOrientations(current[0], current[1]), _precision, current[2], current[3],
+                        current[2] + tile, current[3] + tile);
+            }
+        });
     }
 
-    void Sift::_createOrientationPyramid() {
-        _orientations = Matrix<vigra::MultiArray<2, f32_t>>(_gaussians.width(), _gaussians.height());
-        for (u16_t o = 0; o < _gaussians.width(); o++) {
-            for (u16_t i = 0; i < _gaussians.height(); i++) {
-                const vigra::MultiArray<2, f32_t>& current_gauss = _gaussians(o, i).img;
-                _orientations(o, i) = vigra::MultiArray<2, f32_t>(current_gauss.shape());
-                vigra::MultiArray<2, f32_t>& current_orientation = _orientations(o, i);
-                for (u16_t x = 1; x < _gaussians(o, i).img.width() - 1; x++) {
-                    for (u16_t y = 1; y < _gaussians(o, i).img.height() - 1; y++) {
-                        current_orientation(x, y) = alg::gradientOrientation(current_gauss, Point<u16_t, u16_t>(x, y));
-                    }
-                }
+    void Sift::_orientationAssignment(const SiftWorkspace& workspace, std::vector<InterestPoint>& interestPoints) const {
+        //In case an interest point has more than one orientation, the additional will be saved 
+        //per chunk and appended in the order of the chunks at the end of the function
+        const u32_t chunks = (interestPoints.size() + keypointChunk - 1) / keypointChunk;
+        std::vector<std::vector<InterestPoint>> additional(chunks);
+        _pool.parallelFor(0, chunks, [&](u32_t c) {
+            const u32_t end = std::min<u32_t>(interestPoints.size(), (c + 1) * keypointChunk);
+            for (u32_t i = c * keypointChunk; i < end; i++) {
+                _assignOrientation(workspace, interestPoints[i], additional[c]);
             }
+        });
+        //The keypoint budget bounds the additional orientations as well. Points, which were
+        //filtered at the border, are dropped afterwards and don't count against it.
+        u64_t kept = std::count_if(interestPoints.begin(), interestPoints.end(),
+                [](const InterestPoint& p) { return !p.filtered; });
+        for (const std::vector<InterestPoint>& chunk : additional) {
+            u64_t count = chunk.size();
+            if (_maxKeypoints > 0)
+                count = std::min<u64_t>(count, _maxKeypoints - std::min<u64_t>(_maxKeypoints, kept));
+            interestPoints.insert(interestPoints.end(), chunk.begin(), chunk.begin() + count);
+            kept += count;
         }
     }
 
+    void Sift::_assignOrientation(const SiftWorkspace& workspace, InterestPoint& p,
+            std::vector<InterestPoint>& additional) const {
 
-    void Sift::_orientationAssignment(std::vector<InterestPoint>& interestPoints) {
         const u16_t region = 8;
-        //In case an interest point has more than one orientation, the additional will be saved here
-        //and appended at the end of the function
-        std::vector<InterestPoint> additional;
-        for (InterestPoint& p : interestPoints) {
-            const Point<u16_t, u16_t> closest_point = _findNearestGaussian(p.scale);
-            const vigra::MultiArray<2, f32_t>& closest = _gaussians(closest_point.x, closest_point.y).img;
+        const Point<u16_t, u16_t> closest_point = _findNearestGaussian(p.scale);
+        const vigra::MultiArrayView<2, f32_t>& closest = workspace.gaussians(closest_point.x, closest_point.y).img;
 
-            //Is Keypoint inside image boundaries of gaussian
-            if ((p.loc.x < region || p.loc.x >= closest.width() - region) ||
-                    (p.loc.y < region || p.loc.y >= closest.height() - region)) {
+        //Is Keypoint inside image boundaries of gaussian
+        const u32_t width = closest.width();
+        const u32_t height = closest.height();
+        if ((p.loc.x < region || p.loc.x + region >= width) || (p.loc.y < region || p.loc.y + region >= height)) {
 
-                p.filtered = true;
-                continue;
-            }
-            const auto topLeftCorner = vigra::Shape2(p.loc.x - region, p.loc.y - region);
-            const auto bottomRightCorner = vigra::Shape2(p.loc.x + region, p.loc.y + region);
-            const auto gauss_region = closest.subarray(topLeftCorner, bottomRightCorner);
-
-
-            const vigra::MultiArray<2, f32_t> gauss_convolved = alg::convolveWithGauss(gauss_region, 1.5 * p.scale);
-            const vigra::MultiArray<2, f32_t> orientation = _orientations(closest_point.x, closest_point.y).
-                subarray(topLeftCorner, bottomRightCorner);
-
-            const vigra::MultiArray<2,f32_t> magnitude = _magnitudes(closest_point.x, closest_point.y).
-                subarray(topLeftCorner, bottomRightCorner);
-
-            const std::array<f32_t, 36> histogram = alg::orientationHistogram36(orientation, magnitude, gauss_region);
-            const std::set<f32_t> peaks = _findPeaks(histogram);
-            p.orientation = *(peaks.begin());
-            if (peaks.size() > 1) {
-                for (auto iter = peaks.begin()++; iter != peaks.end(); iter++) {
-                    InterestPoint temp = p;
-                    temp.orientation = *iter;
-                    additional.emplace_back(temp);
-                }
+            p.filtered = true;
+            return;
+        }
+        const auto topLeftCorner = vigra::Shape2(p.loc.x - region, p.loc.y - region);
+        const auto bottomRightCorner = vigra::Shape2(p.loc.x + region, p.loc.y + region);
+        const auto gauss_region = closest.subarray(topLeftCorner, bottomRightCorner);
+
+        std::array<f32_t, 4 * region * region> orientationBuffer, magnitudeBuffer;
+        const vigra::MultiArrayView<2, f32_t> orientation = workspace.orientationWindow(closest_point.x, closest_point.y,
+                topLeftCorner, bottomRightCorner, orientationBuffer.data());
+
+        const vigra::MultiArrayView<2,f32_t> magnitude = workspace.magnitudeWindow(closest_point.x, closest_point.y,
+                topLeftCorner, bottomRightCorner, magnitudeBuffer.data());
+
+        const std::array<f32_t, 36> histogram = alg::orientationHistogram36(orientation, magnitude, gauss_region);
+        const std::set<f32_t> peaks = _findPeaks(histogram);
+        p.orientation = *(peaks.begin());
+        if (peaks.size() > 1) {
+            for (auto iter = peaks.begin()++; iter != peaks.end(); iter++) {
+                InterestPoint temp = p;
+                temp.orientation = *iter;
+                additional.emplace_back(temp);
             }
         }
-        interestPoints.insert(interestPoints.end(), additional.begin(), additional.end());
     }
 
-    const Point<u16_t, u16_t>Sift::_findNearestGaussian(f32_t scale) {
+    const Point<u16_t, u16_t>Sift::_findNearestGaussian(f32_t scale) const {
         f32_t lowest_diff = 100;
         Point<u16_t, u16_t> nearest_gauss = Point<u16_t, u16_t>(0, 0);
-        for (u16_t o = 0; o < _gaussians.width(); o++) {
-            for (u16_t i = 0; i < _gaussians.height(); i++) {
-                const f32_t cur_scale = std::abs(_gaussians(o, i).scale - scale);
+        for (u16_t o = 0; o < _scales.width(); o++) {
+            for (u16_t i = 0; i < _scales.height(); i++) {
+                const f32_t cur_scale = std::abs(_scales(o, i) - scale);
                 if (cur_scale < lowest_diff) {
                     lowest_diff = cur_scale;
                     nearest_gauss = Point<u16_t, u16_t>(o, i);
@@ -286,19 +599,21 @@ namespace sift {
     }
 
     void Sift::_eliminateEdgeResponses(std::vector<InterestPoint>& interestPoints, 
-            const Matrix<OctaveElem>& dogs) const {
+            const std::vector<Neighborhood>& neighborhoods) const {
+
+        assert(interestPoints.size() == neighborhoods.size());
 
         vigra::MultiArray<2, f32_t> extremum(vigra::Shape2(3, 1));
         vigra::MultiArray<2, f32_t> inverse_matrix(vigra::Shape2(3, 3));
 
         const f32_t t = std::pow(10 + 1, 2) / 10;
-        for (InterestPoint& p : interestPoints) {
-            auto& d = dogs(p.octave, p.index);
-            const std::array<vigra::MultiArray<2, f32_t>, 3>& param = 
-            {{dogs(p.octave, p.index - 1).img, dogs(p.octave, p.index).img, dogs(p.octave, p.index + 1).img}};
+        for (u32_t i = 0; i < interestPoints.size(); i++) {
+            InterestPoint& p = interestPoints[i];
+            const Neighborhood& n = neighborhoods[i];
+            p.response = std::abs(n(0, 0, 0) - 128);
 
-            const vigra::Matrix<f32_t> deriv = alg::foDerivative(param, p.loc);
-            const vigra::Matrix<f32_t> sec_deriv = alg::soDerivative(param, p.loc);
+            const vigra::Matrix<f32_t> deriv = alg::foDerivative(n);
+            const vigra::Matrix<f32_t> sec_deriv = alg::soDerivative(n);
 
             vigra::Matrix<f32_t> neg_sec_deriv = sec_deriv ;
             neg_sec_deriv *=  -1;
@@ -320,7 +635,7 @@ namespace sift {
             } 
             const vigra::Matrix<f32_t> deriv_transpose = deriv.transpose();
             f32_t func_val_extremum = dot(deriv_transpose, extremum);
-            func_val_extremum *= 0.5 + d.img(p.loc.x, p.loc.y);
+            func_val_extremum *= 0.5 + n(0, 0, 0);
 
             //Calculated up from 0.03 of paper to own image values[0, 255]
             if (func_val_extremum < 7.65) {
@@ -345,74 +660,146 @@ namespace sift {
         }
     }
 
-    void Sift::_findScaleSpaceExtrema(const Matrix<OctaveElem>& dogs, 
-            std::vector<InterestPoint>& interestPoints) const {
-
-        //A matrix of matrix. Outer dogs will be ignored, because we need a upper and lower neighbor
-        for (u16_t e = 0; e < dogs.width(); e++) {
-            for (u16_t i = 1; i < dogs.height() - 1; i++) {
-                for (i16_t x = 1; x < dogs(e, i).img.width() - 1; x++) {
-                    for (i16_t y = 1; y < dogs(e, i).img.height() - 1; y++) {
-                        auto leftUpCorner = vigra::Shape2(x - 1, y - 1);
-                        auto rightDownCorner = vigra::Shape2(x + 1, y + 1);
-
-                        //Get the neighborhood of the current pixel
-                        auto current = dogs(e, i).img.subarray(leftUpCorner, rightDownCorner);
-                        //Get neighborhood of adjacent DOGs
-                        auto under = dogs(e, i - 1).img.subarray(leftUpCorner, rightDownCorner);
-                        auto above = dogs(e, i + 1).img.subarray(leftUpCorner, rightDownCorner);
-                        //Check all neighborhood pixels of current and adjacent DOGs. If there isn't any
-                        //pixel bigger or smaller than the current, we found an extremum.
-                        if ((!any(current > dogs(e, i).img(x, y)) &&
-                                    !any(under > dogs(e, i).img(x, y)) &&
-                                    !any(above > dogs(e, i).img(x, y))) ||
-                                (!any(current < dogs(e, i).img(x, y)) &&
-                                 !any(under < dogs(e, i).img(x, y)) &&
-                                 !any(above < dogs(e, i).img(x, y))))
-                        {
-                            interestPoints.emplace_back(InterestPoint(Point<u16_t, u16_t>(x, y), dogs(e, i).scale, e, i));
-                        }
-                    }
-                }
+    void Sift::_cullKeypoints(std::vector<InterestPoint>& interestPoints, const vigra::Shape2& shape) const {
+        if (_maxKeypoints == 0 || interestPoints.size() <= _maxKeypoints)
+            return;
+
+        //About square cells, but never more cells than interest points to keep
+        const u32_t cells = std::min(budgetCells, _maxKeypoints);
+        const u32_t columns = std::max<u32_t>(1, std::min<u32_t>(cells,
+                    std::lround(std::sqrt(static_cast<f64_t>(cells) * shape[0] / shape[1]))));
+        const u32_t rows = std::max<u32_t>(1, cells / columns);
+        const u32_t share = _maxKeypoints / (columns * rows);
+
+        //The stronger response first, the index breaks ties, so the selection is unique
+        auto stronger = [&interestPoints](u32_t a, u32_t b) {
+            const f32_t ra = interestPoints[a].response;
+            const f32_t rb = interestPoints[b].response;
+            return ra > rb || (ra == rb && a < b);
+        };
+
+        std::vector<std::vector<u32_t>> grid(columns * rows);
+        for (u32_t i = 0; i < interestPoints.size(); i++) {
+            const InterestPoint& p = interestPoints[i];
+            const u64_t x = static_cast<u64_t>(p.loc.x) << p.octave;
+            const u64_t y = static_cast<u64_t>(p.loc.y) << p.octave;
+            const u32_t cx = std::min<u64_t>(columns - 1, x * columns / shape[0]);
+            const u32_t cy = std::min<u64_t>(rows - 1, y * rows / shape[1]);
+            grid[cy * columns + cx].push_back(i);
+        }
+
+        std::vector<u8_t> keep(interestPoints.size(), 0);
+        std::vector<u32_t> rest;
+        u32_t kept = 0;
+        for (std::vector<u32_t>& cell : grid) {
+            if (cell.size() > share) {
+                std::nth_element(cell.begin(), cell.begin() + share, cell.end(), stronger);
+                rest.insert(rest.end(), cell.begin() + share, cell.end());
+                cell.resize(share);
+            }
+            for (u32_t i : cell) {
+                keep[i] = 1;
+            }
+            kept += cell.size();
+        }
+
+        //The budget the sparse cells left goes to the strongest of the rest
+        const u32_t left = _maxKeypoints - kept;
+        if (left < rest.size()) {
+            std::nth_element(rest.begin(), rest.begin() + left, rest.end(), stronger);
+            rest.resize(left);
+        }
+        for (u32_t i : rest) {
+            keep[i] = 1;
+        }
+
+        u32_t size = 0;
+        for (u32_t i = 0; i < interestPoints.size(); i++) {
+            if (!keep[i])
+                continue;
+            if (size != i)
+                interestPoints[size] = std::move(interestPoints[i]);
+            size++;
+        }
+        interestPoints.resize(size);
+    }
+
+    void Sift::_findScaleSpaceExtrema(SiftWorkspace& workspace, std::vector<InterestPoint>& interestPoints,
+            std::vector<Neighborhood>& neighborhoods) const {
+
+        const Matrix<OctaveElem>& gaussians = workspace.gaussians;
+
+        //Some bands per thread, so threads which finish early can take another one
+        const u32_t minRows = 16;
+        std::vector<std::vector<vigra::MultiArrayView<2, f32_t>>> octaves(_octaves);
+        std::vector<std::array<u32_t, 3>> bands;
+        for (u16_t o = 0; o < _octaves; o++) {
+            for (u16_t i = 0; i < _dogsPerEpoch + 1; i++) {
+                octaves[o].emplace_back(gaussians(o, i).img);
+            }
+            const u32_t rows = gaussians(o, 0).img.height();
+            const u32_t count = std::max<u32_t>(1, std::min<u32_t>(_pool.size() * 4, rows / minRows));
+            for (u32_t b = 0; b < count; b++) {
+                bands.push_back({{o, rows * b / count, rows * (b + 1) / count}});
+            }
+        }
+
+        //Every thread takes bands until none is left and owns a part of the scratch memory for
+        //the ring buffer
+        std::vector<std::vector<alg::Extremum>> found(bands.size());
+        const u32_t ring = alg::findExtremaScratch(gaussians(0, 0).img.width(), _dogsPerEpoch);
+        std::atomic<u32_t> next(0);
+        _pool.parallelFor(0, _pool.size(), [&](u32_t t) {
+            for (u32_t b = next++; b < bands.size(); b = next++) {
+                alg::findExtrema(octaves[bands[b][0]], bands[b][1], bands[b][2], _contrast, found[b],
+                        workspace.scratch() + t * ring);
+            }
+        });
+
+        u32_t b = 0;
+        for (u16_t o = 0; o < _octaves; o++) {
+            std::vector<alg::Extremum> extrema;
+            for (; b < bands.size() && bands[b][0] == o; b++) {
+                extrema.insert(extrema.end(), found[b].begin(), found[b].end());
+            }
+            std::sort(extrema.begin(), extrema.end(), [](const alg::Extremum& l, const alg::Extremum& r) {
+                if (l.index != r.index)
+                    return l.index < r.index;
+                if (l.loc.x != r.loc.x)
+                    return l.loc.x < r.loc.x;
+                return l.loc.y < r.loc.y;
+            });
+
+            for (const alg::Extremum& e : extrema) {
+                const f32_t scale = _scales(o, e.index + 1) - _scales(o, e.index);
+                interestPoints.emplace_back(InterestPoint(e.loc, scale, o, e.index));
+                neighborhoods.emplace_back(e.neighborhood);
             }
         }
     }
 
-    const Matrix<OctaveElem> Sift::_createDOGs(vigra::MultiArray<2, f32_t>& img) {
+    void Sift::_createGaussians(const vigra::MultiArrayView<2, f32_t>& img, SiftWorkspace& workspace) const {
         assert(_octaves > 0); // pre condition
         assert(_dogsPerEpoch >= 3); // pre condition
 
-        Matrix<OctaveElem> gaussians(_octaves, _dogsPerEpoch + 1);
-        Matrix<OctaveElem> dogs(_octaves, _dogsPerEpoch);
+        Matrix<OctaveElem>& gaussians = workspace.gaussians;
+        f32_t* scratch = workspace.scratch();
 
-        gaussians(0, 0).scale = _sigma;
-        gaussians(0, 0).img = alg::convolveWithGauss(img, _sigma);
+        gaussians(0, 0).scale = _scales(0, 0);
+        alg::convolveWithGauss(img, gaussians(0, 0).img, _kernels(0, 0), _pool, scratch);
 
-        //TODO: More elegant way?
-        u16_t exp = 0;
         for (i16_t i = 0; i < _octaves; i++) {
             for (i16_t j = 1; j < _dogsPerEpoch + 1; j++) {
-                f32_t scale = std::pow(_k, exp) * _sigma;
-                gaussians(i, j).scale = scale;
-                gaussians(i, j).img = alg::convolveWithGauss(gaussians(i, j - 1).img, scale);
-
-                dogs(i, j - 1).scale = gaussians(i, j).scale - gaussians(i, j - 1).scale;
-                dogs(i, j - 1).img = alg::dog(gaussians(i, j - 1).img, gaussians(i, j).img);
-                exp++;
+                gaussians(i, j).scale = _scales(i, j);
+                alg::convolveWithGauss(gaussians(i, j - 1).img, gaussians(i, j).img, _kernels(i, j), _pool, scratch);
             }
             // If we aren't in the last octave populate the next level with the second
             // last element, scaled by a half, of the image size of current octave.
             if (i < (_octaves - 1)) {
-                auto scaledElem = alg::reduceToNextLevel(gaussians(i, _dogsPerEpoch - 1).img, 
-                        gaussians(i, _dogsPerEpoch - 1).scale);
-                gaussians(i + 1, 0).scale = gaussians(i, _dogsPerEpoch - 1).scale;
-                gaussians(i + 1, 0).img = scaledElem;
-
-                exp -= 2;
+                const vigra::MultiArrayView<2, f32_t>& current = gaussians(i, _dogsPerEpoch - 1).img;
+                alg::reduceToNextLevel(current, gaussians(i + 1, 0).img, _kernels(i + 1, 0), _pool, scratch);
+                gaussians(i + 1, 0).scale = _scales(i + 1, 0);
             }
         }
-
-        _gaussians = gaussians;
-        return dogs; // TODO: by ref entgegen nehmen um copy zu vermeiden?
     }
 }
@@ -4,17 +4,38 @@
 #include <cmath>
 #include <array>
 #include <vector>
+#include <memory>
+#include <mutex>
 
 #include <vigra/multi_array.hxx>
 #include <vigra/matrix.hxx>
+#include <vigra/convolution.hxx>
 
 #include "types.hpp"
 #include "matrix.hpp"
 #include "octaveelem.hpp"
 #include "interestpoint.hpp"
+#include "neighborhood.hpp"
+#include "threadpool.hpp"
+#include "workspace.hpp"
+#include "siftcontext.hpp"
+#include "descriptor.hpp"
+#include "descriptorset.hpp"
+#include "siftstats.hpp"
+#include "precision.hpp"
 
 namespace sift {
+    /**
+     * The configuration of a Sift calculation with the tables, which are built out of it once. All
+     * state of a calculation lives in a SiftContext, so one Sift object can be used by several
+     * threads at the same time.
+     */
     class Sift {
+            /**
+             * Times the single stages of the calculation in the benchmark suite
+             */
+            friend class SiftBench;
+
         public:
             /**
              * Wether to process the algorithm based on subpixel basis or not
@@ -41,19 +62,69 @@ namespace sift {
             const u16_t _octaves;
 
             /**
-             * The Gaussians calculated during the algorithm.
+             * Wether every Gaussian is blurred by the incremental sigma between itself and the
+             * Gaussian below, instead of the absolute scale of the level.
+             */
+            const bool _incremental;
+
+            /**
+             * The smallest |DoG - 128| of a scale space extremum. Pixels below are rejected before
+             * their neighbours are compared and long before the Taylor expansion. Lowe suggests
+             * half of the final contrast threshold per DoG, here 0.5 * 7.65 / dogsPerEpoch.
+             */
+            const f32_t _contrast;
+
+            /**
+             * How the magnitude and orientation pyramids are stored. They are the only pyramids
+             * besides the Gaussians and are only read through the small windows of the orientation
+             * assignment and the descriptors, so 16 bit storage halves two thirds of the pyramid
+             * memory, while the extrema are still searched in f32_t Gaussians.
+             */
+            const Precision _precision;
+
+            /**
+             * The most interest points, which are carried into the orientation assignment and the
+             * descriptors. 0 keeps all.
              */
-            Matrix<OctaveElem> _gaussians;
+            const u32_t _maxKeypoints;
 
             /**
-             * The magnitudes of the gaussians
+             * The Gaussian kernels of the scale space. They are built once for the configuration
+             * and have the same layout as the Gaussians. The kernel of (0, 0) blurs the input image,
+             * the other kernels of the first row blur the level before the next octave is sampled
+             * down.
              */
-            Matrix<vigra::MultiArray<2, f32_t>> _magnitudes;
+            Matrix<vigra::Kernel1D<f32_t>> _kernels;
 
             /**
-             * The orientations of the gaussians
+             * The scales of the Gaussians in the same layout as the kernels.
              */
-            Matrix<vigra::MultiArray<2, f32_t>> _orientations;
+            Matrix<f32_t> _scales;
+
+            /**
+             * The radius of the largest kernel.
+             */
+            u32_t _radius = 0;
+
+            /**
+             * The Gaussian weights of the descriptor window with a sigma of half the window size.
+             */
+            const alg::DescriptorWeights _descriptorWeights;
+
+            /**
+             * The threads which share the work of the scale space construction. Every parallelFor
+             * keeps its own state, so calculations of several threads can share the pool.
+             */
+            mutable ThreadPool _pool;
+
+            /**
+             * The contexts of the calculations without an own context, which are idle right now.
+             * Every such calculation takes one or creates a new one and puts it back afterwards,
+             * so there are as many as calculations ran at the same time and all stay warm.
+             */
+            mutable std::vector<std::unique_ptr<SiftContext>> _contexts;
+
+            mutable std::mutex _mutex;
 
         public:
             /**
@@ -62,52 +133,237 @@ namespace sift {
              * @param dogsPerEpoch How many DOGs should be created per octave
              * @param octaves how many octaves should be calculated
              * @param subpixel wether the calculation is based on subpixel basis or not
+             * @param threads how many threads build the scale space. 0 uses all hardware threads
+             * @param incremental wether the levels are blurred by the incremental instead of the
+             * absolute sigma. A downsampled octave starts at sigma * k^(dogsPerEpoch - 1) / 2, so
+             * k^(dogsPerEpoch - 2) has to stay below 2, e.g. dogsPerEpoch = 4 with k = sqrt(2) is
+             * rejected
+             * @param contrast the smallest |DoG - 128| of an interest point candidate. 0 keeps all
+             * candidates
+             * @param precision how the magnitudes and orientations are stored
+             * @param maxKeypoints the most interest points of a calculation, which are chosen by
+             * their response and spread over the image. 0 keeps all
+             * @throws std::invalid_argument if the incremental mode wouldn't blur the first level of an
+             * octave
              */
             explicit 
                 Sift(u16_t dogsPerEpoch = 3, u16_t octaves = 3, f32_t sigma = 1.6, 
-                        f32_t k = std::sqrt(2), bool subpixel = false) : 
+                        f32_t k = std::sqrt(2), bool subpixel = false, u16_t threads = 1,
+                        bool incremental = false, f32_t contrast = 0, Precision precision = Precision::f32,
+                        u32_t maxKeypoints = 0) : 
                         subpixel(subpixel), _sigma(sigma), _k(k), _dogsPerEpoch(dogsPerEpoch), 
-                        _octaves(octaves) {
+                        _octaves(octaves), _incremental(incremental), _contrast(contrast), 
+                        _precision(precision), _maxKeypoints(maxKeypoints), _descriptorWeights(alg::descriptorWeights(alg::descriptorWindow / 2)),
+                        _pool(threads) {
+                        _createKernels();
                     }
 
             /**
-             * Processes the whole Sift calculation
+             * Processes the whole Sift calculation. Can be called by several threads at once, each
+             * calculation takes an idle context of the Sift object.
              * @param img the given image
+             * @param stats takes the profile of the calculation, if it isn't nullptr
              * @return a vector containing the filtered sift features
              */
-            std::vector<InterestPoint> calculate(vigra::MultiArray<2, f32_t>&);
+            std::vector<InterestPoint> calculate(const vigra::MultiArrayView<2, f32_t>&, SiftStats* = nullptr) const;
+
+            /**
+             * Processes the whole Sift calculation in a context of the caller
+             * @param img the given image
+             * @param context takes the state of the calculation, it may only be used by one
+             * calculation at a time
+             * @param stats takes the profile of the calculation, if it isn't nullptr
+             * @return a vector containing the filtered sift features
+             */
+            std::vector<InterestPoint> calculate(const vigra::MultiArrayView<2, f32_t>&, SiftContext&,
+                    SiftStats* = nullptr) const;
+
+            /**
+             * Processes the whole Sift calculation into a descriptor set. The set keeps its
+             * memory, so calculating image after image into the same set doesn't allocate. Can be
+             * called by several threads at once.
+             * @param img the given image
+             * @param set takes the filtered sift features
+             * @param stats takes the profile of the calculation, if it isn't nullptr
+             */
+            void calculate(const vigra::MultiArrayView<2, f32_t>&, DescriptorSet&, SiftStats* = nullptr) const;
+
+            /**
+             * Processes the whole Sift calculation into a descriptor set in a context of the caller
+             * @param img the given image
+             * @param set takes the filtered sift features
+             * @param context takes the state of the calculation
+             * @param stats takes the profile of the calculation, if it isn't nullptr
+             */
+            void calculate(const vigra::MultiArrayView<2, f32_t>&, DescriptorSet&, SiftContext&,
+                    SiftStats* = nullptr) const;
+
+            /**
+             * Processes the whole Sift calculation into a set of 8 bit descriptors. Can be called
+             * by several threads at once.
+             * @param img the given image
+             * @param set takes the filtered sift features with quantized descriptors
+             * @param stats takes the profile of the calculation, if it isn't nullptr
+             */
+            void calculate(const vigra::MultiArrayView<2, f32_t>&, QuantizedDescriptorSet&, SiftStats* = nullptr) const;
+
+            /**
+             * Processes the whole Sift calculation into a set of 8 bit descriptors in a context of
+             * the caller
+             * @param img the given image
+             * @param set takes the filtered sift features with quantized descriptors
+             * @param context takes the state of the calculation
+             * @param stats takes the profile of the calculation, if it isn't nullptr
+             */
+            void calculate(const vigra::MultiArrayView<2, f32_t>&, QuantizedDescriptorSet&, SiftContext&,
+                    SiftStats* = nullptr) const;
+
+            /**
+             * The first half of a calculation: builds the Gaussian pyramid of an image in a
+             * context. The image isn't needed anymore afterwards. The context keeps the pyramid
+             * until describe, so another image can be built in a second context meanwhile.
+             * @param img the given image
+             * @param context takes the pyramid of the image
+             * @param stats takes the setup and Gaussian times and the memory, if it isn't nullptr
+             */
+            void build(const vigra::MultiArrayView<2, f32_t>&, SiftContext&, SiftStats* = nullptr) const;
+
+            /**
+             * The second half of a calculation: finds the interest points in the pyramid, which
+             * build left in the context, and describes them
+             * @param context the context build filled
+             * @param set takes the filtered sift features
+             * @param stats takes the times and counts of the stages, if it isn't nullptr
+             */
+            void describe(SiftContext&, DescriptorSet&, SiftStats* = nullptr) const;
+
+            /**
+             * The second half of a calculation into a set of 8 bit descriptors
+             * @param context the context build filled
+             * @param set takes the filtered sift features with quantized descriptors
+             * @param stats takes the times and counts of the stages, if it isn't nullptr
+             */
+            void describe(SiftContext&, QuantizedDescriptorSet&, SiftStats* = nullptr) const;
+
+            /**
+             * The margin around a region of an image, which a calculation on a part of the image
+             * needs, to find the same interest points inside of the region as on the whole image.
+             * It covers the blur of all levels, which adds up over the octaves, and the windows
+             * of the orientation and the descriptor in the last octave.
+             * @return the margin in pixels of the input image
+             */
+            u32_t halo() const;
+
+            /**
+             * Every octave takes every second pixel of the one before. A part of an image, which
+             * starts at a multiple of this alignment, is sampled at the same pixels as the whole
+             * image in every octave.
+             * @return the alignment in pixels of the input image
+             */
+            u32_t alignment() const;
+
+            /**
+             * @param shape the shape of an input image
+             * @return the bytes of the workspace a calculation of an image of this shape needs
+             */
+            u64_t workspaceBytes(const vigra::Shape2&) const;
 
         private:
             /**
-             * Creates the local image desciptors.
+             * @return an idle context or a new one, if all are in use
+             */
+            std::unique_ptr<SiftContext> _acquire() const;
+
+            /**
+             * Puts a context back, so the next calculation can take it
+             * @param context the context
+             */
+            void _release(std::unique_ptr<SiftContext>) const;
+
+            /**
+             * Creates the Gaussian kernels of the scale space and the scales of the levels. In the absolute mode every level is
+             * blurred with its scale k^exp * sigma. In the incremental mode a level is blurred by
+             * sqrt(s_j^2 - s_j-1^2), which takes it from the blur of the level below to the blur 
+             * sigma * k^j. The level, which gets sampled down, is already blurred enough, so the
+             * next octave starts with a blur of sigma * k^(dogsPerEpoch - 1) / 2.
+             */
+            void _createKernels();
+
+            /**
+             * Creates the local image desciptors with alg::descriptor. The cost only depends on
+             * the count of interest points and the gradient pyramids are only read, so chunks of
+             * interest points are shared by the threads of the pool.
+             * @param workspace the pyramids of the calculation
              * @param interestpoints the vector with interestpoints
              */
-            void _createDecriptors(std::vector<InterestPoint>&);
+            void _createDecriptors(const SiftWorkspace&, std::vector<InterestPoint>&) const;
 
             /**
-             * Eliminates all values above the threshold of 0.2 and performs a new 
-             * vector normalization as long as there are no more values above 0.2
-             * @param vec The given vector
+             * Creates the desciptors of the interest points in a descriptor set. Interest points
+             * whose window doesn't fit into the image are left out.
+             * @param workspace the pyramids of the calculation
+             * @param interestPoints the interest points with their orientation
+             * @param set takes the interest points and their descriptors
              */
-            std::vector<f32_t> _eliminateVectorThreshold(std::vector<f32_t>&) const;
-            
+            template <typename T>
+            void _createDescriptors(const SiftWorkspace&, const std::vector<InterestPoint>&, BasicDescriptorSet<T>&) const;
+
+            /**
+             * Creates the desciptor of a single interest point
+             * @param workspace the pyramids of the calculation
+             * @param p the interest point
+             * @param out takes the alg::descriptorSize values of the descriptor
+             * @return false if the window of the interest point doesn't fit into the image
+             */
+            bool _createDescriptor(const SiftWorkspace&, const InterestPoint&, f32_t*) const;
+
+            /**
+             * Prepares the workspace and builds the Gaussian pyramid of an image
+             * @param img the given image
+             * @param workspace takes the pyramids of the calculation
+             * @param stats takes the times of the stages and the memory, if it isn't nullptr
+             */
+            void _buildPyramid(const vigra::MultiArrayView<2, f32_t>&, SiftWorkspace&, SiftStats*) const;
+
             /**
-             * Creates magnitude versions of all the gaussian images.
+             * Runs all steps after the Gaussian pyramid up to the orientation assignment and
+             * removes the filtered interest points
+             * @param workspace the pyramids of the calculation
+             * @param stats takes the times and counts of the stages, if it isn't nullptr
+             * @return the interest points with their orientations, but without descriptors
              */
-            void _createMagnitudePyramid();
+            std::vector<InterestPoint> _detectInterestPoints(SiftWorkspace&, SiftStats*) const;
 
             /**
-             * Create orientation versions of all the gaussian images.
+             * Creates the magnitudes and orientations of the gaussian images, but only where they
+             * are read later. Every level is split into tiles and only the tiles, which overlap the
+             * region around an interest point in its nearest Gaussian, are calculated by
+             * alg::gradients. The tiles are shared by the threads of the pool. All other pixels of
+             * the gradient pyramids are left undefined.
+             * @param workspace the pyramids of the calculation
+             * @param interestPoints the interest points whose regions are needed
              */
-            void _createOrientationPyramid();
+            void _createGradients(SiftWorkspace&, const std::vector<InterestPoint>&) const;
 
             /**
              * Keypoint Location using Taylor expansion to filter the weak interest points. Those 
              * interest points, which get filtered get their filtered flag set to true
              * @param interestpoints the vector with interestpoints 
-             * @param dogs the dogs which were calculated in an earlier step
+             * @param neighborhoods the DoG values around every interest point, in the same order
              */
-            void _eliminateEdgeResponses(std::vector<InterestPoint>&,  const Matrix<OctaveElem>&) const;
+            void _eliminateEdgeResponses(std::vector<InterestPoint>&, const std::vector<Neighborhood>&) const;
+
+            /**
+             * Keeps the _maxKeypoints interest points with the strongest responses, spread over the
+             * image. The image is split into a grid of cells, which all get the same share of the
+             * budget. A cell keeps its strongest points up to its share, the budget the sparse
+             * cells leave goes to the strongest of the remaining points of all cells. Every
+             * selection is partial by std::nth_element, nothing gets sorted. The order of the
+             * kept interest points stays the same.
+             * @param interestPoints the interest points, which haven't been filtered
+             * @param shape the shape of the first octave
+             */
+            void _cullKeypoints(std::vector<InterestPoint>&, const vigra::Shape2&) const;
 
             /**
              * Searches for the highest Element in the orientation histogram and searches for other 
@@ -118,33 +374,55 @@ namespace sift {
             const std::set<f32_t> _findPeaks(const std::array<f32_t, 36>&) const;
 
             /**
-             * Calculates the orientation assignments for the interestPoints
+             * Calculates the orientation assignments for the interestPoints. Chunks of interest
+             * points are shared by the threads of the pool. The interest points of additional
+             * orientations are collected per chunk and appended in the order of the chunks, so the
+             * result is the same as with a single thread.
+             * @param workspace the pyramids of the calculation
              * @param interestPoints the found interestPoints for whom the orientation should be 
              * calulated
              */     
-            void _orientationAssignment(std::vector<InterestPoint>&);
+            void _orientationAssignment(const SiftWorkspace&, std::vector<InterestPoint>&) const;
+
+            /**
+             * Calculates the orientation of a single interest point
+             * @param workspace the pyramids of the calculation
+             * @param p the interest point, which gets its orientation or gets filtered
+             * @param additional takes a copy of the interest point for every further orientation
+             */
+            void _assignOrientation(const SiftWorkspace&, InterestPoint&, std::vector<InterestPoint>&) const;
 
             /**
-             * Finds the nearest gaussian, based on the scale given
+             * Finds the nearest gaussian, based on the scale given. Only reads the scales of the
+             * configuration.
              * @param scale the scale
              * @return the point where the Gaussian is lying in the pyramid
              */
-            const Point<u16_t, u16_t> _findNearestGaussian(f32_t);
+            const Point<u16_t, u16_t> _findNearestGaussian(f32_t) const;
 
             /**
-             * Finds the Scale space extrema aka InterestPoints
-             * @param dogs a matrix of DOGs
+             * Finds the Scale space extrema aka InterestPoints in a single streaming pass over the
+             * Gaussians. The DoGs are only created row by row inside of alg::findExtrema, so they
+             * never exist as whole images. Candidates with a lower contrast than _contrast are
+             * rejected right away. The rows of every octave are split into bands, which
+             * are searched by the threads of the pool, which keep their ring buffers in the scratch
+             * memory of the workspace. The interest points are ordered by octave, DoG, x and y, no
+             * matter how many threads searched.
+             * @param workspace the pyramids and the scratch memory of the calculation
              * @param interestPoints a vector which holds interestPoints. Will be filled with the 
              * found interest points
+             * @param neighborhoods will be filled with the DoG values around every interest point
              */
-            void _findScaleSpaceExtrema(const Matrix<OctaveElem>&, std::vector<InterestPoint>&) const;
+            void _findScaleSpaceExtrema(SiftWorkspace&, std::vector<InterestPoint>&,
+                    std::vector<Neighborhood>&) const;
 
             /**
-             * Creates the Difference of Gaussians for the count of octaves.
+             * Creates the Gaussians for the count of octaves inside of the workspace, which has to
+             * be reserved for the image before. Every blur is shared by the threads of the pool.
              * @param img the given img
-             * @return a matrix with the octaves as width and octave elements as height, which contain the DoGs
+             * @param workspace takes the Gaussians
              */
-            const Matrix<OctaveElem> _createDOGs(vigra::MultiArray<2, f32_t>&);
+            void _createGaussians(const vigra::MultiArrayView<2, f32_t>&, SiftWorkspace&) const;
     };
 }
 #endif //SIFT_HPP
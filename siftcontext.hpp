@@ -0,0 +1,40 @@
+#ifndef SIFTCONTEXT_HPP
+#define SIFTCONTEXT_HPP
+
+#include "types.hpp"
+#include "workspace.hpp"
+
+namespace sift {
+    /**
+     * The state of a single calculation: the pyramids and the scratch memory, which a Sift object
+     * fills while it calculates an image. A Sift object itself only holds its configuration and
+     * tables, which never change, so several threads can calculate with the same Sift object at
+     * once, as long as each of them passes its own context. A context keeps its memory, so the next
+     * calculation of an image of the same size doesn't allocate.
+     */
+    class SiftContext {
+            friend class Sift;
+
+            /**
+             * Runs the stages of a calculation one by one in the benchmark suite
+             */
+            friend class SiftBench;
+
+        private:
+            SiftWorkspace _workspace;
+
+        public:
+            SiftContext() = default;
+
+            SiftContext(const SiftContext&) = delete;
+            SiftContext& operator=(const SiftContext&) = delete;
+
+            /**
+             * @return the bytes of the memory the context holds
+             */
+            u64_t bytes() const {
+                return _workspace.bytes();
+            }
+    };
+}
+#endif //SIFTCONTEXT_HPP
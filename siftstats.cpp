@@ -0,0 +1,22 @@
+#include "siftstats.hpp"
+
+#include <sstream>
+
+namespace sift {
+    std::string SiftStats::toJson() const {
+        std::ostringstream out;
+        out << "{\n"
+            << "  \"seconds\": {\"setup\": " << setupSeconds << ", \"gaussians\": " << gaussianSeconds
+            << ", \"extrema\": " << extremaSeconds << ", \"edges\": " << edgeSeconds
+            << ", \"gradients\": " << gradientSeconds << ", \"orientation\": " << orientationSeconds
+            << ", \"descriptors\": " << descriptorSeconds << ", \"total\": " << totalSeconds << "},\n"
+            << "  \"counts\": {\"candidates\": " << candidates << ", \"afterEdges\": " << afterEdges
+            << ", \"afterBudget\": " << afterBudget << ", \"afterOrientation\": " << afterOrientation
+            << ", \"descriptors\": " << descriptors << "},\n"
+            << "  \"memory\": {\"gaussianBytes\": " << pyramidBytes << ", \"magnitudeBytes\": " << gradientBytes
+            << ", \"orientationBytes\": " << gradientBytes << ", \"workspaceBytes\": " << workspaceBytes
+            << ", \"allocatedBytes\": " << allocatedBytes << ", \"peakBytes\": " << peakBytes << "}\n"
+            << "}";
+        return out.str();
+    }
+}
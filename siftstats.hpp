@@ -0,0 +1,111 @@
+#ifndef SIFTSTATS_HPP
+#define SIFTSTATS_HPP
+
+#include <string>
+
+#include "types.hpp"
+
+namespace sift {
+    /**
+     * The profile of a single Sift calculation: the wall time of every stage, the count of
+     * interest point candidates before and after every filter and the memory of the pyramids.
+     * A calculation fills it, if one is handed to Sift::calculate.
+     */
+    class SiftStats {
+        public:
+            /**
+             * The time of preparing the workspace and doubling the input image in the subpixel
+             * mode
+             */
+            f64_t setupSeconds = 0;
+
+            /**
+             * The time of building the Gaussian pyramid
+             */
+            f64_t gaussianSeconds = 0;
+
+            /**
+             * The time of the search for the scale space extrema
+             */
+            f64_t extremaSeconds = 0;
+
+            /**
+             * The time of the keypoint localization, which removes the weak and the edge responses
+             */
+            f64_t edgeSeconds = 0;
+
+            /**
+             * The time of the gradients around the remaining candidates
+             */
+            f64_t gradientSeconds = 0;
+
+            f64_t orientationSeconds = 0;
+
+            f64_t descriptorSeconds = 0;
+
+            /**
+             * The time of the whole calculation
+             */
+            f64_t totalSeconds = 0;
+
+            /**
+             * The count of scale space extrema above the contrast threshold
+             */
+            u64_t candidates = 0;
+
+            /**
+             * The count of candidates, which are left after the keypoint localization
+             */
+            u64_t afterEdges = 0;
+
+            /**
+             * The count of interest points the keypoint budget kept
+             */
+            u64_t afterBudget = 0;
+
+            /**
+             * The count of interest points after the orientation assignment, including the ones of
+             * additional orientations
+             */
+            u64_t afterOrientation = 0;
+
+            /**
+             * The count of interest points with a descriptor
+             */
+            u64_t descriptors = 0;
+
+            /**
+             * The bytes of the Gaussian pyramid
+             */
+            u64_t pyramidBytes = 0;
+
+            /**
+             * The bytes of each of the magnitude and orientation pyramids, which are smaller than
+             * the Gaussian one in the 16 bit precisions
+             */
+            u64_t gradientBytes = 0;
+
+            /**
+             * The bytes of the workspace, which this calculation used for all pyramids and
+             * temporary images
+             */
+            u64_t workspaceBytes = 0;
+
+            /**
+             * The bytes, which were allocated for the workspace by this calculation. 0 if the
+             * workspace of a calculation before was big enough.
+             */
+            u64_t allocatedBytes = 0;
+
+            /**
+             * The most bytes the workspace of the Sift object ever held
+             */
+            u64_t peakBytes = 0;
+
+            /**
+             * @return all values as a JSON object
+             */
+            std::string toJson() const;
+    };
+}
+#endif //SIFTSTATS_HPP
@@ -0,0 +1,230 @@
+#include "stream.hpp"
+
+#include <future>
+#include <sstream>
+#include <stdexcept>
+#include <algorithm>
+
+namespace sift {
+    namespace {
+        /**
+         * @param a the one frame
+         * @param b the other frame
+         * @param region a tile
+         * @return true if the core of the tile has the same pixels in both frames
+         */
+        bool unchanged(const vigra::MultiArrayView<2, f32_t>& a, const vigra::MultiArrayView<2, f32_t>& b,
+                const TileRegion& region) {
+
+            const i64_t as = a.stride(0);
+            const i64_t bs = b.stride(0);
+            for (u32_t y = region.y0; y < region.y1; y++) {
+                const f32_t* ra = &a(region.x0, y);
+                const f32_t* rb = &b(region.x0, y);
+                for (u32_t x = 0; x < region.x1 - region.x0; x++) {
+                    if (ra[x * as] != rb[x * bs])
+                        return false;
+                }
+            }
+            return true;
+        }
+
+        /**
+         * @param core a tile, whose core is tested
+         * @param region a tile, whose calculated rectangle is tested
+         * @return true if the core lies partly inside of the calculated rectangle
+         */
+        bool overlaps(const TileRegion& core, const TileRegion& region) {
+            return core.x0 < region.x + region.shape[0] && region.x < core.x1 &&
+                core.y0 < region.y + region.shape[1] && region.y < core.y1;
+        }
+    }
+
+    std::string StreamStats::toJson() const {
+        std::ostringstream out;
+        out << "{\"frames\": " << frames << ", \"seconds\": " << seconds << ", \"fps\": " << framesPerSecond()
+            << ", \"latency\": {\"last\": " << latencySeconds << ", \"mean\": " << meanLatencySeconds()
+            << ", \"max\": " << maxLatencySeconds << "}, \"tiles\": " << tiles << ", \"reusedTiles\": "
+            << reusedTiles << "}";
+        return out.str();
+    }
+
+    SiftStream::SiftStream(const Sift& sift, const vigra::Shape2& shape, u32_t tileSize) :
+        _sift(sift), _shape(shape), _skip(tileSize > 0), _stage(2) {
+
+        if (shape[0] <= 0 || shape[1] <= 0)
+            throw std::invalid_argument("A stream needs frames of at least one pixel");
+
+        if (_skip) {
+            const u32_t alignment = sift.alignment();
+            _plan.halo = sift.halo();
+            _plan.tileSize = (tileSize + alignment - 1) / alignment * alignment;
+            _plan.columns = (shape[0] + _plan.tileSize - 1) / _plan.tileSize;
+            _plan.rows = (shape[1] + _plan.tileSize - 1) / _plan.tileSize;
+            for (u32_t t = 0; t < _plan.columns * _plan.rows; t++) {
+                _regions.push_back(tileRegion(_plan, alignment, shape[0], shape[1], t));
+            }
+            _features.resize(_regions.size());
+            _previous.reshape(shape);
+        }
+
+        TileRegion whole;
+        whole.shape = shape;
+        whole.x1 = shape[0];
+        whole.y1 = shape[1];
+        _whole = _regions.size();
+        _regions.push_back(whole);
+
+        for (u16_t half = 0; half < 2; half++) {
+            _contexts[half].resize(_regions.size());
+        }
+    }
+
+    bool SiftStream::push(const vigra::MultiArrayView<2, f32_t>& frame, DescriptorSet& set) {
+        if (frame.shape() != _shape)
+            throw std::invalid_argument("The frame has another shape than the stream");
+
+        const Clock::time_point now = Clock::now();
+        if (!_started)
+            _start = now;
+        _started = true;
+
+        const u16_t half = _next;
+        const u16_t before = half ^ 1;
+        _dirty[half] = _changed(frame);
+        _pushed[half] = now;
+        if (_skip) {
+            const bool whole = !_dirty[half].empty() && _dirty[half].front() == _whole;
+            _stats.tiles += _features.size();
+            _stats.reusedTiles += whole ? 0 : _features.size() - _dirty[half].size();
+        }
+        if (_skip && !_dirty[half].empty())
+            _previous = frame;
+
+        //The frame only has to live until the build is finished, which is before this call returns
+        std::future<void> build = _stage.submit([this, &frame, half]() { _build(frame, half); });
+        const bool ready = _pending;
+        try {
+            if (ready)
+                _describe(before, set);
+            build.get();
+        } catch (...) {
+            //Both frames in the pipeline are dropped and the next one is calculated as a whole
+            if (build.valid())
+                build.wait();
+            _pending = false;
+            _primed = false;
+            throw;
+        }
+
+        if (ready)
+            _handOut(before);
+        _pending = true;
+        _primed = true;
+        _next = before;
+        return ready;
+    }
+
+    bool SiftStream::finish(DescriptorSet& set) {
+        if (!_pending)
+            return false;
+
+        const u16_t half = _next ^ 1;
+        _pending = false;
+        try {
+            _describe(half, set);
+        } catch (...) {
+            _primed = false;
+            throw;
+        }
+        _handOut(half);
+        return true;
+    }
+
+    std::vector<u32_t> SiftStream::_changed(const vigra::MultiArrayView<2, f32_t>& frame) const {
+        const std::vector<u32_t> whole(1, _whole);
+        if (!_skip || !_primed)
+            return whole;
+
+        //The cores cover every pixel once, a tile has to be calculated, if a core inside of its
+        //halo changed
+        std::vector<u32_t> changed;
+        for (u32_t t = 0; t < _whole; t++) {
+            if (!unchanged(frame, _previous, _regions[t]))
+                changed.push_back(t);
+        }
+
+        //The halos of the tiles overlap, so a few changed tiles can cost more than the whole frame
+        std::vector<u32_t> dirty;
+        u64_t pixels = 0;
+        for (u32_t r = 0; r < _whole; r++) {
+            const bool touched = std::any_of(changed.begin(), changed.end(),
+                    [&](u32_t t) { return overlaps(_regions[t], _regions[r]); });
+            if (!touched)
+                continue;
+            dirty.push_back(r);
+            pixels += static_cast<u64_t>(_regions[r].shape[0]) * _regions[r].shape[1];
+        }
+        return pixels < static_cast<u64_t>(_shape[0]) * _shape[1] ? dirty : whole;
+    }
+
+    void SiftStream::_build(const vigra::MultiArrayView<2, f32_t>& frame, u16_t half) {
+        for (u32_t r : _dirty[half]) {
+            const TileRegion& region = _regions[r];
+            if (!_contexts[half][r])
+                _contexts[half][r].reset(new SiftContext());
+
+            const vigra::Shape2 from(region.x, region.y);
+            const vigra::Shape2 to(region.x + region.shape[0], region.y + region.shape[1]);
+            _sift.build(frame.subarray(from, to), *_contexts[half][r]);
+        }
+    }
+
+    void SiftStream::_describe(u16_t half, DescriptorSet& set) {
+        if (!_skip) {
+            _sift.describe(*_contexts[half][_whole], set);
+            return;
+        }
+
+        for (u32_t r : _dirty[half]) {
+            if (r == _whole) {
+                _sift.describe(*_contexts[half][r], _frame);
+                _split();
+                continue;
+            }
+            _sift.describe(*_contexts[half][r], _features[r]);
+            keepCore(_features[r], _regions[r]);
+        }
+        concatenate(_features, set);
+    }
+
+    void SiftStream::_split() {
+        auto tile = [this](u32_t i) {
+            const u32_t column = static_cast<u32_t>(_frame.x[i]) / _plan.tileSize;
+            const u32_t row = static_cast<u32_t>(_frame.y[i]) / _plan.tileSize;
+            return row * _plan.columns + column;
+        };
+
+        std::vector<u32_t> counts(_features.size());
+        for (u32_t i = 0; i < _frame.size(); i++) {
+            counts[tile(i)]++;
+        }
+        for (u32_t t = 0; t < _features.size(); t++) {
+            _features[t].resize(counts[t]);
+            counts[t] = 0;
+        }
+        for (u32_t i = 0; i < _frame.size(); i++) {
+            const u32_t t = tile(i);
+            _frame.copyTo(i, _features[t], counts[t]++);
+        }
+    }
+
+    void SiftStream::_handOut(u16_t half) {
+        const Clock::time_point now = Clock::now();
+        _stats.latencySeconds = std::chrono::duration<f64_t>(now - _pushed[half]).count();
+        _stats.totalLatencySeconds += _stats.latencySeconds;
+        _stats.maxLatencySeconds = std::max(_stats.maxLatencySeconds, _stats.latencySeconds);
+        _stats.frames++;
+        _stats.seconds = std::chrono::duration<f64_t>(now - _start).count();
+    }
+}
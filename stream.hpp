@@ -0,0 +1,252 @@
+#ifndef STREAM_HPP
+#define STREAM_HPP
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <chrono>
+
+#include <vigra/multi_array.hxx>
+
+#include "types.hpp"
+#include "sift.hpp"
+#include "siftcontext.hpp"
+#include "descriptorset.hpp"
+#include "threadpool.hpp"
+#include "tiled.hpp"
+
+namespace sift {
+    /**
+     * The counters of a stream
+     */
+    class StreamStats {
+        public:
+            /**
+             * The count of frames, whose features were handed out
+             */
+            u64_t frames = 0;
+
+            /**
+             * The time between the push of the latest frame, whose features were handed out, and
+             * the hand out
+             */
+            f64_t latencySeconds = 0;
+
+            /**
+             * The sum and the maximum of the latencies of all frames
+             */
+            f64_t totalLatencySeconds = 0;
+            f64_t maxLatencySeconds = 0;
+
+            /**
+             * The wall clock time from the first push until the latest hand out
+             */
+            f64_t seconds = 0;
+
+            /**
+             * The count of tiles of all frames and of the ones, whose features were taken from the
+             * frame before, because none of their pixels changed
+             */
+            u64_t tiles = 0;
+            u64_t reusedTiles = 0;
+
+            f64_t meanLatencySeconds() const {
+                return frames > 0 ? totalLatencySeconds / frames : 0;
+            }
+
+            /**
+             * @return the sustained throughput of the stream
+             */
+            f64_t framesPerSecond() const {
+                return seconds > 0 ? frames / seconds : 0;
+            }
+
+            /**
+             * @return all values as a JSON object
+             */
+            std::string toJson() const;
+    };
+
+    /**
+     * Calculates the features of a sequence of frames of the same shape, like the ones of a
+     * camera. The stream is a pipeline of two stages: while the caller finds and describes the
+     * interest points of a frame, a second thread already builds the Gaussian pyramid of the
+     * next one. Each stage
+     * has its own contexts, so the pyramids of two frames are in memory and no frame allocates
+     * anything after the first two.
+     *
+     * With a tile size, the frame is split into tiles with a halo like in the tiled mode and a
+     * tile is only calculated again, if a pixel of it or of its halo changed since the frame
+     * before. The other tiles keep their features. If the changed tiles with their halos cover
+     * more pixels than the frame, the whole frame is calculated instead and its features are
+     * split into the tiles. The features are the same as without skipping, only a keypoint
+     * budget applies to every region, which is calculated on its own.
+     */
+    class SiftStream {
+        private:
+            typedef std::chrono::steady_clock Clock;
+
+            /**
+             * Calculates every frame, it must outlive the stream
+             */
+            const Sift& _sift;
+
+            const vigra::Shape2 _shape;
+
+            /**
+             * Wether unchanged tiles are skipped
+             */
+            const bool _skip;
+
+            /**
+             * The tiles of a frame, if tiles are skipped
+             */
+            TilePlan _plan;
+
+            /**
+             * The regions, which are calculated on their own: the tiles followed by the whole frame
+             */
+            std::vector<TileRegion> _regions;
+
+            /**
+             * The index of the region of the whole frame
+             */
+            u32_t _whole = 0;
+
+            /**
+             * The contexts of the two frames in the pipeline, one per tile each
+             */
+            std::vector<std::unique_ptr<SiftContext>> _contexts[2];
+
+            /**
+             * The regions, which are calculated for the two frames in the pipeline
+             */
+            std::vector<u32_t> _dirty[2];
+
+            /**
+             * When the two frames in the pipeline were pushed
+             */
+            Clock::time_point _pushed[2];
+
+            /**
+             * The latest features of every tile in frame coordinates, if tiles are skipped
+             */
+            std::vector<DescriptorSet> _features;
+
+            /**
+             * The features of a calculation of the whole frame, before they are split into the tiles
+             */
+            DescriptorSet _frame;
+
+            /**
+             * The frame before, against which the tiles are compared, if tiles are skipped
+             */
+            vigra::MultiArray<2, f32_t> _previous;
+
+            /**
+             * The half of the pipeline, which takes the next frame
+             */
+            u16_t _next = 0;
+
+            /**
+             * Wether a frame waits for its description
+             */
+            bool _pending = false;
+
+            /**
+             * Wether the frame before and the features of all tiles are complete, so tiles can be
+             * skipped
+             */
+            bool _primed = false;
+
+            /**
+             * Wether a frame was pushed already
+             */
+            bool _started = false;
+
+            Clock::time_point _start;
+
+            /**
+             * The thread, which builds the pyramids of the next frame
+             */
+            ThreadPool _stage;
+
+            StreamStats _stats;
+
+        public:
+            /**
+             * @param sift calculates every frame, it must outlive the stream
+             * @param shape the shape of every frame
+             * @param tileSize the size of the tiles, which are only calculated, when they changed.
+             * It is rounded up to the alignment of the Sift object. 0 calculates every frame as a
+             * whole.
+             */
+            SiftStream(const Sift&, const vigra::Shape2&, u32_t = 0);
+
+            SiftStream(const SiftStream&) = delete;
+            SiftStream& operator=(const SiftStream&) = delete;
+
+            /**
+             * Hands the next frame to the stream and takes the features of the frame before out
+             * of it. The pyramid of the new frame is built while the frame before gets
+             * described, the frame is not needed anymore after the call.
+             * @param frame the next frame
+             * @param set takes the features of the frame before
+             * @return false for the first frame, which has no frame before
+             * @throws std::invalid_argument if the frame has another shape than the stream. An
+             * error of the calculation drops both frames of the pipeline.
+             */
+            bool push(const vigra::MultiArrayView<2, f32_t>&, DescriptorSet&);
+
+            /**
+             * Takes the features of the latest frame out of the stream, after the last push
+             * @param set takes the features of the latest frame
+             * @return false if there is no frame, whose features weren't handed out yet
+             */
+            bool finish(DescriptorSet&);
+
+            const StreamStats& stats() const {
+                return _stats;
+            }
+
+            const vigra::Shape2& shape() const {
+                return _shape;
+            }
+
+        private:
+            /**
+             * @param frame the next frame
+             * @return the regions, which have to be calculated: the tiles, which changed since the
+             * frame before, or the whole frame, if that has fewer pixels
+             */
+            std::vector<u32_t> _changed(const vigra::MultiArrayView<2, f32_t>&) const;
+
+            /**
+             * Builds the Gaussian pyramids of the changed tiles of a frame
+             * @param frame the frame
+             * @param half the half of the pipeline of the frame
+             */
+            void _build(const vigra::MultiArrayView<2, f32_t>&, u16_t);
+
+            /**
+             * Finds and describes the interest points of a frame and collects the features of all
+             * tiles
+             * @param half the half of the pipeline of the frame
+             * @param set takes the features of the frame
+             */
+            void _describe(u16_t, DescriptorSet&);
+
+            /**
+             * Moves the features of a calculation of the whole frame into the tiles, whose cores
+             * they lie in
+             */
+            void _split();
+
+            /**
+             * Counts a frame, whose features are handed out now
+             * @param half the half of the pipeline of the frame
+             */
+            void _handOut(u16_t);
+    };
+}
+#endif //STREAM_HPP
@@ -0,0 +1,159 @@
+#include <iostream>
+#include <string>
+#include <vector>
+#include <cmath>
+#include <algorithm>
+#include <random>
+#include <utility>
+
+#include <vigra/multi_array.hxx>
+
+#include "sift.hpp"
+#include "matrix.hpp"
+#include "interestpoint.hpp"
+#include "descriptorset.hpp"
+#include "workspace.hpp"
+
+/*
+ * The checks of the sizes, which don't fit into 16 bit. Every case prints its failures and the
+ * exit code is the count of failed checks, so ctest sees every failure.
+ */
+namespace {
+    u32_t failures = 0;
+
+    void check(bool condition, const std::string& what) {
+        if (!condition) {
+            std::cerr << "FAILED: " << what << std::endl;
+            failures++;
+        }
+    }
+
+    /**
+     * Adds a bright blob, which SIFT finds as an interest point close to its center
+     * @param img the image
+     * @param cx the column of the center
+     * @param cy the row of the center
+     * @param radius the radius of the blob
+     */
+    void blob(vigra::MultiArray<2, f32_t>& img, i64_t cx, i64_t cy, f32_t radius) {
+        const i64_t reach = std::ceil(radius);
+        for (i64_t y = std::max<i64_t>(0, cy - reach); y <= std::min<i64_t>(img.height() - 1, cy + reach); y++) {
+            for (i64_t x = std::max<i64_t>(0, cx - reach); x <= std::min<i64_t>(img.width() - 1, cx + reach); x++) {
+                const f32_t d = (x - cx) * (x - cx) + (y - cy) * (y - cy);
+                if (d < radius * radius)
+                    img(x, y) = 200 * (1 - d / (radius * radius));
+            }
+        }
+    }
+
+    /**
+     * Matrix and InterestPoint keep coordinates beyond 16 bit
+     */
+    void testWideTypes() {
+        sift::Matrix<u32_t> m(70000, 3);
+        check(m.width() == 70000 && m.height() == 3, "Matrix keeps a width of 70000");
+        m(69999, 2) = 7;
+        m(4463, 2) = 3;
+        check(m(69999, 2) == 7 && m(4463, 2) == 3, "Matrix doesn't wrap x = 69999 onto x = 4463");
+
+        const sift::InterestPoint p(sift::Point<u32_t, u32_t>(70000, 66000), 1.6f, 0, 1);
+        check(p.loc.x == 70000 && p.loc.y == 66000, "InterestPoint keeps a location beyond 65535");
+    }
+
+    /**
+     * A shape of 70000x1000 has more pixels than 32 bit can count in bytes once it is doubled, so
+     * the Matrix and the size of the workspace have to count in 64 bit
+     */
+    void testTallWideShape() {
+        const u32_t width = 70000;
+        const u32_t height = 1000;
+        sift::Matrix<u8_t> m(width, height);
+        m(width - 1, height - 1) = 9;
+        m(width - 1, 0) = 5;
+        check(m(width - 1, height - 1) == 9 && m(width - 1, 0) == 5 && m(0, 0) == 0,
+                "Matrix keeps the last pixel of a 70000x1000 shape apart");
+
+        //The doubled input, the Gaussians, the magnitudes and the orientations of the first octave
+        const u16_t dogsPerEpoch = 3;
+        const u64_t pixels = static_cast<u64_t>(width * 2) * (height * 2);
+        const u64_t lower = pixels * (1 + 3 * (dogsPerEpoch + 1)) * sizeof(f32_t);
+        const u64_t bytes = sift::SiftWorkspace::requiredBytes(vigra::Shape2(width, height), 3, dogsPerEpoch, true,
+                4, 1);
+        check(bytes >= lower, "The workspace of a 70000x1000 shape takes at least " + std::to_string(lower) +
+                " bytes, got " + std::to_string(bytes));
+    }
+
+    /**
+     * A short image, which is wider than 65535 pixels, keeps the interest points beyond x = 65535
+     * at the same positions as a crop of its right end, which has no 16 bit problem
+     */
+    void testWideImage() {
+        const u32_t width = 70000;
+        const u32_t height = 96;
+        vigra::MultiArray<2, f32_t> img(vigra::Shape2(width, height));
+        std::mt19937 random(3);
+        for (u32_t b = 0; b < width * height / 100; b++) {
+            blob(img, random() % width, random() % height, 2 + random() % 6);
+        }
+
+        //Two octaves keep the pyramids of the wide image small
+        const sift::Sift sift(3, 2);
+        sift::DescriptorSet whole;
+        sift.calculate(img, whole);
+
+        //The crop starts at a multiple of the alignment with a halo, so it finds the same points
+        const u32_t start = 65536 - sift.halo();
+        sift::DescriptorSet crop;
+        sift.calculate(img.subarray(vigra::Shape2(start, 0), vigra::Shape2(width, height)), crop);
+
+        std::vector<std::pair<f32_t, f32_t>> expected, found;
+        for (u32_t i = 0; i < crop.size(); i++) {
+            if (crop.x[i] + start >= 65536)
+                expected.emplace_back(crop.x[i] + start, crop.y[i]);
+        }
+        for (u32_t i = 0; i < whole.size(); i++) {
+            if (whole.x[i] >= 65536)
+                found.emplace_back(whole.x[i], whole.y[i]);
+        }
+        std::sort(expected.begin(), expected.end());
+        std::sort(found.begin(), found.end());
+        check(!expected.empty(), "The crop of the right end of the wide image has interest points");
+        check(found == expected, "The " + std::to_string(expected.size()) + " interest points beyond x = 65535 " +
+                "survive at their positions, got " + std::to_string(found.size()));
+    }
+
+    /**
+     * A grid of blobs gives far more interest points than a 16 bit count can hold
+     */
+    void testManyKeypoints() {
+        const u32_t spacing = 8;
+        const u32_t cells = 330;
+        vigra::MultiArray<2, f32_t> img(vigra::Shape2(cells * spacing, cells * spacing));
+        for (u32_t y = 0; y < cells; y++) {
+            for (u32_t x = 0; x < cells; x++) {
+                blob(img, x * spacing + spacing / 2, y * spacing + spacing / 2, 2.5f);
+            }
+        }
+
+        const sift::Sift sift(3, 2);
+        sift::DescriptorSet set;
+        sift.calculate(img, set);
+        check(set.size() > 100000, "More than 100000 interest points are kept, got " + std::to_string(set.size()));
+        check(set.descriptors.size() == set.size() * sift::alg::descriptorSize,
+                "Every interest point of the set has a descriptor");
+
+        const std::vector<sift::InterestPoint> points = sift.calculate(img);
+        check(points.size() == set.size(), "The vector API keeps as many interest points as the set, got " +
+                std::to_string(points.size()));
+    }
+}
+
+int main() {
+    testWideTypes();
+    testTallWideShape();
+    testWideImage();
+    testManyKeypoints();
+    if (failures == 0)
+        std::cout << "All checks passed" << std::endl;
+    return failures;
+}
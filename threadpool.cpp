@@ -0,0 +1,188 @@
+#include "threadpool.hpp"
+
+#include <algorithm>
+
+namespace sift {
+    ThreadPool::ThreadPool(u16_t threads) : _pending(0), _next(0) {
+        if (threads == 0)
+            threads = std::max(1u, std::thread::hardware_concurrency());
+
+        for (u16_t i = 1; i < threads; i++) {
+            _queues.emplace_back(new Queue());
+        }
+        for (u16_t i = 1; i < threads; i++) {
+            _workers.emplace_back(&ThreadPool::_work, this, i - 1);
+        }
+    }
+
+    ThreadPool::~ThreadPool() {
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            _stop = true;
+        }
+        _condition.notify_all();
+        for (std::thread& t : _workers) {
+            t.join();
+        }
+    }
+
+    void ThreadPool::parallelFor(u32_t begin, u32_t end, const std::function<void(u32_t)>& fn) {
+        if (begin >= end)
+            return;
+
+        if (_workers.empty() || end - begin == 1) {
+            for (u32_t i = begin; i < end; i++) {
+                fn(i);
+            }
+            return;
+        }
+
+        //The indices of a thread are [next, end) of its range
+        struct Range {
+            std::mutex mutex;
+            u32_t next;
+            u32_t end;
+        };
+
+        //The state is shared with helpers, which may only get scheduled after everything is done
+        struct State {
+            std::unique_ptr<Range[]> ranges;
+            u32_t threads;
+            std::atomic<u32_t> done;
+            std::mutex mutex;
+            std::condition_variable finished;
+        };
+        const u32_t count = end - begin;
+        auto state = std::make_shared<State>();
+        state->threads = std::min<u32_t>(size(), count);
+        state->ranges.reset(new Range[state->threads]);
+        state->done = 0;
+        for (u32_t t = 0; t < state->threads; t++) {
+            state->ranges[t].next = begin + static_cast<u64_t>(count) * t / state->threads;
+            state->ranges[t].end = begin + static_cast<u64_t>(count) * (t + 1) / state->threads;
+        }
+        const std::function<void(u32_t)>* body = &fn;
+
+        //Takes the next index of the own range or steals the upper half of the biggest range
+        auto take = [](State& s, u32_t self, u32_t& index) {
+            {
+                Range& own = s.ranges[self];
+                std::lock_guard<std::mutex> lock(own.mutex);
+                if (own.next < own.end) {
+                    index = own.next++;
+                    return true;
+                }
+            }
+            for (;;) {
+                u32_t victim = s.threads;
+                u32_t biggest = 0;
+                for (u32_t t = 0; t < s.threads; t++) {
+                    std::lock_guard<std::mutex> lock(s.ranges[t].mutex);
+                    if (s.ranges[t].end - s.ranges[t].next > biggest) {
+                        biggest = s.ranges[t].end - s.ranges[t].next;
+                        victim = t;
+                    }
+                }
+                if (victim == s.threads)
+                    return false;
+
+                u32_t from, to;
+                {
+                    Range& other = s.ranges[victim];
+                    std::lock_guard<std::mutex> lock(other.mutex);
+                    if (other.next >= other.end)
+                        continue;
+                    from = other.next + (other.end - other.next) / 2;
+                    to = other.end;
+                    other.end = from;
+                }
+                Range& own = s.ranges[self];
+                std::lock_guard<std::mutex> lock(own.mutex);
+                own.next = from + 1;
+                own.end = to;
+                index = from;
+                return true;
+            }
+        };
+
+        //fn is only touched after an index was taken, so it outlives every call
+        auto run = [state, body, count, take](u32_t self) {
+            u32_t i;
+            while (take(*state, self, i)) {
+                (*body)(i);
+                if (++state->done == count) {
+                    std::lock_guard<std::mutex> lock(state->mutex);
+                    state->finished.notify_all();
+                }
+            }
+        };
+
+        for (u32_t t = 1; t < state->threads; t++) {
+            _push(t - 1, [run, t]() { run(t); });
+        }
+
+        run(0);
+        std::unique_lock<std::mutex> lock(state->mutex);
+        state->finished.wait(lock, [&]() { return state->done == count; });
+    }
+
+    std::future<void> ThreadPool::submit(std::function<void()> task) {
+        auto packaged = std::make_shared<std::packaged_task<void()>>(task);
+        std::future<void> result = packaged->get_future();
+        if (_workers.empty()) {
+            (*packaged)();
+            return result;
+        }
+        _push(_next++ % _queues.size(), [packaged]() { (*packaged)(); });
+        return result;
+    }
+
+    void ThreadPool::_push(u32_t queue, std::function<void()> task) {
+        {
+            std::lock_guard<std::mutex> lock(_queues[queue]->mutex);
+            _queues[queue]->tasks.emplace_back(std::move(task));
+        }
+        {
+            //Counted under the lock of the sleeping workers, so no wake up gets lost
+            std::lock_guard<std::mutex> lock(_mutex);
+            _pending++;
+        }
+        _condition.notify_all();
+    }
+
+    bool ThreadPool::_take(u32_t queue, std::function<void()>& task) {
+        for (u32_t i = 0; i < _queues.size(); i++) {
+            const u32_t current = (queue + i) % _queues.size();
+            Queue& q = *_queues[current];
+            std::lock_guard<std::mutex> lock(q.mutex);
+            if (q.tasks.empty())
+                continue;
+
+            if (current == queue) {
+                task = std::move(q.tasks.back());
+                q.tasks.pop_back();
+            } else {
+                task = std::move(q.tasks.front());
+                q.tasks.pop_front();
+            }
+            _pending--;
+            return true;
+        }
+        return false;
+    }
+
+    void ThreadPool::_work(u32_t queue) {
+        for (;;) {
+            std::function<void()> task;
+            if (_take(queue, task)) {
+                task();
+                continue;
+            }
+
+            std::unique_lock<std::mutex> lock(_mutex);
+            _condition.wait(lock, [this]() { return _stop || _pending > 0; });
+            if (_stop && _pending == 0)
+                return;
+        }
+    }
+}
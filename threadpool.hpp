@@ -0,0 +1,114 @@
+#ifndef THREADPOOL_HPP
+#define THREADPOOL_HPP
+
+#include <vector>
+#include <deque>
+#include <memory>
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <future>
+
+#include "types.hpp"
+
+namespace sift {
+    /**
+     * A fixed size pool of worker threads. The thread which hands work to the pool always takes
+     * part in the processing, so a pool of size 1 owns no workers and runs everything inline.
+     * Every worker has its own queue of tasks. It takes the newest task of its own queue and
+     * steals the oldest task of another queue, when its own runs empty.
+     */
+    class ThreadPool {
+        private:
+            /**
+             * The tasks of a single worker
+             */
+            struct Queue {
+                std::mutex mutex;
+                std::deque<std::function<void()>> tasks;
+            };
+
+            std::vector<std::thread> _workers;
+
+            std::vector<std::unique_ptr<Queue>> _queues;
+
+            /**
+             * The count of tasks in all queues
+             */
+            std::atomic<u32_t> _pending;
+
+            /**
+             * The queue which gets the next submitted task
+             */
+            std::atomic<u32_t> _next;
+
+            std::mutex _mutex;
+
+            std::condition_variable _condition;
+
+            bool _stop = false;
+
+        public:
+            /**
+             * @param threads the total count of threads, including the calling one. 0 takes the
+             * count of hardware threads
+             */
+            explicit ThreadPool(u16_t threads = 1);
+
+            ~ThreadPool();
+
+            ThreadPool(const ThreadPool&) = delete;
+            ThreadPool& operator=(const ThreadPool&) = delete;
+
+            /**
+             * @return the total count of threads, which work on a parallelFor
+             */
+            u16_t size() const {
+                return _workers.size() + 1;
+            }
+
+            /**
+             * Calls fn for every index in [begin, end) and returns as soon as all calls are
+             * finished. The indices are split into one contiguous range per thread. A thread 
+             * which finished its range steals the upper half of the biggest range left, so
+             * uneven work is balanced without giving up the locality of the ranges.
+             * @param begin the first index
+             * @param end one past the last index
+             * @param fn the function which is called with every index
+             */
+            void parallelFor(u32_t, u32_t, const std::function<void(u32_t)>&);
+
+            /**
+             * Runs a task asynchronously on one of the workers. Without workers the task is run
+             * before the function returns.
+             * @param task the task to run
+             * @return a future, which becomes ready when the task is finished
+             */
+            std::future<void> submit(std::function<void()>);
+
+        private:
+            /**
+             * Puts a task into the queue of a worker and wakes up a sleeping worker
+             * @param queue the index of the queue
+             * @param task the task
+             */
+            void _push(u32_t, std::function<void()>);
+
+            /**
+             * Takes a task of the own queue or steals one of the other queues
+             * @param queue the index of the own queue
+             * @param task takes the task
+             * @return false if all queues are empty
+             */
+            bool _take(u32_t, std::function<void()>&);
+
+            /**
+             * The loop every worker runs until the pool gets destroyed
+             * @param queue the index of the queue of the worker
+             */
+            void _work(u32_t);
+    };
+}
+#endif //THREADPOOL_HPP
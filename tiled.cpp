@@ -0,0 +1,224 @@
+#include "tiled.hpp"
+
+#include <atomic>
+#include <thread>
+#include <cctype>
+#include <exception>
+#include <stdexcept>
+#include <algorithm>
+
+namespace sift {
+    namespace {
+        /**
+         * The smallest core of a tile, which is chosen from a budget
+         */
+        const u32_t minTileSize = 256;
+
+        u32_t roundUp(u32_t value, u32_t multiple) {
+            return (value + multiple - 1) / multiple * multiple;
+        }
+
+        /**
+         * Reads the next number of a PGM header and skips the white space and comments before it
+         * @param in the stream
+         * @return the number
+         */
+        u32_t headerNumber(std::istream& in) {
+            int c = in.peek();
+            while (in && (std::isspace(c) || c == '#')) {
+                if (c == '#') {
+                    std::string comment;
+                    std::getline(in, comment);
+                } else {
+                    in.get();
+                }
+                c = in.peek();
+            }
+            u32_t value = 0;
+            in >> value;
+            return value;
+        }
+    }
+
+    TileRegion padRegion(u32_t x0, u32_t y0, u32_t x1, u32_t y1, u32_t halo, u32_t alignment, u32_t width,
+            u32_t height) {
+
+        TileRegion r;
+        r.x0 = x0;
+        r.y0 = y0;
+        r.x1 = x1;
+        r.y1 = y1;
+        r.x = (x0 > halo ? x0 - halo : 0) / alignment * alignment;
+        r.y = (y0 > halo ? y0 - halo : 0) / alignment * alignment;
+        r.shape = vigra::Shape2(std::min(width, r.x + roundUp(x1 + halo - r.x, alignment) + 1) - r.x,
+                std::min(height, r.y + roundUp(y1 + halo - r.y, alignment) + 1) - r.y);
+        return r;
+    }
+
+    TileRegion tileRegion(const TilePlan& plan, u32_t alignment, u32_t width, u32_t height, u32_t tile) {
+        const u32_t x0 = (tile % plan.columns) * plan.tileSize;
+        const u32_t y0 = (tile / plan.columns) * plan.tileSize;
+        return padRegion(x0, y0, std::min(width, x0 + plan.tileSize), std::min(height, y0 + plan.tileSize),
+                plan.halo, alignment, width, height);
+    }
+
+    void keepCore(DescriptorSet& set, const TileRegion& region) {
+        u32_t kept = 0;
+        for (u32_t i = 0; i < set.size(); i++) {
+            const f32_t gx = set.x[i] + region.x;
+            const f32_t gy = set.y[i] + region.y;
+            if (gx < region.x0 || gx >= region.x1 || gy < region.y0 || gy >= region.y1)
+                continue;
+            set.copyTo(i, set, kept);
+            set.x[kept] = gx;
+            set.y[kept] = gy;
+            kept++;
+        }
+        set.resize(kept);
+    }
+
+    PgmReader::PgmReader(const std::string& file) : _in(file, std::ios::binary) {
+        if (!_in)
+            throw std::runtime_error("Can't open " + file);
+
+        char magic[2] = {0, 0};
+        _in.read(magic, 2);
+        if (!_in || magic[0] != 'P' || magic[1] != '5')
+            throw std::runtime_error(file + " is no binary PGM file");
+
+        _width = headerNumber(_in);
+        _height = headerNumber(_in);
+        const u32_t maxval = headerNumber(_in);
+        //A single white space ends the header
+        _in.get();
+        if (!_in || _width == 0 || _height == 0 || maxval == 0 || maxval > 65535)
+            throw std::runtime_error(file + " has an invalid PGM header");
+
+        _bytes = maxval < 256 ? 1 : 2;
+        _scale = 255.0f / maxval;
+        _data = _in.tellg();
+    }
+
+    void PgmReader::read(u32_t x, u32_t y, vigra::MultiArrayView<2, f32_t> out) {
+        const u32_t width = out.width();
+        std::vector<u8_t> row(static_cast<u64_t>(width) * _bytes);
+
+        const u32_t height = out.height();
+        for (u32_t r = 0; r < height; r++) {
+            {
+                std::lock_guard<std::mutex> lock(_mutex);
+                _in.seekg(_data + (static_cast<u64_t>(y + r) * _width + x) * _bytes);
+                _in.read(reinterpret_cast<char*>(row.data()), row.size());
+                if (!_in)
+                    throw std::runtime_error("The PGM file is shorter than its header says");
+            }
+            for (u32_t c = 0; c < width; c++) {
+                const u32_t value = _bytes == 1 ? row[c] : (row[2 * c] << 8) | row[2 * c + 1];
+                out(c, r) = value * _scale;
+            }
+        }
+    }
+
+    TilePlan TiledSift::plan(const Sift& sift, u32_t width, u32_t height) const {
+        TilePlan p;
+        p.halo = sift.halo();
+        const u32_t alignment = sift.alignment();
+
+        //The tile with the most pixels is one in the middle, which has the full halo on all sides
+        auto bytes = [&](u32_t size) {
+            const u32_t w = std::min(width, size + 2 * p.halo + 1);
+            const u32_t h = std::min(height, size + 2 * p.halo + 1);
+            return sift.workspaceBytes(vigra::Shape2(w, h)) + static_cast<u64_t>(w) * h * sizeof(f32_t);
+        };
+        auto tiles = [&](u32_t size) {
+            return static_cast<u64_t>((width + size - 1) / size) * ((height + size - 1) / size);
+        };
+
+        const u32_t smallest = roundUp(minTileSize, alignment);
+        u32_t size = roundUp(_tileSize > 0 ? _tileSize : std::max(width, height), alignment);
+        u16_t workers = std::min<u64_t>(_workers, tiles(size));
+        if (_tileSize == 0) {
+            while (size > smallest && bytes(size) * workers > _budget) {
+                size = std::max(smallest, roundUp(size / 2, alignment));
+                workers = std::min<u64_t>(_workers, tiles(size));
+            }
+        }
+        //Fewer workers, if even the smallest tiles don't fit
+        workers = std::min<u64_t>(workers, _budget / bytes(size));
+        if (workers == 0)
+            throw std::runtime_error("The memory budget is too small for a single tile");
+
+        p.tileSize = size;
+        p.columns = (width + size - 1) / size;
+        p.rows = (height + size - 1) / size;
+        p.workers = workers;
+        p.bytesPerWorker = bytes(size);
+        return p;
+    }
+
+    TilePlan TiledSift::extract(const std::string& file,
+            const std::function<void(u32_t, const DescriptorSet&)>& sink) const {
+
+        PgmReader reader(file);
+        std::unique_ptr<Sift> first = _create();
+        const TilePlan p = plan(*first, reader.width(), reader.height());
+        const u32_t alignment = first->alignment();
+        const u32_t count = p.columns * p.rows;
+
+        std::atomic<u32_t> next(0);
+        std::mutex mutex;
+        std::exception_ptr error;
+
+        auto work = [&](std::unique_ptr<Sift> sift) {
+            vigra::MultiArray<2, f32_t> tile;
+            DescriptorSet set;
+            for (u32_t t = next++; t < count; t = next++) {
+                try {
+                    const TileRegion region = tileRegion(p, alignment, reader.width(), reader.height(), t);
+                    if (tile.shape() != region.shape)
+                        tile.reshape(region.shape);
+                    reader.read(region.x, region.y, tile);
+                    sift->calculate(tile, set);
+                    keepCore(set, region);
+
+                    std::lock_guard<std::mutex> lock(mutex);
+                    sink(t, set);
+                } catch (...) {
+                    std::lock_guard<std::mutex> lock(mutex);
+                    if (!error)
+                        error = std::current_exception();
+                    next = count;
+                }
+            }
+        };
+
+        //All Sift objects are created before the first thread starts, so a failing factory leaves
+        //no thread behind, which would still have to be joined
+        std::vector<std::unique_ptr<Sift>> sifts;
+        for (u16_t w = 1; w < p.workers; w++) {
+            sifts.push_back(_create());
+        }
+        std::vector<std::thread> workers;
+        for (std::unique_ptr<Sift>& sift : sifts) {
+            workers.emplace_back(work, std::move(sift));
+        }
+        work(std::move(first));
+        for (std::thread& w : workers) {
+            w.join();
+        }
+        if (error)
+            std::rethrow_exception(error);
+        return p;
+    }
+
+    TilePlan TiledSift::extract(const std::string& file, DescriptorSet& set) const {
+        std::vector<DescriptorSet> tiles;
+        const TilePlan p = extract(file, [&tiles](u32_t t, const DescriptorSet& tile) {
+                    if (tiles.size() <= t)
+                        tiles.resize(t + 1);
+                    tiles[t] = tile;
+                });
+        concatenate(tiles, set);
+        return p;
+    }
+}
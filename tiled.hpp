@@ -0,0 +1,243 @@
+#ifndef TILED_HPP
+#define TILED_HPP
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <fstream>
+#include <functional>
+
+#include <vigra/multi_array.hxx>
+
+#include "types.hpp"
+#include "sift.hpp"
+#include "descriptorset.hpp"
+
+namespace sift {
+    /**
+     * Reads rectangles of a binary PGM (P5) file without loading the whole image. The rows of a
+     * rectangle are read by seeking to them, so only the rectangle is in memory.
+     */
+    class PgmReader {
+        private:
+            std::ifstream _in;
+
+            /**
+             * Guards the position of the stream, so several threads can read rectangles
+             */
+            std::mutex _mutex;
+
+            u32_t _width = 0;
+            u32_t _height = 0;
+
+            /**
+             * 1 for a maximum value below 256 and 2 for 16 bit values, which are big endian
+             */
+            u16_t _bytes = 1;
+
+            /**
+             * The values are scaled to [0, 255] like the ones of an 8 bit image
+             */
+            f32_t _scale = 1;
+
+            /**
+             * The offset of the first pixel in the file
+             */
+            u64_t _data = 0;
+
+        public:
+            /**
+             * Opens a PGM file and reads its header
+             * @param file the path of the file
+             * @throws std::runtime_error if the file can't be opened or isn't a binary PGM
+             */
+            explicit PgmReader(const std::string&);
+
+            u32_t width() const {
+                return _width;
+            }
+
+            u32_t height() const {
+                return _height;
+            }
+
+            /**
+             * Reads a rectangle of the image. Can be called by several threads at once.
+             * @param x the left column of the rectangle
+             * @param y the top row of the rectangle
+             * @param out takes the rectangle, its shape is the size of the rectangle
+             * @throws std::runtime_error if the file is shorter than its header says
+             */
+            void read(u32_t, u32_t, vigra::MultiArrayView<2, f32_t>);
+    };
+
+    /**
+     * How an image gets split into tiles
+     */
+    class TilePlan {
+        public:
+            /**
+             * The width and height of the core of a tile. The cores don't overlap and cover the
+             * whole image.
+             */
+            u32_t tileSize = 0;
+
+            /**
+             * The margin, which is read around the core of every tile
+             */
+            u32_t halo = 0;
+
+            /**
+             * The count of tiles in x and y direction
+             */
+            u32_t columns = 0;
+            u32_t rows = 0;
+
+            /**
+             * The count of tiles, which are calculated at the same time
+             */
+            u16_t workers = 0;
+
+            /**
+             * The memory a worker needs for the biggest tile
+             */
+            u64_t bytesPerWorker = 0;
+    };
+
+    /**
+     * The part of an image, which a single tile calculates
+     */
+    class TileRegion {
+        public:
+            /**
+             * The top left corner of the calculated rectangle, which is the core with the halo
+             * around it
+             */
+            u32_t x = 0;
+            u32_t y = 0;
+
+            /**
+             * The size of the calculated rectangle
+             */
+            vigra::Shape2 shape;
+
+            /**
+             * The core [x0, x1) x [y0, y1), whose interest points the tile keeps
+             */
+            u32_t x0 = 0;
+            u32_t y0 = 0;
+            u32_t x1 = 0;
+            u32_t y1 = 0;
+    };
+
+    /**
+     * Puts a halo around a rectangle of an image, so a calculation of the padded rectangle finds
+     * the same interest points inside of it as the whole image. The padded rectangle starts at a
+     * multiple of the alignment and its size is a multiple of the alignment plus 1, so every
+     * octave halves it to exactly every second pixel and lies on the octave of the whole image.
+     * @param x0 the left column of the rectangle
+     * @param y0 the top row of the rectangle
+     * @param x1 one past the right column of the rectangle
+     * @param y1 one past the bottom row of the rectangle
+     * @param halo the margin as given by Sift::halo
+     * @param alignment the alignment of the Sift objects
+     * @param width the width of the image
+     * @param height the height of the image
+     * @return the rectangle as the core and the padded rectangle around it
+     */
+    TileRegion padRegion(u32_t, u32_t, u32_t, u32_t, u32_t, u32_t, u32_t, u32_t);
+
+    /**
+     * The rectangle of a tile. The halo is a multiple of the alignment, so the rectangle starts
+     * at one as well. A size of a multiple of the alignment plus 1 halves every octave to exactly
+     * every second pixel, so the octaves of the tile lie on the ones of the whole image.
+     * @param plan the plan of the tiles
+     * @param alignment the alignment of the Sift objects
+     * @param width the width of the image
+     * @param height the height of the image
+     * @param tile the index of the tile, which counts row by row
+     * @return the core and the calculated rectangle of the tile
+     */
+    TileRegion tileRegion(const TilePlan&, u32_t, u32_t, u32_t, u32_t);
+
+    /**
+     * Keeps the interest points inside of the core of a tile and moves them into image
+     * coordinates
+     * @param set the interest points of the tile, relative to the calculated rectangle
+     * @param region the region of the tile
+     */
+    void keepCore(DescriptorSet&, const TileRegion&);
+
+    /**
+     * Calculates the features of images, which are much bigger than the memory. The image is
+     * split into tiles, which are read from the file one by one with a halo of the size of
+     * Sift::halo around them, so the interest points inside of a tile are the same as on the whole
+     * image. A tile only keeps the interest points inside of its core, so the points of the
+     * overlapping halos aren't found twice. Several workers calculate tiles at the same time with
+     * a Sift object each. The tile size and the count of workers are chosen, so the pyramids and
+     * tiles of all workers stay within a memory budget.
+     */
+    class TiledSift {
+        private:
+            /**
+             * Creates the Sift object of a worker
+             */
+            const std::function<std::unique_ptr<Sift>()> _create;
+
+            /**
+             * The most bytes all workers together may use for their tiles and pyramids
+             */
+            const u64_t _budget;
+
+            const u16_t _workers;
+
+            /**
+             * The tile size given by the user, 0 derives it from the budget
+             */
+            const u32_t _tileSize;
+
+        public:
+            /**
+             * @param create creates the Sift object of a worker
+             * @param budget the most bytes all workers together may use for their tiles and pyramids
+             * @param workers how many tiles are calculated at the same time at most
+             * @param tileSize the size of the core of a tile, which is rounded up to the alignment
+             * of the Sift objects. 0 takes the biggest size, which fits into the budget.
+             */
+            explicit TiledSift(std::function<std::unique_ptr<Sift>()> create, u64_t budget = 1ull << 30,
+                    u16_t workers = 1, u32_t tileSize = 0) :
+                _create(create), _budget(budget), _workers(workers > 0 ? workers : 1), _tileSize(tileSize) {
+            }
+
+            /**
+             * Chooses the tiles of an image
+             * @param sift a Sift object as the workers use it
+             * @param width the width of the image
+             * @param height the height of the image
+             * @return the plan of the tiles
+             * @throws std::runtime_error if not even a single worker fits into the budget
+             */
+            TilePlan plan(const Sift&, u32_t, u32_t) const;
+
+            /**
+             * Calculates the features of a PGM file tile by tile. The sink gets the interest
+             * points of every tile in image coordinates, as soon as the tile is finished. It is
+             * called by one worker at a time, but not in the order of the tiles.
+             * @param file the path of the PGM file
+             * @param sink takes the index of a tile, which counts row by row, and its features
+             * @return the plan of the tiles
+             */
+            TilePlan extract(const std::string&, const std::function<void(u32_t, const DescriptorSet&)>&) const;
+
+            /**
+             * Calculates the features of a PGM file tile by tile into a single set. The features
+             * are ordered by tile.
+             * @param file the path of the PGM file
+             * @param set takes the features in image coordinates
+             * @return the plan of the tiles
+             */
+            TilePlan extract(const std::string&, DescriptorSet&) const;
+    };
+}
+#endif //TILED_HPP
@@ -0,0 +1,193 @@
+#include "workspace.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <cstdint>
+
+#include "convolution.hpp"
+#include "extrema.hpp"
+
+namespace sift {
+    namespace {
+        /**
+         * Every level starts at a multiple of 64 bytes, which is the size of a cache line and
+         * of an AVX-512 register
+         */
+        const u64_t alignment = 64 / sizeof(f32_t);
+
+        u64_t aligned(u64_t count) {
+            return (count + alignment - 1) / alignment * alignment;
+        }
+
+        u64_t area(const vigra::Shape2& shape) {
+            return aligned(shape[0] * shape[1]);
+        }
+
+        /**
+         * @return the f32_t values, which take an image of 16 bit values
+         */
+        u64_t packedArea(const vigra::Shape2& shape) {
+            return aligned((shape[0] * shape[1] + 1) / 2);
+        }
+
+        /**
+         * The shapes and sizes of the arena of a configuration, counted in f32_t values
+         */
+        struct Layout {
+            vigra::Shape2 first;
+            std::vector<vigra::Shape2> levels;
+            u64_t scratch;
+            u64_t pyramid;
+            u64_t gradients;
+            u64_t size;
+        };
+
+        Layout layout(const vigra::Shape2& shape, u16_t octaves, u16_t dogsPerEpoch, bool subpixel, u32_t radius,
+                u16_t threads, Precision precision) {
+
+            Layout l;
+            l.first = subpixel ? vigra::Shape2(shape[0] * 2, shape[1] * 2) : shape;
+            l.levels.assign(octaves, l.first);
+            for (u16_t o = 1; o < octaves; o++) {
+                l.levels[o] = vigra::Shape2((l.levels[o - 1][0] + 1) / 2, (l.levels[o - 1][1] + 1) / 2);
+            }
+
+            l.scratch = aligned(std::max({alg::separableConvolveScratch(l.first[0], radius),
+                        alg::separableDecimateScratch(l.first[0], radius),
+                        alg::findExtremaScratch(l.first[0], dogsPerEpoch)}));
+            l.pyramid = 0;
+            l.gradients = 0;
+            for (u16_t o = 0; o < octaves; o++) {
+                //Gaussians, magnitudes and orientations have one level more than the DoGs, which are
+                //never stored
+                l.pyramid += area(l.levels[o]) * (dogsPerEpoch + 1);
+                l.gradients += (precision == Precision::f32 ? area(l.levels[o]) : packedArea(l.levels[o])) *
+                    (dogsPerEpoch + 1);
+            }
+            l.size = (subpixel ? area(l.first) : 0) + l.pyramid + l.gradients * 2 + threads * l.scratch;
+            return l;
+        }
+    }
+
+    u64_t SiftWorkspace::requiredBytes(const vigra::Shape2& shape, u16_t octaves, u16_t dogsPerEpoch,
+            bool subpixel, u32_t radius, u16_t threads, Precision precision) {
+
+        return (layout(shape, octaves, dogsPerEpoch, subpixel, radius, threads, precision).size + alignment) *
+            sizeof(f32_t);
+    }
+
+    void SiftWorkspace::reserve(const vigra::Shape2& shape, u16_t octaves, u16_t dogsPerEpoch,
+            bool subpixel, u32_t radius, u16_t threads, Precision precision) {
+
+        assert(octaves > 0 && dogsPerEpoch > 0 && threads > 0);
+
+        if (_arena != nullptr && shape == _shape && octaves == _octaves && dogsPerEpoch == _dogsPerEpoch &&
+                subpixel == _subpixel && radius == _radius && threads == _threads && precision == _precision) {
+            _allocated = 0;
+            return;
+        }
+
+        const Layout l = layout(shape, octaves, dogsPerEpoch, subpixel, radius, threads, precision);
+        const vigra::Shape2& first = l.first;
+        const std::vector<vigra::Shape2>& levels = l.levels;
+        const u64_t scratch = l.scratch;
+        const u64_t pyramid = l.pyramid;
+        const u64_t size = l.size;
+
+        _allocated = 0;
+        if (_memory.size() < size + alignment) {
+            _memory = std::vector<f32_t>();
+            _memory.resize(size + alignment);
+            _allocated = bytes();
+        }
+        _pyramid = pyramid * sizeof(f32_t);
+        _gradients = l.gradients * sizeof(f32_t);
+        _used = size * sizeof(f32_t);
+        const u64_t offset = reinterpret_cast<std::uintptr_t>(&_memory[0]) % (alignment * sizeof(f32_t));
+        _arena = &_memory[0] + (offset == 0 ? 0 : alignment - offset / sizeof(f32_t));
+
+        //Views, which are already bound, would copy data on assignment, so start from new ones
+        gaussians = Matrix<OctaveElem>(octaves, dogsPerEpoch + 1);
+        magnitudes = Matrix<vigra::MultiArrayView<2, f32_t>>(octaves, dogsPerEpoch + 1);
+        orientations = Matrix<vigra::MultiArrayView<2, f32_t>>(octaves, dogsPerEpoch + 1);
+        packedMagnitudes = Matrix<vigra::MultiArrayView<2, u16_t>>(octaves, dogsPerEpoch + 1);
+        packedOrientations = Matrix<vigra::MultiArrayView<2, u16_t>>(octaves, dogsPerEpoch + 1);
+
+        f32_t* next = _arena;
+        auto carve = [&next](const vigra::Shape2& s) {
+            vigra::MultiArrayView<2, f32_t> view(s, next);
+            next += area(s);
+            return view;
+        };
+        auto carvePacked = [&next](const vigra::Shape2& s) {
+            vigra::MultiArrayView<2, u16_t> view(s, reinterpret_cast<u16_t*>(next));
+            next += packedArea(s);
+            return view;
+        };
+
+        if (subpixel) {
+            _input = next;
+            next += area(first);
+        }
+
+        for (u16_t o = 0; o < octaves; o++) {
+            for (u16_t i = 0; i < dogsPerEpoch + 1; i++) {
+                gaussians(o, i).img = carve(levels[o]);
+                if (precision == Precision::f32) {
+                    magnitudes(o, i) = carve(levels[o]);
+                    orientations(o, i) = carve(levels[o]);
+                } else {
+                    packedMagnitudes(o, i) = carvePacked(levels[o]);
+                    packedOrientations(o, i) = carvePacked(levels[o]);
+                }
+            }
+        }
+
+        _scratch = next;
+        next += threads * scratch;
+        assert(next <= &_memory[0] + _memory.size());
+
+        _shape = shape;
+        _octaves = octaves;
+        _dogsPerEpoch = dogsPerEpoch;
+        _subpixel = subpixel;
+        _radius = radius;
+        _threads = threads;
+        _precision = precision;
+    }
+
+    vigra::MultiArrayView<2, f32_t> SiftWorkspace::input() {
+        assert(_subpixel);
+        return vigra::MultiArrayView<2, f32_t>(vigra::Shape2(_shape[0] * 2, _shape[1] * 2), _input);
+    }
+
+    vigra::MultiArrayView<2, f32_t> SiftWorkspace::magnitudeWindow(u16_t o, u16_t i, const vigra::Shape2& from,
+            const vigra::Shape2& to, f32_t* buffer) const {
+
+        if (_precision == Precision::f32)
+            return magnitudes(o, i).subarray(from, to);
+
+        const vigra::Shape2 shape(to[0] - from[0], to[1] - from[1]);
+        const u32_t height = shape[1];
+        for (u32_t y = 0; y < height; y++) {
+            alg::loadMagnitudes(&packedMagnitudes(o, i)(from[0], from[1] + y), buffer + y * shape[0], shape[0],
+                    _precision);
+        }
+        return vigra::MultiArrayView<2, f32_t>(shape, buffer);
+    }
+
+    vigra::MultiArrayView<2, f32_t> SiftWorkspace::orientationWindow(u16_t o, u16_t i, const vigra::Shape2& from,
+            const vigra::Shape2& to, f32_t* buffer) const {
+
+        if (_precision == Precision::f32)
+            return orientations(o, i).subarray(from, to);
+
+        const vigra::Shape2 shape(to[0] - from[0], to[1] - from[1]);
+        const u32_t height = shape[1];
+        for (u32_t y = 0; y < height; y++) {
+            alg::loadOrientations(&packedOrientations(o, i)(from[0], from[1] + y), buffer + y * shape[0], shape[0],
+                    _precision);
+        }
+        return vigra::MultiArrayView<2, f32_t>(shape, buffer);
+    }
+}
@@ -0,0 +1,199 @@
+#ifndef WORKSPACE_HPP
+#define WORKSPACE_HPP
+
+#include <vector>
+
+#include <vigra/multi_array.hxx>
+
+#include "types.hpp"
+#include "matrix.hpp"
+#include "octaveelem.hpp"
+#include "precision.hpp"
+
+namespace sift {
+    /**
+     * The memory of all the pyramids of a Sift calculation. Every level is a view into a single
+     * aligned arena, which is only allocated again if a calculation needs more memory than
+     * before. So calculations on images of the same size don't allocate anything for their
+     * pyramids.
+     */
+    class SiftWorkspace {
+        public:
+            /**
+             * The Gaussians, octaves as width and the elements of an octave as height
+             */
+            Matrix<OctaveElem> gaussians;
+
+            /**
+             * The magnitudes of the gaussians in the f32 precision, unbound otherwise
+             */
+            Matrix<vigra::MultiArrayView<2, f32_t>> magnitudes;
+
+            /**
+             * The orientations of the gaussians in the f32 precision, unbound otherwise
+             */
+            Matrix<vigra::MultiArrayView<2, f32_t>> orientations;
+
+            /**
+             * The magnitudes of the gaussians in the 16 bit precisions, unbound otherwise
+             */
+            Matrix<vigra::MultiArrayView<2, u16_t>> packedMagnitudes;
+
+            /**
+             * The orientations of the gaussians in the 16 bit precisions, unbound otherwise
+             */
+            Matrix<vigra::MultiArrayView<2, u16_t>> packedOrientations;
+
+        private:
+            std::vector<f32_t> _memory;
+
+            /**
+             * The first aligned value of the memory
+             */
+            f32_t* _arena = nullptr;
+
+            /**
+             * Memory for the input image of doubled size in the subpixel mode
+             */
+            f32_t* _input = nullptr;
+
+            /**
+             * Scratch memory of the convolutions and the extrema search of all threads
+             */
+            f32_t* _scratch = nullptr;
+
+            /**
+             * The configuration the views were carved for
+             */
+            vigra::Shape2 _shape;
+            u16_t _octaves = 0;
+            u16_t _dogsPerEpoch = 0;
+            bool _subpixel = false;
+            u32_t _radius = 0;
+            u16_t _threads = 0;
+            Precision _precision = Precision::f32;
+
+            /**
+             * The bytes of the Gaussian pyramid, of one gradient pyramid, of the part of the arena
+             * the configuration uses and of the memory allocated by the last call of reserve
+             */
+            u64_t _pyramid = 0;
+            u64_t _gradients = 0;
+            u64_t _used = 0;
+            u64_t _allocated = 0;
+
+        public:
+            SiftWorkspace() = default;
+
+            SiftWorkspace(const SiftWorkspace&) = delete;
+            SiftWorkspace& operator=(const SiftWorkspace&) = delete;
+
+            /**
+             * Prepares the views of all levels for a calculation. Nothing happens, if the
+             * configuration is the same as in the call before.
+             * @param shape the shape of the input image
+             * @param octaves how many octaves are calculated
+             * @param dogsPerEpoch how many DoGs are searched per octave
+             * @param subpixel wether the input image gets doubled first
+             * @param radius the radius of the largest kernel
+             * @param threads how many threads convolve at the same time
+             * @param precision how the magnitudes and orientations are stored
+             */
+            void reserve(const vigra::Shape2&, u16_t, u16_t, bool, u32_t, u16_t, Precision = Precision::f32);
+
+            /**
+             * The memory reserve allocates for a configuration
+             * @param shape the shape of the input image
+             * @param octaves how many octaves are calculated
+             * @param dogsPerEpoch how many DoGs are searched per octave
+             * @param subpixel wether the input image gets doubled first
+             * @param radius the radius of the largest kernel
+             * @param threads how many threads convolve at the same time
+             * @param precision how the magnitudes and orientations are stored
+             * @return the size of the arena in bytes
+             */
+            static u64_t requiredBytes(const vigra::Shape2&, u16_t, u16_t, bool, u32_t, u16_t,
+                    Precision = Precision::f32);
+
+            /**
+             * @return the input image of doubled size in the subpixel mode
+             */
+            vigra::MultiArrayView<2, f32_t> input();
+
+            /**
+             * @return how the magnitudes and orientations are stored
+             */
+            Precision precision() const {
+                return _precision;
+            }
+
+            /**
+             * The magnitudes of a window of a level as floats. In the 16 bit precisions they are
+             * converted into the buffer, otherwise the view points into the pyramid.
+             * @param o the octave
+             * @param i the level of the octave
+             * @param from the upper left corner of the window
+             * @param to one past the lower right corner of the window
+             * @param buffer memory for at least the pixels of the window
+             * @return the magnitudes of the window
+             */
+            vigra::MultiArrayView<2, f32_t> magnitudeWindow(u16_t, u16_t, const vigra::Shape2&,
+                    const vigra::Shape2&, f32_t*) const;
+
+            /**
+             * The orientations of a window of a level as floats, like magnitudeWindow
+             * @param o the octave
+             * @param i the level of the octave
+             * @param from the upper left corner of the window
+             * @param to one past the lower right corner of the window
+             * @param buffer memory for at least the pixels of the window
+             * @return the orientations of the window
+             */
+            vigra::MultiArrayView<2, f32_t> orientationWindow(u16_t, u16_t, const vigra::Shape2&,
+                    const vigra::Shape2&, f32_t*) const;
+
+            /**
+             * @return the scratch memory for the convolutions and the extrema search of all threads
+             */
+            f32_t* scratch() {
+                return _scratch;
+            }
+
+            /**
+             * @return the size of the arena in bytes
+             */
+            u64_t bytes() const {
+                return _memory.size() * sizeof(f32_t);
+            }
+
+            /**
+             * @return the bytes of the Gaussian pyramid
+             */
+            u64_t pyramidBytes() const {
+                return _pyramid;
+            }
+
+            /**
+             * @return the bytes of each of the magnitude and orientation pyramids
+             */
+            u64_t gradientBytes() const {
+                return _gradients;
+            }
+
+            /**
+             * @return the bytes of the arena, which are used by the current configuration
+             */
+            u64_t usedBytes() const {
+                return _used;
+            }
+
+            /**
+             * @return the bytes, which were allocated by the last call of reserve. 0 if the arena
+             * was big enough.
+             */
+            u64_t allocatedBytes() const {
+                return _allocated;
+            }
+    };
+}
+#endif //WORKSPACE_HPP